@@ -0,0 +1,240 @@
+/*
+ * Copyright (C) 2021, Xilinx Inc - All rights reserved
+ * Xilinx Multiscaler XMA Plugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+#ifndef _XLNX_ABR_SCALER_COEFF_FILE_H_
+#define _XLNX_ABR_SCALER_COEFF_FILE_H_
+
+/**
+ *  @file
+ *  Binary filter coefficient file, mapped read-only and used in place.
+ *
+ *  Layout (little endian):
+ *    XlnxCoeffFileHeader
+ *    XlnxCoeffSetEntry[num_sets]
+ *    int16_t [64][12] table per set, at the entry's data_offset
+ *
+ *  The checksum is Adler-32 over every byte following the header. Each set
+ *  holds one direction; a horizontal and a vertical set may share a name.
+ *  A set is selected by name, else by output index, else by the in/out
+ *  ratio range of the direction being scaled. The legacy text format (all
+ *  horizontal sets followed by all vertical sets) converts with
+ *  xlnx_coeff_file_convert_text().
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define XLNX_COEFF_FILE_MAGIC       "XLNXCOEF"
+#define XLNX_COEFF_FILE_VERSION     1
+#define XLNX_COEFF_SET_NAME_LEN     32
+#define XLNX_COEFF_SET_PHASES       64
+#define XLNX_COEFF_SET_TAPS         12
+#define XLNX_COEFF_ANY_OUTPUT       (-1)
+#define XLNX_COEFF_RATIO_SCALE      1000  /* ratio_min/max are in/out * 1000 */
+
+typedef enum
+{
+  XLNX_COEFF_DIR_HORIZONTAL = 0,
+  XLNX_COEFF_DIR_VERTICAL,
+} XlnxCoeffDir;
+
+typedef struct
+{
+  char     magic[8];
+  uint32_t version;
+  uint32_t header_size;
+  uint32_t num_sets;
+  uint32_t entry_size;
+  uint64_t file_size;
+  uint32_t checksum;
+  uint32_t reserved[3];
+} XlnxCoeffFileHeader;
+
+typedef struct
+{
+  char     name[XLNX_COEFF_SET_NAME_LEN];
+  int32_t  output_id;   /* XLNX_COEFF_ANY_OUTPUT when keyed by ratio only */
+  uint32_t direction;   /* XlnxCoeffDir */
+  uint32_t ratio_min;   /* inclusive, 0 for no lower bound */
+  uint32_t ratio_max;   /* exclusive, 0 for no upper bound */
+  uint64_t data_offset;
+} XlnxCoeffSetEntry;
+
+typedef int16_t XlnxCoeffTable[XLNX_COEFF_SET_PHASES][XLNX_COEFF_SET_TAPS];
+
+static inline uint32_t xlnx_coeff_adler32(const uint8_t *data, size_t len)
+{
+  uint32_t a = 1, b = 0;
+
+  while (len) {
+    /* 5552 is the largest block keeping b below 2^32 before the modulo */
+    size_t n = len < 5552 ? len : 5552;
+    len -= n;
+    while (n--) {
+      a += *data++;
+      b += a;
+    }
+    a %= 65521;
+    b %= 65521;
+  }
+  return (b << 16) | a;
+}
+
+/* Checks a mapped image; returns NULL when valid, else the reason */
+static inline const char *xlnx_coeff_file_validate(const uint8_t *base, size_t size)
+{
+  const XlnxCoeffFileHeader *hdr = (const XlnxCoeffFileHeader *)base;
+  const XlnxCoeffSetEntry *sets;
+  uint32_t i;
+
+  if (size < sizeof(*hdr) || memcmp(hdr->magic, XLNX_COEFF_FILE_MAGIC, sizeof(hdr->magic)))
+    return "bad magic";
+  if (hdr->version != XLNX_COEFF_FILE_VERSION)
+    return "unsupported version";
+  if ((hdr->header_size != sizeof(*hdr)) || (hdr->entry_size != sizeof(*sets)))
+    return "unexpected header layout";
+  if (hdr->file_size != size)
+    return "size mismatch";
+  if (hdr->num_sets > (size - sizeof(*hdr)) / sizeof(*sets))
+    return "set table truncated";
+  if (xlnx_coeff_adler32(base + sizeof(*hdr), size - sizeof(*hdr)) != hdr->checksum)
+    return "checksum mismatch";
+
+  sets = (const XlnxCoeffSetEntry *)(base + sizeof(*hdr));
+  for (i = 0; i < hdr->num_sets; i++) {
+    if ((sets[i].data_offset % sizeof(int16_t)) ||
+        (sets[i].data_offset < sizeof(*hdr) + hdr->num_sets * sizeof(*sets)) ||
+        (size < sizeof(XlnxCoeffTable)) ||
+        (sets[i].data_offset > size - sizeof(XlnxCoeffTable)))
+      return "set data out of range";
+  }
+  return NULL;
+}
+
+/* Picks the table for one direction of an output; 'name' may be NULL or "" */
+static inline const XlnxCoeffTable *
+xlnx_coeff_file_find(const uint8_t *base, const char *name, int output_id,
+                     XlnxCoeffDir dir, uint32_t in_size, uint32_t out_size)
+{
+  const XlnxCoeffFileHeader *hdr = (const XlnxCoeffFileHeader *)base;
+  const XlnxCoeffSetEntry *sets = (const XlnxCoeffSetEntry *)(base + sizeof(*hdr));
+  const XlnxCoeffSetEntry *by_ratio = NULL;
+  uint64_t ratio = out_size ? ((uint64_t)in_size * XLNX_COEFF_RATIO_SCALE) / out_size : 0;
+  uint32_t i;
+
+  for (i = 0; i < hdr->num_sets; i++) {
+    const XlnxCoeffSetEntry *set = &sets[i];
+
+    if (set->direction != (uint32_t)dir)
+      continue;
+    if (name && name[0]) {
+      if (!strncmp(set->name, name, XLNX_COEFF_SET_NAME_LEN))
+        return (const XlnxCoeffTable *)(base + set->data_offset);
+      continue;
+    }
+    if (set->output_id == output_id)
+      return (const XlnxCoeffTable *)(base + set->data_offset);
+    if ((set->output_id == XLNX_COEFF_ANY_OUTPUT) && !by_ratio &&
+        (ratio >= set->ratio_min) && (!set->ratio_max || ratio < set->ratio_max))
+      by_ratio = set;
+  }
+  return by_ratio ? (const XlnxCoeffTable *)(base + by_ratio->data_offset) : NULL;
+}
+
+/* Converts a legacy text coefficient file holding num_sets horizontal tables
+ * followed by num_sets vertical tables. As in the text loader, table pair k
+ * belongs to the k-th output with coeffLoad=2, output_ids[k] in ascending
+ * order; it is named "out<output_ids[k]>" and bound to that output.
+ * Returns 0 on success.
+ */
+static inline int xlnx_coeff_file_convert_text(const char *txt_path, const int *output_ids,
+                                               int num_sets, const char *bin_path)
+{
+  XlnxCoeffFileHeader hdr;
+  XlnxCoeffSetEntry *sets = NULL;
+  XlnxCoeffTable *tables = NULL;
+  uint8_t *image = NULL;
+  size_t data_start, size;
+  FILE *fp = NULL;
+  int ret = -1, k, p, t, val;
+
+  if (num_sets <= 0)
+    return -1;
+
+  data_start = sizeof(hdr) + 2 * num_sets * sizeof(*sets);
+  data_start = (data_start + 63) & ~(size_t)63;
+  size = data_start + 2 * num_sets * sizeof(XlnxCoeffTable);
+  image = (uint8_t *)calloc(1, size);
+  if (!image)
+    return -1;
+  sets = (XlnxCoeffSetEntry *)(image + sizeof(hdr));
+  tables = (XlnxCoeffTable *)(image + data_start);
+
+  fp = fopen(txt_path, "r");
+  if (!fp) {
+    fprintf(stderr, "failed to open %s\n", txt_path);
+    goto done;
+  }
+  /* horizontal sets first, then vertical, same order the plugin used to read */
+  for (k = 0; k < 2 * num_sets; k++) {
+    XlnxCoeffSetEntry *set = &sets[k];
+
+    for (p = 0; p < XLNX_COEFF_SET_PHASES; p++) {
+      for (t = 0; t < XLNX_COEFF_SET_TAPS; t++) {
+        if (fscanf(fp, "%d", &val) != 1) {
+          fprintf(stderr, "%s: expected %d tables, ran out at table %d\n", txt_path, 2 * num_sets, k);
+          goto done;
+        }
+        tables[k][p][t] = (int16_t)val;
+      }
+    }
+    snprintf(set->name, sizeof(set->name), "out%d", output_ids[k % num_sets]);
+    set->output_id   = output_ids[k % num_sets];
+    set->direction   = k < num_sets ? XLNX_COEFF_DIR_HORIZONTAL : XLNX_COEFF_DIR_VERTICAL;
+    set->data_offset = data_start + k * sizeof(XlnxCoeffTable);
+  }
+  fclose(fp);
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, XLNX_COEFF_FILE_MAGIC, sizeof(hdr.magic));
+  hdr.version     = XLNX_COEFF_FILE_VERSION;
+  hdr.header_size = sizeof(hdr);
+  hdr.num_sets    = 2 * num_sets;
+  hdr.entry_size  = sizeof(*sets);
+  hdr.file_size   = size;
+  hdr.checksum    = xlnx_coeff_adler32(image + sizeof(hdr), size - sizeof(hdr));
+  memcpy(image, &hdr, sizeof(hdr));
+
+  fp = fopen(bin_path, "wb");
+  if (!fp) {
+    fprintf(stderr, "failed to open %s\n", bin_path);
+    goto done;
+  }
+  if (fwrite(image, 1, size, fp) == size)
+    ret = 0;
+  if (fclose(fp))
+    ret = -1;
+  fp = NULL;
+
+done:
+  if (fp)
+    fclose(fp);
+  free(image);
+  return ret;
+}
+
+#endif /* _XLNX_ABR_SCALER_COEFF_FILE_H_ */
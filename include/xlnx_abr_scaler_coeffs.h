@@ -597,6 +597,16 @@ int feasibilityCheck(int src, int dst, int* filterSize)
     return 0;	
 }
 
+/*
+ * Cardinal cubic spline coefficients for the scaler IP.
+ *
+ * The IP stepper produces output k with phase ((k * PixelRate) >> 10) & 63,
+ * and the tap distances of a phase do not depend on the input position, so
+ * each phase used for this ratio is generated once directly from its index.
+ * Phases the stepper never reaches are left zero before normalization, as
+ * before. Scratch storage is on the stack; filterSize is capped at
+ * MAX_FILTER_SIZE (feasibilityCheck rejects anything larger).
+ */
 void Generate_cardinal_cubic_spline(int src, int dst, int filterSize, int64_t B, int64_t C, int16_t* CCS_filtCoeff)
 {
 #ifdef COEFF_DUMP
@@ -604,100 +614,61 @@ void Generate_cardinal_cubic_spline(int src, int dst, int filterSize, int64_t B,
     char fname[512];
     sprintf(fname,"coeff_%dTO%d.csv",src,dst);
     fp=fopen(fname,"w");
-    /*FILE *fph;
-    sprintf(fname,"phase_%dTO%d_2Inc.txt",src,dst);	
-    fph=fopen(fname,"w");*/
-    //fprintf(fp,"src:%d => dst:%d\n\n",src,dst);
 #endif
-    int  filterAlign = 4,  one= (1<<14);
-    int64_t *coeffFilter =NULL;
-    int64_t *coeffFilter_reduced = NULL;	   
-    int16_t *outFilter = NULL;
-    int16_t *coeffFilter_normalized = NULL;
-    int lumXInc      = (((int64_t)src << 16) + (dst >> 1)) / dst;
+    int  one = (1<<14);
+    int64_t coeffFilter[MAX_FILTER_SIZE];
+    int16_t outFilter[MAX_FILTER_SIZE];
+    int xInc         = (((int64_t)src << 16) + (dst >> 1)) / dst;
     int srt = src/dst;
     int lval = log2_val(srt);
     int th0 = 8;
-    int lv0 = MIN(lval, th0);	   
-    const int64_t fone = (int64_t)1 << (54-lv0);	 	   
+    int lv0 = MIN(lval, th0);
+    const int64_t fone = (int64_t)1 << (54-lv0);
     int64_t thr1 = ((int64_t)1 << 31);
-    int64_t thr2 = ((int64_t)1<<54)/fone;	   
-    int i, xInc, filter2Size, minFilterSize, outFilterSize;	   
-    int num_phases = 64;
-    int phase_set[64] ={0};
-    int64_t xDstInSrc;
-    int xx,j,ph1,diff;
-    int64_t ld2=0, ph0=0, d=0, coeff=0, dd=0,ddd=0;  
-    int phase_cnt =0, singleZP = 0,  min = 0, k=0;
-    int64_t cutOff = 0.0;	       
-    int64_t error = 0, sum = 0, v = 0;
-    int intV =0, rot_idx = 0, col_idx=-1;
-    int currCoeff=0, prevCoeff = -1;
-    int c = 0, nzRow = 0, mi=0;
-    int firstValidP = 0, re_phase_cnt = 0;
-    int fstart_Idx=0, fend_Idx=0, half_Idx=0, middleIdx = 0;
-  
-	   
-    xInc = lumXInc;  
-    filterSize = MAX(filterSize, 1);
-    coeffFilter = (int64_t*) calloc(num_phases*filterSize, sizeof(int64_t)); 
-	
-    xDstInSrc = xInc - (1<<16);	   
-    diff =xDstInSrc;
-    unsigned int PhaseH = 0, offset = 0, WriteLoc = 0, WriteLocNext = 0, ReadLoc=0, OutputWrite_En = 0;
-	   
-    int OutPixels = dst;
+    int64_t thr2 = ((int64_t)1<<54)/fone;
+    int num_phases = NR_PHASES;
+    int phase_set[NR_PHASES] = {0};
     int PixelRate = (int)((float)((src*STEP_PRECISION) + (dst/2))/(float)dst);
-    
-    // coefficient generation based on scaler IP
-    for (i = 0; i < src; i++)
-    {
-        PhaseH = ((offset>>(STEP_PRECISION_SHIFT-NR_PHASE_BITS))) & (NR_PHASES-1);
-        WriteLoc = WriteLocNext;
-        
-        if ((offset >> STEP_PRECISION_SHIFT) != 0)
-        {
-            // Take a new sample from input, but don't process anything
-            ReadLoc++;
-            offset = offset - (1<<STEP_PRECISION_SHIFT);
-            OutputWrite_En   = 0;
-            WriteLocNext = WriteLoc;
-        }
-        
-        if (((offset >> STEP_PRECISION_SHIFT) == 0) && (WriteLoc<OutPixels))
-        {
-            // Produce a new output sample
-            offset += PixelRate;
-            OutputWrite_En   = 1;
-            WriteLocNext = WriteLoc+1;
+    int outputs, phase_cnt = 0;
+    int i, j, k;
+    int64_t d, dd, ddd, coeff, sum, error, v;
+    int intV;
+    int fstart_Idx, half_Idx;
+    int ph_max_sum = 1<<MAX_FILTER_SIZE;
+    int sumVal = 0, maxIdx = 0, maxVal = 0, diffVal = 0;
+
+    filterSize = MAX(filterSize, 1);
+    filterSize = MIN(filterSize, MAX_FILTER_SIZE);
+
+    /* outputs the stepper emits within src input cycles */
+    if (PixelRate >= STEP_PRECISION)
+        outputs = MIN((int)((((int64_t)src - 1) * STEP_PRECISION) / PixelRate) + 1, dst);
+    else
+        outputs = MIN(src, dst);
+
+    for (k = 0; (k < outputs) && (phase_cnt < num_phases); k++) {
+        int ph = (int)((((int64_t)k * PixelRate) >> (STEP_PRECISION_SHIFT-NR_PHASE_BITS)) & (NR_PHASES-1));
+        if (!phase_set[ph]) {
+            phase_set[ph] = 1;
+            phase_cnt++;
         }
-        if (OutputWrite_En) {
-            
-            //printf("i %d out %d in %d phase %d\n", i, WriteLoc, ReadLoc, PhaseH);
-            
-            xDstInSrc = ReadLoc*(1<<17) + PhaseH*(1<<11);
-            xx = ReadLoc - (filterSize - 2)/2;
-            
-            //printf("xx %d xDstInSrc %lld\n", xx, xDstInSrc);
-            d = (ABS(((int64_t)xx * (1 << 17)) - xDstInSrc)) << 13;
-            //printf("d %lld\n", d);
-
-            //count number of phases used for this SR
-            if (phase_set[PhaseH] == 0) phase_cnt+=1;
-            
-            //Filter coeff generation
-            for (j = 0; j < filterSize; j++)
-            {
-                d = (ABS(((int64_t)xx * (1 << 17)) - xDstInSrc)) << 13;
+    }
+
+    /*incorporate filter less than 12 tap into a 12 tap, centered on tap 6*/
+    half_Idx = (filterSize/2);
+    fstart_Idx = (MAX_FILTER_SIZE/2) - half_Idx;
+
+    for (i = 0; i < num_phases; i++) {
+        sum = 0;
+        for (j = 0; j < filterSize; j++) {
+            coeff = 0;
+            if (phase_set[i]) {
+                /* |input tap - output position| in 2^30 units per input pixel */
+                d = (ABS(((int64_t)(j - (filterSize - 2)/2) * (1 << 17)) - (int64_t)i * (1 << 11))) << 13;
                 if (xInc > 1 << 16)
-                {
-                    //printf("xinc >\n");
                     d = (int64_t)(d *dst/ src);
-                }
-                
-                if (d >= thr1) {
-                    coeff = 0.0;
-                } else {
+
+                if (d < thr1) {
                     dd  = (int64_t)(d  * d) >> 30;
                     ddd = (int64_t) (dd * d) >> 30;
                     if (d < 1 << 30)
@@ -713,101 +684,51 @@ void Generate_cardinal_cubic_spline(int src, int dst, int filterSize, int64_t B,
                         (-12 * B - 48 * C) * d   +
                         (8 * B + 24 * C) * (1 << 30);
                     }
+                    coeff = coeff/thr2;
                 }
-                
-                coeff = coeff/thr2;
-                coeffFilter[PhaseH * filterSize + j] = coeff;
-                xx++;
             }
-            if (phase_set[PhaseH] == 0) {
-                phase_set[PhaseH] = 1;
-            }
-        }
-    }
-       
-    //printf("filter size is %d\n", filterSize);
-    coeffFilter_reduced = (int64_t*) calloc((num_phases*filterSize), sizeof(int64_t));
-    memcpy(coeffFilter_reduced, coeffFilter, sizeof(int64_t)*num_phases*filterSize);
-    outFilterSize = filterSize;
-    outFilter = (int16_t*) calloc((num_phases*outFilterSize),sizeof(int16_t));
-    coeffFilter_normalized = (int16_t*) calloc((num_phases*outFilterSize),sizeof(int16_t));
-    
-    /* normalize & store in outFilter */
-    for ( i = 0; i < num_phases; i++) {
-        error = 0;
-        sum   = 0;
-        
-        for (j = 0; j < filterSize; j++) {
-            sum += coeffFilter_reduced[i * filterSize + j];
+            coeffFilter[j] = coeff;
+            sum += coeff;
         }
+
+        /* normalize to 14 bits, then drop to the 12 bit IP precision */
         sum = (sum + one / 2) / one;
         if (!sum) {
             sum = 1;
         }
-        for (j = 0; j < outFilterSize; j++) {
-            v = coeffFilter_reduced[i * filterSize + j] + error;
+        error = 0;
+        for (j = 0; j < filterSize; j++) {
+            v = coeffFilter[j] + error;
             intV  = ROUNDED_DIV(v, sum);
-            coeffFilter_normalized[i * (outFilterSize) + j] = intV;
-            coeffFilter_normalized[i * (outFilterSize) + j] = coeffFilter_normalized[i * (outFilterSize) + j]>>2; //added to negate double increment and match our precision
-            error                                  = v - intV * sum;
+            outFilter[j] = intV;
+            outFilter[j] = outFilter[j]>>2;
+            error = v - intV * sum;
         }
-    }
-    
-    for (int p=0; p<num_phases; p++) {
-        for (int t=0; t<filterSize; t++) {
-            outFilter[p*filterSize + t] = coeffFilter_normalized[p*filterSize + t];
-        }
-    }
-       
-    /*incorporate filter less than 12 tap into a 12 tap*/
-    fstart_Idx=0, fend_Idx=0, half_Idx=0;
-    middleIdx = (MAX_FILTER_SIZE/2); //center location for 12 tap 
-    half_Idx = (outFilterSize/2);
-    if ( (outFilterSize - (half_Idx<<1)) ==0) //evenOdd
-    {
-        fstart_Idx = middleIdx - half_Idx;
-        fend_Idx = middleIdx + half_Idx;
-    }
-    else
-    {
-        fstart_Idx = middleIdx - (half_Idx);
-        fend_Idx = middleIdx + half_Idx + 1;
-    }
-    //printf("DEBUG: outFilterSize=%d fstart_Idx=%d fend_Idx=%d half_Idx=%d\n",outFilterSize,fstart_Idx,fend_Idx,half_Idx);
-    
-    for ( i = 0; i < num_phases; i++) {
-        for ( j = 0; j < MAX_FILTER_SIZE; j++) {
-            
+
+        for (j = 0; j < MAX_FILTER_SIZE; j++) {
             CCS_filtCoeff[i*MAX_FILTER_SIZE + j] = 0;
-            if ((j >= fstart_Idx) && (j< fend_Idx))
-                CCS_filtCoeff[i*MAX_FILTER_SIZE + j] = outFilter[i * (outFilterSize) + (j-fstart_Idx)];
-            
+            if ((j >= fstart_Idx) && (j < fstart_Idx + filterSize))
+                CCS_filtCoeff[i*MAX_FILTER_SIZE + j] = outFilter[j-fstart_Idx];
         }
-    }
-	
-#if 1
-    /*Make sure filterCoeffs within a phase sum to 4096*/
-    int ph_max_sum = 1<<MAX_FILTER_SIZE;
-	int sumVal= 0 , maxIdx=0, maxVal=0, diffVal=0;
-    for ( i = 0; i < num_phases; i++) {
+
+        /*Make sure filterCoeffs within a phase sum to 4096. maxIdx carries over
+          from the previous phase when no tap is positive*/
         sumVal = 0;
         maxVal = 0;
-        for ( j = 0; j < MAX_FILTER_SIZE; j++) {
+        for (j = 0; j < MAX_FILTER_SIZE; j++) {
             sumVal+=CCS_filtCoeff[i*MAX_FILTER_SIZE + j];
             if ( CCS_filtCoeff[i*MAX_FILTER_SIZE + j] > maxVal)
-            {				  
+            {
                 maxVal = CCS_filtCoeff[i*MAX_FILTER_SIZE + j];
                 maxIdx = j;
-            }             			  
+            }
         }
         diffVal = ph_max_sum - sumVal ;
         if (diffVal>0)
               CCS_filtCoeff[i*MAX_FILTER_SIZE + maxIdx] = CCS_filtCoeff[i*MAX_FILTER_SIZE + maxIdx]+diffVal;
-    }   
-#endif
-	
-           
-#ifdef COEFF_DUMP                       
+    }
+
+#ifdef COEFF_DUMP
     fprintf(fp,"taps/phases, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12\n");
     for ( i = 0; i < num_phases; i++) {
         fprintf(fp,"%d, ", i+1);
@@ -815,16 +736,105 @@ void Generate_cardinal_cubic_spline(int src, int dst, int filterSize, int64_t B,
             fprintf(fp,"%d,  ",CCS_filtCoeff[i*MAX_FILTER_SIZE + j]);
         }
         fprintf(fp,"\n");
-    }      
-#endif      
-
-    free(coeffFilter);
-    free(coeffFilter_reduced);
-    free(outFilter);
-    free(coeffFilter_normalized);
-#ifdef COEFF_DUMP	
+    }
     fclose(fp);
-#endif	
+#endif
+}
+
+typedef enum {
+  XLNX_FILTER_KERNEL_DEFAULT,   /* ratio based fixed tables / cardinal cubic */
+  XLNX_FILTER_KERNEL_BICUBIC,   /* Mitchell-Netravali cubic with B, C */
+  XLNX_FILTER_KERNEL_LANCZOS2,
+  XLNX_FILTER_KERNEL_LANCZOS3,
+  XLNX_FILTER_KERNEL_BILINEAR,
+  XLNX_FILTER_KERNEL_SHARP,     /* cubic with B=0, C=1 */
+  XLNX_FILTER_KERNEL_NUM,
+} XLNX_FILTER_KERNEL_TYPE;
+
+#define FILTER_CENTER_TAP       5
+#define FILTER_COEFF_ONE        (1<<MAX_FILTER_SIZE)
+
+static double filter_kernel_radius(int kernel)
+{
+    switch (kernel) {
+        case XLNX_FILTER_KERNEL_LANCZOS3: return 3.0;
+        case XLNX_FILTER_KERNEL_BILINEAR: return 1.0;
+        default:                          return 2.0;
+    }
+}
+
+static double filter_sinc(double x)
+{
+    if (x == 0.0)
+        return 1.0;
+    x *= M_PI;
+    return sin(x) / x;
+}
+
+static double filter_kernel_eval(int kernel, double B, double C, double x)
+{
+    x = fabs(x);
+    switch (kernel) {
+        case XLNX_FILTER_KERNEL_LANCZOS2:
+            return (x < 2.0) ? filter_sinc(x) * filter_sinc(x / 2.0) : 0.0;
+        case XLNX_FILTER_KERNEL_LANCZOS3:
+            return (x < 3.0) ? filter_sinc(x) * filter_sinc(x / 3.0) : 0.0;
+        case XLNX_FILTER_KERNEL_BILINEAR:
+            return (x < 1.0) ? 1.0 - x : 0.0;
+        case XLNX_FILTER_KERNEL_SHARP:
+            B = 0.0;
+            C = 1.0;
+            /* fall through */
+        default:
+            if (x < 1.0)
+                return ((12 - 9 * B - 6 * C) * x * x * x +
+                        (-18 + 12 * B + 6 * C) * x * x + (6 - 2 * B)) / 6.0;
+            if (x < 2.0)
+                return ((-B - 6 * C) * x * x * x + (6 * B + 30 * C) * x * x +
+                        (-12 * B - 48 * C) * x + (8 * B + 24 * C)) / 6.0;
+            return 0.0;
+    }
+}
+
+/*
+ * Generates 64 phases of 12 taps for the given kernel at scale ratio
+ * src/dst (values below 1 are upscaling). Phase p samples the kernel at
+ * tap distance (t - FILTER_CENTER_TAP - p/64), the same placement used by
+ * Generate_cardinal_cubic_spline. For downscaling the kernel is stretched
+ * by the ratio, limited to what fits in 12 taps. Each phase sums to 4096.
+ */
+void Generate_kernel_filter(int kernel, double B, double C, double ratio, int16_t coeff[64][12])
+{
+    double radius = filter_kernel_radius(kernel);
+    double s = (ratio > 1.0) ? 1.0 / ratio : 1.0;
+    double w[MAX_FILTER_SIZE];
+    int p, t;
+
+    /* furthest usable tap is FILTER_CENTER_TAP+1 pixels from the center */
+    if (radius / s > (FILTER_CENTER_TAP + 1))
+        s = radius / (FILTER_CENTER_TAP + 1);
+
+    for (p = 0; p < NR_PHASES; p++) {
+        double sum = 0.0, err = 0.0;
+        int isum = 0, maxIdx = 0;
+
+        for (t = 0; t < MAX_FILTER_SIZE; t++) {
+            double d = (double)(t - FILTER_CENTER_TAP) - (double)p / NR_PHASES;
+            w[t] = filter_kernel_eval(kernel, B, C, d * s);
+            sum += w[t];
+        }
+        for (t = 0; t < MAX_FILTER_SIZE; t++) {
+            /* error diffusion keeps the rounded phase close to unity gain */
+            double v = w[t] * FILTER_COEFF_ONE / sum + err;
+            int iv = (int)floor(v + 0.5);
+            err = v - iv;
+            coeff[p][t] = (int16_t)iv;
+            isum += iv;
+            if (coeff[p][t] > coeff[p][maxIdx])
+                maxIdx = t;
+        }
+        coeff[p][maxIdx] += FILTER_COEFF_ONE - isum;
+    }
 }
 
 
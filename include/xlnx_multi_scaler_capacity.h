@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2021, Xilinx Inc - All rights reserved
+ * Xilinx Multiscaler XMA Plugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+#ifndef _XLNX_MULTI_SCALER_CAPACITY_H_
+#define _XLNX_MULTI_SCALER_CAPACITY_H_
+
+/**
+ *  @file
+ *  Capacity queries exported by the multiscaler plugin library. Applications
+ *  resolve them with dlsym() on the plugin they load through XMA.
+ *
+ *  Load is modelled in kernel clock cycles per second: each channel streams
+ *  max(in, out) width by max(in, out) height pixels at 4 pixels per clock,
+ *  plus a fixed per channel cost for descriptor and coefficient fetch,
+ *  once per input frame. Channel inputs cascade from the previous output.
+ */
+#include <stdint.h>
+#include <xma.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+  uint32_t num_sessions;
+  uint64_t read_pixels_per_sec;
+  uint64_t write_pixels_per_sec;
+  uint64_t cycles_per_sec;           /* committed (or estimated) kernel cycles */
+  uint64_t capacity_cycles_per_sec;  /* usable cycles after headroom */
+  uint32_t load_percent;             /* cycles_per_sec against capacity */
+} XlnxScalerCuLoad;
+
+/* Load committed on a CU by the sessions of this process */
+int32_t xlnx_multi_scaler_get_cu_load(int32_t dev_index, int32_t cu_index, XlnxScalerCuLoad *load);
+
+/* Load a session with these properties would add, without creating it */
+int32_t xlnx_multi_scaler_estimate_load(const XmaScalerProperties *props, XlnxScalerCuLoad *load);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _XLNX_MULTI_SCALER_CAPACITY_H_ */
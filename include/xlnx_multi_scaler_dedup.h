@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2021, Xilinx Inc - All rights reserved
+ * Xilinx Multiscaler XMA Plugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+#ifndef _XLNX_MULTI_SCALER_DEDUP_H_
+#define _XLNX_MULTI_SCALER_DEDUP_H_
+
+/**
+ *  @file
+ *  Duplicate frame detection, enabled with the "dedup_frames" session
+ *  parameter. A frame whose fingerprint matches the previous frame is not
+ *  scaled again; recv returns the previous outputs with the new pts.
+ *
+ *  Host frames are fingerprinted by hashing every row of both planes. The
+ *  "dedup_sample_rows" parameter (0, the default, hashes all rows) limits
+ *  this to about that many evenly spaced rows per plane, which is cheaper
+ *  but misses a change confined to rows outside the sample. Device frames
+ *  can not be hashed cheaply and are only matched when the producer tags
+ *  them. A tag, when given, is used for host frames as well.
+ */
+#include <stdint.h>
+#include <xma.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Tags the next frame sent on the session. Equal non-zero tags mean equal
+ * content; 0 means unknown and always scales the frame.
+ */
+int32_t xlnx_multi_scaler_set_frame_tag(XmaScalerSession *session, uint64_t tag);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _XLNX_MULTI_SCALER_DEDUP_H_ */
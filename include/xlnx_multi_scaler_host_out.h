@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2021, Xilinx Inc - All rights reserved
+ * Xilinx Multiscaler XMA Plugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+#ifndef _XLNX_MULTI_SCALER_HOST_OUT_H_
+#define _XLNX_MULTI_SCALER_HOST_OUT_H_
+
+/**
+ *  @file
+ *  Layouts of host output frames that differ from the output format.
+ *
+ *  The "unpack_10bit_output" session parameter selects how NV12 10LE32
+ *  outputs read back to host frames are written:
+ *
+ *  - XLNX_HOST_OUT_10LE32: as produced by the kernel.
+ *  - XLNX_HOST_OUT_P010: 16-bit MSB aligned samples, width * 2 bytes per
+ *    row. frame_props keeps the 10LE32 format.
+ *  - XLNX_HOST_OUT_NV12_DITHER: 8-bit samples, width bytes per row. The
+ *    frame is returned with format XMA_VCU_NV12_FMT_TYPE and
+ *    bits_per_pixel 8.
+ *
+ *  For P010 and dithered NV12 the caller allocates the frame for the
+ *  converted layout, not for 10LE32. Before recv, frame_props.linesize[0]
+ *  must hold the row pitch of both planes as allocated, at least the row
+ *  size above, and frame_props.height the output height. data[0] then
+ *  holds height rows and data[1] height / 2 rows of that pitch. recv checks
+ *  the pitch and height and fails the frame when they are too small.
+ *
+ *  Outputs with a "tensor_<n>" parameter are read back to host frames as a
+ *  planar RGB (or BGR) tensor of 32-bit float, uint8 or int8 elements. The
+ *  three planes lie back to back in data[0], each output height rows of
+ *  output width elements; data[1] is not written. The caller allocates
+ *  data[0] for that and sets frame_props.linesize[0] to the row pitch in
+ *  bytes, at least width * element size, and frame_props.height to at
+ *  least 3 * output height, the rows of all planes. recv checks both.
+ *  XmaFormatType has no tensor type, so frame_props is returned as the
+ *  caller set it: format, bits_per_pixel and linesize are not rewritten
+ *  and the tensor layout follows from the "tensor_<n>" parameter.
+ */
+
+/* Values of the "unpack_10bit_output" parameter */
+enum
+{
+  XLNX_HOST_OUT_10LE32,
+  XLNX_HOST_OUT_P010,
+  XLNX_HOST_OUT_NV12_DITHER,
+};
+
+#endif /* _XLNX_MULTI_SCALER_HOST_OUT_H_ */
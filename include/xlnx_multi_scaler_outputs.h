@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2021, Xilinx Inc - All rights reserved
+ * Xilinx Multiscaler XMA Plugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+#ifndef _XLNX_MULTI_SCALER_OUTPUTS_H_
+#define _XLNX_MULTI_SCALER_OUTPUTS_H_
+
+/**
+ *  @file
+ *  Runtime output control for sessions created with the "suspendable_outputs"
+ *  parameter.
+ *
+ *  A suspended output is dropped from the descriptor chain and its buffer
+ *  pools are released. The next active output then scales from the nearest
+ *  active output above it, or from the session input, with its filters
+ *  regenerated for the new ratio. Outputs with their own crop_<n> can not be
+ *  rewired. recv still fills every frame of the list; a suspended output is
+ *  returned with do_not_encode set and, for device buffers, no buffer.
+ *
+ *  Calls must come from the thread driving send/recv, after a recv, when no
+ *  frame is in flight; otherwise they return XMA_TRY_AGAIN. With
+ *  "shared_pools" a suspended output only hands back its share of the pool.
+ */
+#include <stdint.h>
+#include <xma.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int32_t xlnx_multi_scaler_suspend_output(XmaScalerSession *session, int32_t output_id);
+
+/* May fail with admission "refuse" when the CU can not take the extra load */
+int32_t xlnx_multi_scaler_resume_output(XmaScalerSession *session, int32_t output_id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _XLNX_MULTI_SCALER_OUTPUTS_H_ */
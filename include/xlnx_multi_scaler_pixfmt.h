@@ -0,0 +1,454 @@
+/*
+ * Copyright (C) 2021, Xilinx Inc - All rights reserved
+ * Xilinx Multiscaler XMA Plugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+#ifndef _XLNX_MULTI_SCALER_PIXFMT_H_
+#define _XLNX_MULTI_SCALER_PIXFMT_H_
+
+/**
+ *  @file
+ *  Host side pixel packing helpers used while copying frames between host
+ *  memory and the scaler staging buffers.
+ *
+ *  NV12_10LE32 stores three 10-bit samples per 32-bit little endian word
+ *  (bits 0-9, 10-19, 20-29, bits 30-31 unused). P010 and P016 both keep
+ *  samples MSB aligned in 16-bit containers, so the same row packer handles
+ *  them (P016 simply loses its 6 LSBs).
+ *  The reverse direction unpacks 10LE32 to P010 or to dithered 8-bit NV12,
+ *  or converts 8-bit NV12 to a planar RGB/BGR tensor (float, uint8 or int8)
+ *  with optional per channel mean and scale.
+ */
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define XLNX_PIXFMT_X86_SIMD 1
+#include <tmmintrin.h>
+#endif
+
+/* Number of 10LE32 words needed to hold 'samples' 10-bit samples */
+#define XLNX_10LE32_WORDS(samples)   (((samples) + 2) / 3)
+
+static inline void
+xlnx_pack_p010_row_c (const uint16_t *src, uint32_t *dst, int samples, int start)
+{
+    int i;
+
+    for (i = start; i + 3 <= samples; i += 3) {
+        *dst++ = ((uint32_t)(src[i] >> 6)) |
+                 ((uint32_t)(src[i + 1] >> 6) << 10) |
+                 ((uint32_t)(src[i + 2] >> 6) << 20);
+    }
+    if (i < samples) {
+        uint32_t word = (uint32_t)(src[i] >> 6);
+        if (i + 1 < samples)
+            word |= (uint32_t)(src[i + 1] >> 6) << 10;
+        *dst = word;
+    }
+}
+
+#ifdef XLNX_PIXFMT_X86_SIMD
+/* Packs 12 samples per iteration into 4 words using byte shuffles */
+__attribute__((target("ssse3"))) static void
+xlnx_pack_p010_row_ssse3 (const uint16_t *src, uint32_t *dst, int samples)
+{
+    const __m128i a_lo = _mm_setr_epi8(0, 1, -1, -1, 6, 7, -1, -1, 12, 13, -1, -1, -1, -1, -1, -1);
+    const __m128i a_hi = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 3, -1, -1);
+    const __m128i b_lo = _mm_setr_epi8(2, 3, -1, -1, 8, 9, -1, -1, 14, 15, -1, -1, -1, -1, -1, -1);
+    const __m128i b_hi = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 4, 5, -1, -1);
+    const __m128i c_lo = _mm_setr_epi8(4, 5, -1, -1, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i c_hi = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, 0, 1, -1, -1, 6, 7, -1, -1);
+    int i = 0;
+
+    /* 16 samples are loaded per 12 consumed, keep the over-read in bounds */
+    for (; i + 16 <= samples; i += 12) {
+        __m128i lo = _mm_srli_epi16(_mm_loadu_si128((const __m128i *)(src + i)), 6);
+        __m128i hi = _mm_srli_epi16(_mm_loadu_si128((const __m128i *)(src + i + 8)), 6);
+        __m128i a  = _mm_or_si128(_mm_shuffle_epi8(lo, a_lo), _mm_shuffle_epi8(hi, a_hi));
+        __m128i b  = _mm_or_si128(_mm_shuffle_epi8(lo, b_lo), _mm_shuffle_epi8(hi, b_hi));
+        __m128i c  = _mm_or_si128(_mm_shuffle_epi8(lo, c_lo), _mm_shuffle_epi8(hi, c_hi));
+        __m128i w  = _mm_or_si128(a, _mm_or_si128(_mm_slli_epi32(b, 10), _mm_slli_epi32(c, 20)));
+        _mm_storeu_si128((__m128i *)dst, w);
+        dst += 4;
+    }
+    xlnx_pack_p010_row_c(src, dst, samples, i);
+}
+
+static inline int
+xlnx_pixfmt_has_ssse3 (void)
+{
+    static int has_ssse3 = -1;
+    if (has_ssse3 < 0)
+        has_ssse3 = __builtin_cpu_supports("ssse3") ? 1 : 0;
+    return has_ssse3;
+}
+#endif
+
+/* Packs one row of MSB aligned 16-bit samples into 10LE32 words */
+static inline void
+xlnx_pack_p010_row (const uint16_t *src, uint32_t *dst, int samples)
+{
+#ifdef XLNX_PIXFMT_X86_SIMD
+    if (xlnx_pixfmt_has_ssse3()) {
+        xlnx_pack_p010_row_ssse3(src, dst, samples);
+        return;
+    }
+#endif
+    xlnx_pack_p010_row_c(src, dst, samples, 0);
+}
+
+/**
+ * Packs a P010/P016 semi-planar frame into a 10LE32 staging buffer.
+ * Luma and interleaved chroma rows both carry 'width' samples. The chroma
+ * plane is written at dst_stride * dst_hgt_align bytes from the start.
+ */
+static inline void
+xlnx_pack_p010_frame (const uint8_t *src_y, int src_y_stride,
+                      const uint8_t *src_uv, int src_uv_stride,
+                      uint8_t *dst, int dst_stride, int dst_hgt_align,
+                      int width, int height)
+{
+    uint8_t *dst_uv = dst + (size_t)dst_stride * dst_hgt_align;
+    int h;
+
+    for (h = 0; h < height; h++) {
+        xlnx_pack_p010_row((const uint16_t *)(src_y + (size_t)h * src_y_stride),
+                           (uint32_t *)(dst + (size_t)h * dst_stride), width);
+    }
+    for (h = 0; h < height / 2; h++) {
+        xlnx_pack_p010_row((const uint16_t *)(src_uv + (size_t)h * src_uv_stride),
+                           (uint32_t *)(dst_uv + (size_t)h * dst_stride), width);
+    }
+}
+
+static inline void
+xlnx_unpack_10le32_row_c (const uint32_t *src, uint16_t *dst, int samples, int shift, int start)
+{
+    int i;
+
+    for (i = start; i < samples; i++) {
+        uint32_t word = src[i / 3];
+        dst[i] = (uint16_t)(((word >> (10 * (i % 3))) & 0x3FF) << shift);
+    }
+}
+
+#ifdef XLNX_PIXFMT_X86_SIMD
+/* Unpacks 4 words into 12 samples per iteration using byte shuffles */
+__attribute__((target("ssse3"))) static void
+xlnx_unpack_10le32_row_ssse3 (const uint32_t *src, uint16_t *dst, int samples, int shift)
+{
+    const __m128i mask  = _mm_set1_epi32(0x3FF);
+    const __m128i cnt   = _mm_cvtsi32_si128(shift);
+    const __m128i ab_0  = _mm_setr_epi8(0, 1, 2, 3, -1, -1, 4, 5, 6, 7, -1, -1, 8, 9, 10, 11);
+    const __m128i c_0   = _mm_setr_epi8(-1, -1, -1, -1, 0, 1, -1, -1, -1, -1, 4, 5, -1, -1, -1, -1);
+    const __m128i ab_1  = _mm_setr_epi8(-1, -1, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i c_1   = _mm_setr_epi8(8, 9, -1, -1, -1, -1, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1);
+    int i = 0;
+
+    for (; i + 12 <= samples; i += 12) {
+        __m128i w  = _mm_loadu_si128((const __m128i *)(src + i / 3));
+        __m128i a  = _mm_sll_epi32(_mm_and_si128(w, mask), cnt);
+        __m128i b  = _mm_sll_epi32(_mm_and_si128(_mm_srli_epi32(w, 10), mask), cnt);
+        __m128i c  = _mm_sll_epi32(_mm_and_si128(_mm_srli_epi32(w, 20), mask), cnt);
+        __m128i ab = _mm_or_si128(a, _mm_slli_epi32(b, 16));
+        __m128i o0 = _mm_or_si128(_mm_shuffle_epi8(ab, ab_0), _mm_shuffle_epi8(c, c_0));
+        __m128i o1 = _mm_or_si128(_mm_shuffle_epi8(ab, ab_1), _mm_shuffle_epi8(c, c_1));
+        _mm_storeu_si128((__m128i *)(dst + i), o0);
+        _mm_storel_epi64((__m128i *)(dst + i + 8), o1);
+    }
+    xlnx_unpack_10le32_row_c(src, dst, samples, shift, i);
+}
+#endif
+
+/* Unpacks one row of 10LE32 words to 16-bit samples shifted left by 'shift' */
+static inline void
+xlnx_unpack_10le32_row (const uint32_t *src, uint16_t *dst, int samples, int shift)
+{
+#ifdef XLNX_PIXFMT_X86_SIMD
+    if (xlnx_pixfmt_has_ssse3()) {
+        xlnx_unpack_10le32_row_ssse3(src, dst, samples, shift);
+        return;
+    }
+#endif
+    xlnx_unpack_10le32_row_c(src, dst, samples, shift, 0);
+}
+
+/**
+ * Unpacks a 10LE32 semi-planar frame to P010 (MSB aligned 16-bit samples).
+ * The source chroma plane starts at src_stride * src_hgt_align bytes.
+ */
+static inline void
+xlnx_unpack_10le32_frame_p010 (const uint8_t *src, int src_stride, int src_hgt_align,
+                               uint8_t *dst_y, uint8_t *dst_uv, int dst_stride,
+                               int width, int height)
+{
+    const uint8_t *src_uv = src + (size_t)src_stride * src_hgt_align;
+    int h;
+
+    for (h = 0; h < height; h++) {
+        xlnx_unpack_10le32_row((const uint32_t *)(src + (size_t)h * src_stride),
+                               (uint16_t *)(dst_y + (size_t)h * dst_stride), width, 6);
+    }
+    for (h = 0; h < height / 2; h++) {
+        xlnx_unpack_10le32_row((const uint32_t *)(src_uv + (size_t)h * src_stride),
+                               (uint16_t *)(dst_uv + (size_t)h * dst_stride), width, 6);
+    }
+}
+
+/* 2x2 ordered dither thresholds for the 10 to 8 bit reduction */
+static const uint8_t xlnx_dither_2x2[2][2] = { { 0, 2 }, { 3, 1 } };
+
+static inline void
+xlnx_dither_row_8bit (const uint16_t *src, uint8_t *dst, int samples, int row, int interleaved)
+{
+    const uint8_t *d = xlnx_dither_2x2[row & 1];
+    int i;
+
+    for (i = 0; i < samples; i++) {
+        /* U and V of one chroma pair share a threshold */
+        uint32_t v = (src[i] + d[(interleaved ? (i >> 1) : i) & 1]) >> 2;
+        dst[i] = (uint8_t)(v > 255 ? 255 : v);
+    }
+}
+
+/**
+ * Unpacks a 10LE32 semi-planar frame to 8-bit NV12 with ordered dithering.
+ * Each row is unpacked into 'row_buf' (at least 'width' samples) and then
+ * reduced while still cache resident.
+ */
+static inline void
+xlnx_unpack_10le32_frame_nv12 (const uint8_t *src, int src_stride, int src_hgt_align,
+                               uint8_t *dst_y, uint8_t *dst_uv, int dst_stride,
+                               int width, int height, uint16_t *row_buf)
+{
+    const uint8_t *src_uv = src + (size_t)src_stride * src_hgt_align;
+    int h;
+
+    for (h = 0; h < height; h++) {
+        xlnx_unpack_10le32_row((const uint32_t *)(src + (size_t)h * src_stride), row_buf, width, 0);
+        xlnx_dither_row_8bit(row_buf, dst_y + (size_t)h * dst_stride, width, h, 0);
+    }
+    for (h = 0; h < height / 2; h++) {
+        xlnx_unpack_10le32_row((const uint32_t *)(src_uv + (size_t)h * src_stride), row_buf, width, 0);
+        xlnx_dither_row_8bit(row_buf, dst_uv + (size_t)h * dst_stride, width, h, 1);
+    }
+}
+
+/**
+ * Copies a semi-planar frame to a layout with a different stride or plane
+ * elevation, 'row_bytes' bytes per row.
+ */
+static inline void
+xlnx_copy_frame_semiplanar (const uint8_t *src, int src_stride, int src_hgt_align,
+                            uint8_t *dst_y, uint8_t *dst_uv, int dst_stride,
+                            int row_bytes, int height)
+{
+    const uint8_t *src_uv = src + (size_t)src_stride * src_hgt_align;
+    int h;
+
+    for (h = 0; h < height; h++)
+        memcpy(dst_y + (size_t)h * dst_stride, src + (size_t)h * src_stride, row_bytes);
+    for (h = 0; h < height / 2; h++)
+        memcpy(dst_uv + (size_t)h * dst_stride, src_uv + (size_t)h * src_stride, row_bytes);
+}
+
+/* Element types of planar RGB tensors */
+typedef enum
+{
+    XLNX_TENSOR_F32,
+    XLNX_TENSOR_U8,
+    XLNX_TENSOR_S8,
+} XlnxTensorType;
+
+/**
+ * NV12 to planar RGB conversion. Each plane value is
+ * (clamp(rgb, 0, 255) - mean) * scale, rounded half to even and saturated
+ * for integer tensors, the same in the SIMD and the scalar path. mean and
+ * scale are given in plane order (R, G, B or B, G, R).
+ */
+typedef struct
+{
+    int   type;          /* XlnxTensorType */
+    int   elem_size;
+    float y_offset;      /* 16 for limited range, 0 for full range */
+    float ky, kr_v, kg_u, kg_v, kb_u;
+    float scale[3];      /* per plane */
+    float bias[3];       /* -mean * scale */
+    int   plane_r, plane_g, plane_b;
+} XlnxTensorConv;
+
+static inline void
+xlnx_tensor_conv_init (XlnxTensorConv *conv, int bt709, int full_range, int bgr, int type,
+                       const float mean[3], const float scale[3])
+{
+    double kr = bt709 ? 0.2126 : 0.299;
+    double kb = bt709 ? 0.0722 : 0.114;
+    double kg = 1.0 - kr - kb;
+    double sy = full_range ? 1.0 : 255.0 / 219.0;
+    double sc = full_range ? 1.0 : 255.0 / 224.0;
+    int c;
+
+    conv->type      = type;
+    conv->elem_size = (type == XLNX_TENSOR_F32) ? 4 : 1;
+    conv->y_offset  = full_range ? 0.0f : 16.0f;
+    conv->ky        = (float)sy;
+    conv->kr_v      = (float)(2.0 * (1.0 - kr) * sc);
+    conv->kb_u      = (float)(2.0 * (1.0 - kb) * sc);
+    conv->kg_u      = (float)(2.0 * kb * (1.0 - kb) / kg * sc);
+    conv->kg_v      = (float)(2.0 * kr * (1.0 - kr) / kg * sc);
+    for (c = 0; c < 3; c++) {
+        conv->scale[c] = scale ? scale[c] : 1.0f;
+        conv->bias[c]  = -(mean ? mean[c] : 0.0f) * conv->scale[c];
+    }
+    conv->plane_r = bgr ? 2 : 0;
+    conv->plane_g = 1;
+    conv->plane_b = bgr ? 0 : 2;
+}
+
+static inline void
+xlnx_tensor_store_c (const XlnxTensorConv *conv, uint8_t *plane, int c, int i, float v)
+{
+    float x = (v < 0.0f ? 0.0f : (v > 255.0f ? 255.0f : v)) * conv->scale[c] + conv->bias[c];
+    int q;
+
+    if (conv->type == XLNX_TENSOR_F32) {
+        memcpy(plane + (size_t)i * 4, &x, sizeof(x));
+        return;
+    }
+    /* matches _mm_cvtps_epi32 under the default rounding mode */
+    q = (int)lrintf(x);
+    if (conv->type == XLNX_TENSOR_U8)
+        plane[i] = (uint8_t)(q < 0 ? 0 : (q > 255 ? 255 : q));
+    else
+        plane[i] = (uint8_t)(int8_t)(q < -128 ? -128 : (q > 127 ? 127 : q));
+}
+
+static inline void
+xlnx_nv12_to_tensor_row_c (const uint8_t *y, const uint8_t *uv, uint8_t *planes[3],
+                           int width, int start, const XlnxTensorConv *conv)
+{
+    int i;
+
+    for (i = start; i < width; i++) {
+        float yf = (y[i] - conv->y_offset) * conv->ky;
+        float uf = uv[i & ~1] - 128.0f;
+        float vf = uv[i | 1] - 128.0f;
+
+        xlnx_tensor_store_c(conv, planes[conv->plane_r], conv->plane_r, i, yf + conv->kr_v * vf);
+        xlnx_tensor_store_c(conv, planes[conv->plane_g], conv->plane_g, i, yf - conv->kg_u * uf - conv->kg_v * vf);
+        xlnx_tensor_store_c(conv, planes[conv->plane_b], conv->plane_b, i, yf + conv->kb_u * uf);
+    }
+}
+
+#ifdef XLNX_PIXFMT_X86_SIMD
+__attribute__((target("ssse3"))) static inline void
+xlnx_tensor_store_ssse3 (const XlnxTensorConv *conv, uint8_t *plane, int c, int i, __m128 lo, __m128 hi)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 max  = _mm_set1_ps(255.0f);
+    const __m128 sc   = _mm_set1_ps(conv->scale[c]);
+    const __m128 bias = _mm_set1_ps(conv->bias[c]);
+    __m128i q;
+
+    lo = _mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(lo, zero), max), sc), bias);
+    hi = _mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(hi, zero), max), sc), bias);
+    if (conv->type == XLNX_TENSOR_F32) {
+        _mm_storeu_ps((float *)(plane + (size_t)i * 4), lo);
+        _mm_storeu_ps((float *)(plane + (size_t)i * 4 + 16), hi);
+        return;
+    }
+    /* saturating packs clamp to the integer range */
+    q = _mm_packs_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi));
+    q = (conv->type == XLNX_TENSOR_U8) ? _mm_packus_epi16(q, q) : _mm_packs_epi16(q, q);
+    _mm_storel_epi64((__m128i *)(plane + i), q);
+}
+
+/* Converts 8 pixels per iteration, chroma pairs are spread with byte shuffles */
+__attribute__((target("ssse3"))) static void
+xlnx_nv12_to_tensor_row_ssse3 (const uint8_t *y, const uint8_t *uv, uint8_t *planes[3],
+                               int width, const XlnxTensorConv *conv)
+{
+    const __m128i y_lo = _mm_setr_epi8(0, -1, -1, -1, 1, -1, -1, -1, 2, -1, -1, -1, 3, -1, -1, -1);
+    const __m128i y_hi = _mm_setr_epi8(4, -1, -1, -1, 5, -1, -1, -1, 6, -1, -1, -1, 7, -1, -1, -1);
+    const __m128i u_lo = _mm_setr_epi8(0, -1, -1, -1, 0, -1, -1, -1, 2, -1, -1, -1, 2, -1, -1, -1);
+    const __m128i u_hi = _mm_setr_epi8(4, -1, -1, -1, 4, -1, -1, -1, 6, -1, -1, -1, 6, -1, -1, -1);
+    const __m128i v_lo = _mm_setr_epi8(1, -1, -1, -1, 1, -1, -1, -1, 3, -1, -1, -1, 3, -1, -1, -1);
+    const __m128i v_hi = _mm_setr_epi8(5, -1, -1, -1, 5, -1, -1, -1, 7, -1, -1, -1, 7, -1, -1, -1);
+    const __m128 y_off = _mm_set1_ps(conv->y_offset);
+    const __m128 c_off = _mm_set1_ps(128.0f);
+    const __m128 ky    = _mm_set1_ps(conv->ky);
+    const __m128 kr_v  = _mm_set1_ps(conv->kr_v);
+    const __m128 kg_u  = _mm_set1_ps(conv->kg_u);
+    const __m128 kg_v  = _mm_set1_ps(conv->kg_v);
+    const __m128 kb_u  = _mm_set1_ps(conv->kb_u);
+    int i = 0;
+
+    for (; i + 8 <= width; i += 8) {
+        __m128i yv  = _mm_loadl_epi64((const __m128i *)(y + i));
+        __m128i uvv = _mm_loadl_epi64((const __m128i *)(uv + i));
+        __m128 y0 = _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(_mm_shuffle_epi8(yv, y_lo)), y_off), ky);
+        __m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(_mm_shuffle_epi8(yv, y_hi)), y_off), ky);
+        __m128 u0 = _mm_sub_ps(_mm_cvtepi32_ps(_mm_shuffle_epi8(uvv, u_lo)), c_off);
+        __m128 u1 = _mm_sub_ps(_mm_cvtepi32_ps(_mm_shuffle_epi8(uvv, u_hi)), c_off);
+        __m128 v0 = _mm_sub_ps(_mm_cvtepi32_ps(_mm_shuffle_epi8(uvv, v_lo)), c_off);
+        __m128 v1 = _mm_sub_ps(_mm_cvtepi32_ps(_mm_shuffle_epi8(uvv, v_hi)), c_off);
+
+        xlnx_tensor_store_ssse3(conv, planes[conv->plane_r], conv->plane_r, i,
+                                _mm_add_ps(y0, _mm_mul_ps(kr_v, v0)),
+                                _mm_add_ps(y1, _mm_mul_ps(kr_v, v1)));
+        xlnx_tensor_store_ssse3(conv, planes[conv->plane_g], conv->plane_g, i,
+                                _mm_sub_ps(y0, _mm_add_ps(_mm_mul_ps(kg_u, u0), _mm_mul_ps(kg_v, v0))),
+                                _mm_sub_ps(y1, _mm_add_ps(_mm_mul_ps(kg_u, u1), _mm_mul_ps(kg_v, v1))));
+        xlnx_tensor_store_ssse3(conv, planes[conv->plane_b], conv->plane_b, i,
+                                _mm_add_ps(y0, _mm_mul_ps(kb_u, u0)),
+                                _mm_add_ps(y1, _mm_mul_ps(kb_u, u1)));
+    }
+    xlnx_nv12_to_tensor_row_c(y, uv, planes, width, i, conv);
+}
+#endif
+
+/**
+ * Converts an 8-bit NV12 frame to a planar RGB tensor while copying it out
+ * of the staging buffer. The three planes are written back to back at dst,
+ * height rows of width elements each, rows dst_stride bytes apart. The
+ * source chroma plane starts at src_stride * src_hgt_align bytes.
+ */
+static inline void
+xlnx_nv12_to_tensor (const uint8_t *src, int src_stride, int src_hgt_align,
+                     uint8_t *dst, int dst_stride, int width, int height,
+                     const XlnxTensorConv *conv)
+{
+    const uint8_t *src_uv = src + (size_t)src_stride * src_hgt_align;
+    uint8_t *planes[3];
+    int h, c;
+
+    for (h = 0; h < height; h++) {
+        const uint8_t *y  = src + (size_t)h * src_stride;
+        const uint8_t *uv = src_uv + (size_t)(h / 2) * src_stride;
+
+        for (c = 0; c < 3; c++)
+            planes[c] = dst + ((size_t)c * height + h) * dst_stride;
+#ifdef XLNX_PIXFMT_X86_SIMD
+        if (xlnx_pixfmt_has_ssse3()) {
+            xlnx_nv12_to_tensor_row_ssse3(y, uv, planes, width, conv);
+            continue;
+        }
+#endif
+        xlnx_nv12_to_tensor_row_c(y, uv, planes, width, 0, conv);
+    }
+}
+
+#endif
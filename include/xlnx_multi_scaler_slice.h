@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2021, Xilinx Inc - All rights reserved
+ * Xilinx Multiscaler XMA Plugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+#ifndef _XLNX_MULTI_SCALER_SLICE_H_
+#define _XLNX_MULTI_SCALER_SLICE_H_
+
+/**
+ *  @file
+ *  Slice streaming, enabled with the "slice_rows" session parameter. A frame
+ *  is scaled in horizontal bands as its producer reports rows written, so
+ *  the top of every output is ready before the bottom of the input exists.
+ *  A band is started once at least "slice_rows" new input rows are ready,
+ *  or the frame is complete.
+ *
+ *  Each band holds the output rows whose vertical filter taps are all
+ *  available; band edges fall on rows with a zero filter phase. The kernel
+ *  has no start phase or row skip, so a band below the top of the frame is
+ *  scaled from one filter length of input rows above its edge into a
+ *  scratch buffer, and copied to the output without the rows that overlap
+ *  the band before it. There are no seams at band edges; rows match a
+ *  whole frame scale up to the rounding of the line rate. The copy costs
+ *  kernel time for the band's output rows and takes a second descriptor,
+ *  which limits slicing to 4 outputs. The first band of a frame may start
+ *  while the last bands of the previous one still run.
+ *
+ *  Outputs must be NV12 or NV12 10LE32. Only device input frames can be
+ *  streamed; host frames are uploaded, and scaled, whole.
+ */
+#include <stdint.h>
+#include <xma.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Reports that rows [0, rows_ready) of the frame are written. The first call
+ * for a frame starts it, later calls pass the same frame. Returns XMA_SUCCESS
+ * once the frame is complete and handed to recv, XMA_SEND_MORE_DATA before.
+ */
+int32_t xlnx_multi_scaler_send_slice(XmaScalerSession *session, XmaFrame *frame,
+                                     uint32_t rows_ready);
+
+/* Waits for the oldest band in flight, if any, and fills rows_done[n] with
+ * the rows of output n scaled so far in the current frame.
+ */
+int32_t xlnx_multi_scaler_recv_slice(XmaScalerSession *session, uint32_t *rows_done);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _XLNX_MULTI_SCALER_SLICE_H_ */
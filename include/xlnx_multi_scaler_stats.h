@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2021, Xilinx Inc - All rights reserved
+ * Xilinx Multiscaler XMA Plugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+#ifndef _XLNX_MULTI_SCALER_STATS_H_
+#define _XLNX_MULTI_SCALER_STATS_H_
+
+/**
+ *  @file
+ *  Per frame luma statistics, enabled with the "luma_stats" session
+ *  parameter. recv measures the luma plane of one output, by default the
+ *  smallest one, or the one named with "luma_stats_output". A lookahead
+ *  can use them for complexity and scene cut estimates without scaling
+ *  and reading the frame itself.
+ *
+ *  XMA side data types are fixed (HDR, QP map), so the statistics are not
+ *  attached to the frames; they are fetched after each recv, matched to
+ *  the frame list by pts. The measured output must be 8-bit NV12, scaled
+ *  into its own buffer (not an alias of another output) and not
+ *  suspendable. For device buffer outputs its luma plane is read back to
+ *  host for this. With "dedup_frames", a frame whose outputs were reused
+ *  is not measured again: the statistics stay those of the previous
+ *  frame, pts included, so a pts that does not match the frame list marks
+ *  a repeated frame.
+ */
+#include <stdint.h>
+#include <xma.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define XLNX_LUMA_HIST_BINS 256
+
+typedef struct
+{
+  uint64_t pts;
+  int32_t  output_id;  /* output measured */
+  uint32_t width;
+  uint32_t height;
+  uint32_t hist[XLNX_LUMA_HIST_BINS];
+  float    mean;
+  float    variance;
+  uint64_t sad;  /* sum of absolute luma differences to the previous frame */
+  int32_t  has_prev;  /* 0 on the first frame, sad is then 0 */
+} XlnxLumaStats;
+
+/* Statistics of the frame list returned by the last recv. Returns
+ * XMA_TRY_AGAIN before the first frame and XMA_ERROR without "luma_stats".
+ * Call from the thread driving recv.
+ */
+int32_t xlnx_multi_scaler_get_luma_stats(XmaScalerSession *session, XlnxLumaStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _XLNX_MULTI_SCALER_STATS_H_ */
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2021, Xilinx Inc - All rights reserved
+ * Xilinx Multiscaler XMA Plugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+#ifndef _XLNX_MULTI_SCALER_THUMBS_H_
+#define _XLNX_MULTI_SCALER_THUMBS_H_
+
+/**
+ *  @file
+ *  Thumbnail outputs. An output becomes one with "thumb_interval_<n>" (scale
+ *  every n-th input frame, counting from the first) and/or "thumb_idr_<n>"
+ *  (scale IDR frames). The interval counts frames sent, not time: for one
+ *  thumbnail every T seconds pass T times the input frame rate. The output
+ *  is linked into the descriptor chain only for the frames it samples, so
+ *  in between it costs no kernel time and holds no pool buffer. Each
+ *  sample is read back and written, row major, into the next tile of a
+ *  host sprite sheet of "thumb_tiles_<n>" = "CxR" tiles (1x1 by default).
+ *
+ *  recv returns thumbnail outputs with do_not_encode set and, for device
+ *  buffers, no buffer; finished sheets are taken with
+ *  xlnx_multi_scaler_take_sprite(). When a sheet completes before the
+ *  previous one was taken, the older one is dropped.
+ *
+ *  Thumbnail outputs must be 8-bit NV12 and are never cascade sources: the
+ *  output after one reads from whatever the thumbnail reads from. At least
+ *  one output must be a regular one. Calls must come from the thread
+ *  driving recv.
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <xma.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* NV12 sheet, luma then chroma, both planes with a pitch of width bytes */
+typedef struct
+{
+  uint32_t width;
+  uint32_t height;
+  uint32_t tile_width;
+  uint32_t tile_height;
+  uint32_t cols;
+  uint32_t rows;
+  size_t   size;
+} XlnxSpriteLayout;
+
+int32_t xlnx_multi_scaler_get_sprite_layout(XmaScalerSession *session, int32_t output_id,
+                                            XlnxSpriteLayout *layout);
+
+/* Copies the complete sheet of output_id to dst (layout size bytes) and the
+ * pts of its tiles to pts (cols * rows entries, may be NULL). num_tiles gets
+ * the tiles written. With 'partial' set, a sheet still being filled is taken
+ * when no complete one is waiting, e.g. at end of stream. Returns
+ * XMA_TRY_AGAIN when there is nothing to take.
+ */
+int32_t xlnx_multi_scaler_take_sprite(XmaScalerSession *session, int32_t output_id, uint8_t *dst,
+                                      uint64_t *pts, uint32_t *num_tiles, int32_t partial);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _XLNX_MULTI_SCALER_THUMBS_H_ */
@@ -21,11 +21,26 @@
 #include <errno.h>
 #include <unistd.h>
 #include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <xma.h>
 #include <xmaplugin.h>
 #include <syslog.h>
+#include <atomic>
 #include "xv_multi_scaler_hw.h"
 #include "xlnx_abr_scaler_coeffs.h"
+#include "xlnx_multi_scaler_pixfmt.h"
+#include "xlnx_multi_scaler_host_out.h"
+#include "xlnx_abr_scaler_coeff_file.h"
+#include "xlnx_multi_scaler_capacity.h"
+#include "xlnx_multi_scaler_dedup.h"
+#include "xlnx_multi_scaler_outputs.h"
+#include "xlnx_multi_scaler_slice.h"
+#include "xlnx_multi_scaler_thumbs.h"
+#include "xlnx_multi_scaler_stats.h"
 
 #undef MEASURE_TIME
 #ifdef MEASURE_TIME
@@ -57,11 +72,46 @@
 #define SCL_IN_HEIGHT_ALIGN  64
 #define SCL_OUT_WIDTH_ALIGN   32
 #define SCL_OUT_HEIGHT_ALIGN  32
+#define SCL_CROP_ADDR_ALIGN   32 /* AXI-MM data width in bytes for 4ppc */
+#define SCL_DEV_REGION_ALIGN  64
 
 #define MAX_WIDTH         3840
 #define MAX_HEIGHT        2160
 #define MAX_PIXELS        (MAX_WIDTH * MAX_HEIGHT)
 
+/* Filter bank : tables per kernel for scale ratios 1.0 to 6.0 in 1/8 steps */
+#define FILTER_BANK_RATIO_STEPS   8
+#define FILTER_BANK_MAX_RATIO     6
+#define FILTER_BANK_NUM_RATIOS    ((FILTER_BANK_MAX_RATIO - 1) * FILTER_BANK_RATIO_STEPS + 1)
+#define FILTER_BANK_USER_SLOTS    4
+#define FILTER_DEFAULT_B          0.0
+#define FILTER_DEFAULT_C          0.6
+
+#define WARM_POOL_MAX_SESSIONS    16
+#define SHARED_POOL_MAX_ENTRIES   32
+#define COEFF_FILE_CACHE_SIZE     8
+#define MAX_BATCH_FRAMES          4 /* frames chained per kernel start, bounded by in-flight buffers */
+#define SHARED_CU_MAX_GROUPS      16
+#define SHARED_CU_WAIT_MS         10000
+#define CU_LOAD_MAX_ENTRIES       32
+#define DDR_MAX_BANKS             4    /* banks tracked per device */
+#define BANK_LOAD_MAX_DEVICES     16
+#define LL_POLL_MS                1    /* low latency completion poll interval */
+#define LL_REPORT_FRAMES          300
+#define WD_STALL_PERIODS          4    /* frame periods past the expected kernel time */
+#define WD_MIN_MS                 20
+#define WD_MAX_MS                 5000
+#define WD_QUEUE_DEPTH            MAX_OUTPOOL_BUFFERS
+#define WD_HELD_BUFFERS           (MAX_OUTPOOL_BUFFERS * (MAX_OUTPUTS * MAX_VPLANES + 1))
+#define SPLIT_RING_DEPTH          MAX_PIPELINE_BUFFERS
+#define SPLIT_WAIT_TIMEOUT_MS     5000
+#define SLICE_OVERLAP_ROWS        VSC_TAPS /* input rows the chroma taps reach past a band edge */
+#define SCL_CU_CLOCK_HZ           300000000ULL /* multiscaler kernel clock */
+#define SCL_CU_HEADROOM_PCT       90           /* share of cycles sessions may commit */
+#define SCL_CHANNEL_OVERHEAD_CYCLES 8192       /* descriptor fetch and coefficient load */
+#define THUMB_MAX_TILES           256  /* tiles per sprite sheet */
+#define THUMB_POOL_BUFFERS        MAX_PIPELINE_BUFFERS  /* a thumbnail holds buffers only while in flight */
+
 #define MULTISCALER_ALIGN(stride,MMWidthBytes)  ((((stride)+(MMWidthBytes)-1)/(MMWidthBytes))*(MMWidthBytes))
 #define ALIGN(width,align)                      (((width) + (align) - 1) & ~((align) - 1))
 
@@ -147,65 +197,235 @@ enum
   XMA_COEFF_LOAD_FROM_FILE,
 };
 
+/* Oversubscription handling at init ("admission" param) */
+enum
+{
+  XLNX_ADMISSION_OFF,
+  XLNX_ADMISSION_WARN,
+  XLNX_ADMISSION_REFUSE,
+};
+
+/* Sub-allocation of the per session device arena BO. The arena holds the
+ * coefficient tables, descriptors and slice scratch rows; frame buffers stay
+ * in xvbm pools, whose handles downstream consumers reference count and free
+ * on their own.
+ */
+typedef struct
+{
+  uint8_t  *data;
+  uint64_t paddr;
+  size_t   size;
+  size_t   offset;
+} XlnxDevRegion;
+
+typedef struct
+{
+  uint32_t x;
+  uint32_t y;
+  uint32_t width;
+  uint32_t height;
+} XlnxCropRect;
+
+/* Host sprite sheets of a thumbnail output, one filled while the other waits */
+typedef struct
+{
+  uint32_t  cols;
+  uint32_t  rows;
+  size_t    size;
+  uint8_t  *sheet[2];
+  uint64_t *pts[2];
+  int       fill;  /* sheet tiles are written to */
+  uint32_t  fill_tiles;
+  bool      done;  /* the other sheet is complete and not taken */
+  uint64_t  dropped;
+} ThumbSprite;
+
+struct SharedCuBatch;
+
+/* Set up at init or by control calls, allocated apart from the context */
+typedef struct
+{
+  uint32_t            pixel_rate[MAX_OUTPUTS];
+  uint32_t            line_rate[MAX_OUTPUTS];
+  XlnxCropRect        session_crop;
+  XlnxCropRect        crop[MAX_OUTPUTS];
+  uint8_t             filter_kernel[MAX_OUTPUTS];
+  float               filter_B[MAX_OUTPUTS];
+  float               filter_C[MAX_OUTPUTS];
+  char                coeff_set[MAX_OUTPUTS][XLNX_COEFF_SET_NAME_LEN];
+  ScalerFilterCoeffs  *FilterCoeffs;  /* host staging, only held from prepare to upload */
+  XlnxDevRegion       HfltCoeff_Buffer[MAX_OUTPUTS];
+  XlnxDevRegion       VfltCoeff_Buffer[MAX_OUTPUTS];
+  XlnxDevRegion       VfltField_Buffer[MAX_OUTPUTS];  /* bottom field vertical taps */
+  uint32_t            shared_pools;
+  uint32_t            warm_pool;
+  uint32_t            admission;
+  int32_t             cu_load_slot;
+  XlnxScalerCuLoad    cu_load_cost;  /* this session's share of the CU */
+  uint32_t            alias_outputs;
+  int32_t             num_suspended;
+  uint32_t            ddr_banks;  /* banks output pools may be spread over */
+  int32_t             bank_hint[MAX_OUTPUTS];
+  int32_t             out_bank[MAX_OUTPUTS];
+  int32_t             arena_bank;
+  int32_t             bank_load_slot;
+  uint64_t            bank_cost[DDR_MAX_BANKS];  /* this session's bytes per second */
+  ThumbSprite         thumb_sprite[MAX_OUTPUTS];
+} MultiScalerConfig;
+
 typedef struct MultiScalerContext
 {
-  uint32_t            enable_pipeline;
+  /* per frame state, kept together at the front */
+  int                 s_idx;
+  int                 r_idx;
+  int8_t              current_pipe;
+  int8_t              pipe_idx;
+  int8_t              first_frame;
+  int8_t              first_out;  /* first output in the descriptor chain */
   uint8_t             num_outs;
+  uint32_t            enable_pipeline;
+  std::atomic<uint64_t> recv_frame_cnt;  /* counted in send, read by recv with split_threads */
+  std::atomic<uint64_t> sent_frame_cnt;  /* counted in recv */
+  uint64_t            pts[MAX_OUTPOOL_BUFFERS];
+  int32_t             is_idr[MAX_OUTPOOL_BUFFERS];
+  XmaFraction         time_base[MAX_OUTPOOL_BUFFERS];
+  XmaFraction         frame_rate[MAX_OUTPOOL_BUFFERS];
+  XvbmBufferHandle    in_bhandle[MAX_OUTPOOL_BUFFERS];
+#ifdef HDR_DATA_SUPPORT
+  XmaSideDataHandle   hdr_handle[MAX_OUTPOOL_BUFFERS];
+#endif
+  uint8_t             hw_reg[MAX_PIPELINE_BUFFERS][XV_MULTI_SCALER_CTRL_REGMAP_SIZE];
+  XV_MULTISCALER_DESCRIPTOR *desc[MAX_PIPELINE_BUFFERS];
+  XlnxDevRegion       desc_buffer[MAX_PIPELINE_BUFFERS][MAX_OUTPUTS];
+  XvbmBufferHandle    out_bhandle[MAX_OUTPUTS][MAX_OUTPOOL_BUFFERS][MAX_VPLANES];
+
+  /* configuration read per frame */
   uint16_t            in_height[MAX_OUTPUTS];
   uint16_t            in_width[MAX_OUTPUTS];
   uint16_t            out_height[MAX_OUTPUTS];
   uint16_t            out_width[MAX_OUTPUTS];
-  XV_MULTISCALER_MEMORY_FORMATS in_format[MAX_OUTPUTS];
-  XV_MULTISCALER_MEMORY_FORMATS out_format[MAX_OUTPUTS];
-  uint32_t            pixel_rate[MAX_OUTPUTS];
-  uint32_t            line_rate[MAX_OUTPUTS];
+  XmaBufferObj        dev_arena;
+  XlnxDevRegion       slice_scratch[MAX_OUTPUTS];  /* band rows with their overlap, before the copy out */
+  XlnxDevRegion       slice_copy_coeff;  /* unity taps of the band copy */
+  int32_t             shared_cu_group;
   uint32_t            in_stride[MAX_OUTPUTS];
   uint32_t            in_hgt_align[MAX_OUTPUTS];
   uint32_t            out_stride[MAX_OUTPUTS];
   uint32_t            out_hgt_align[MAX_OUTPUTS];
-  ScalerFilterCoeffs  FilterCoeffs[MAX_OUTPUTS];
+  XV_MULTISCALER_MEMORY_FORMATS in_format[MAX_OUTPUTS];
+  XV_MULTISCALER_MEMORY_FORMATS out_format[MAX_OUTPUTS];
+  uint64_t            crop_offset[MAX_OUTPUTS][MAX_VPLANES];
+  int8_t              src_out[MAX_OUTPUTS];  /* output feeding this one, -1 for the session input */
+  bool                out_suspended[MAX_OUTPUTS];
+  bool                out_alias[MAX_OUTPUTS];
+  int8_t              alias_of[MAX_OUTPUTS];  /* output served from, -1 for the session input */
+  uint32_t            alias_stride[MAX_OUTPUTS];
+  uint32_t            alias_hgt_align[MAX_OUTPUTS];
+  int32_t             num_passthrough;
+  uint32_t            batch_frames;  /* frames per kernel start, 1 disables batching */
+  uint32_t            batch_fill;  /* frames queued in the batch being built */
+  uint32_t            batch_pending;  /* frames of the submitted batch not waited on */
+  uint32_t            batch_avail;  /* completed frames not yet returned */
+  bool                batch_primed;
+  uint32_t            shared_cu;  /* merge kernel starts with other sessions on the CU */
+  struct SharedCuBatch *shared_batch;
+  struct SharedCuBatch *shared_stale;  /* reported failed, not yet seen complete on the device */
+  uint32_t            low_latency;
+  uint32_t            split_threads;
+  uint32_t            dedup_frames;
+  uint32_t            dedup_sample_rows;  /* rows hashed per plane, 0 for all */
+  uint32_t            suspendable_outputs;
+  uint32_t            hang_watchdog;
+  uint32_t            slice_rows;  /* new input rows per band, 0 disables slicing */
+  uint32_t            field_mode;  /* frames hold two interlaced fields, scaled apart */
+  uint32_t            num_fields;  /* descriptors per output and frame */
+  bool                separate_fields[MAX_OUTPUTS];  /* fields stacked instead of woven */
+  int                 latency_logging;
+  uint32_t            host_p010;
+  uint32_t            host_unpack;
+  uint16_t            *unpack_row;  /* dither row, allocated on first use */
+  bool                tensor_out[MAX_OUTPUTS];  /* host readback as planar RGB */
+  XlnxTensorConv      tensor_conv[MAX_OUTPUTS];
+  bool                thumb_out[MAX_OUTPUTS];  /* scaled only on sampled frames */
+  uint32_t            thumb_interval[MAX_OUTPUTS];  /* input frames per sample, 0 for IDR only */
+  bool                thumb_idr[MAX_OUTPUTS];
+  uint32_t            num_thumbs;
+  uint32_t            luma_stats;
+  int32_t             stats_out;  /* output measured, -1 without luma_stats */
   XvbmPoolHandle      in_phandle;
   XvbmPoolHandle      out_phandle[MAX_OUTPUTS][MAX_VPLANES];
-  XvbmBufferHandle    out_bhandle[MAX_OUTPUTS][MAX_OUTPOOL_BUFFERS][MAX_VPLANES];
-  XvbmBufferHandle    in_bhandle[MAX_OUTPOOL_BUFFERS];
-  XmaBufferObj        HfltCoeff_Buffer[MAX_OUTPUTS];
-  XmaBufferObj        VfltCoeff_Buffer[MAX_OUTPUTS];
-  XmaFraction         time_base[MAX_OUTPOOL_BUFFERS];
-  XmaFraction         frame_rate[MAX_OUTPOOL_BUFFERS];
-  uint64_t            pts[MAX_OUTPOOL_BUFFERS];
-  int32_t             is_idr[MAX_OUTPOOL_BUFFERS];
-  int                 s_idx;
-  int                 r_idx;
-  uint64_t            recv_frame_cnt;
-  uint64_t            sent_frame_cnt;
   bool                pool_extended;
-  int8_t              current_pipe;
-  int8_t              first_frame;
-#ifdef HDR_DATA_SUPPORT
-  XmaSideDataHandle   hdr_handle[MAX_OUTPOOL_BUFFERS];
-#endif
-  XmaScalerSession    *session_mix_rate;
+  int32_t             max_try[MAX_OUTPUTS];
+  int32_t             num_buffers_extended[MAX_OUTPUTS];
+
+  /* per frame bookkeeping of optional modes */
+  uint32_t            ring_head;  /* frames published by send */
+  uint32_t            ring_tail;  /* frames returned by recv */
+  uint32_t            split_eos;
+  pthread_mutex_t     split_lock;  /* with split_cond, wakes the other thread on ring and eos changes */
+  pthread_cond_t      split_cond;
+  struct timespec     ll_send_ts[MAX_OUTPOOL_BUFFERS];
+  struct timespec     ll_submit_ts;
+  int64_t             ll_kernel_us;  /* smoothed submit to done time */
+  int64_t             ll_min_us;
+  int64_t             ll_max_us;
+  int64_t             ll_sum_us;
+  int32_t             ll_count;
+  struct timespec     wd_submit_ts[WD_QUEUE_DEPTH];
+  int8_t              wd_pipe[WD_QUEUE_DEPTH];
+  uint32_t            wd_head;  /* work items scheduled, atomic where recv reads it */
+  uint32_t            wd_tail;  /* work items seen done */
+  struct timespec     wd_last_done;
+  int64_t             wd_kernel_us;  /* smoothed time on the CU */
+  bool                wd_overdue;  /* oldest item reported past its expected time */
+  uint64_t            wd_stalls;
+  uint32_t            wd_stale;  /* items dropped by a reset, completions still to come */
+  int32_t             wd_num_held;
+  XvbmBufferHandle    wd_held[WD_HELD_BUFFERS];  /* buffers of dropped items, freed once they complete */
+  bool                slice_open;  /* a frame is being streamed */
+  int32_t             slice_first_rows;  /* rows ready when send_slice opens a frame, -1 from send_frame */
+  uint32_t            slice_in_rows;  /* input rows covered by started bands */
+  int8_t              slice_pipe;
+  uint16_t            slice_done[MAX_OUTPUTS];  /* output rows in started bands */
+  uint16_t            slice_complete[MAX_OUTPUTS];  /* output rows scaled */
+  uint16_t            slice_band_rows[WD_QUEUE_DEPTH][MAX_OUTPUTS];
+  uint8_t             slice_band_frame[WD_QUEUE_DEPTH];  /* s_idx of the frame a band belongs to */
+  uint8_t             slice_frame_idx;  /* s_idx of the frame slice_complete counts */
+  XV_MULTISCALER_DESCRIPTOR slice_frame[MAX_OUTPUTS];  /* whole frame descriptors of the open frame */
+  uint64_t            dedup_fp[MAX_OUTPOOL_BUFFERS];
+  bool                dedup_hit[MAX_OUTPOOL_BUFFERS];
+  uint64_t            dedup_tag;  /* producer tag for the next frame */
+  uint64_t            dedup_last_fp;
+  bool                dedup_have_last;
+  XvbmBufferHandle    dedup_last[MAX_OUTPUTS];
+  uint64_t            dedup_skipped;
+  uint32_t            thumb_since[MAX_OUTPUTS];  /* input frames since the last sample */
+  uint8_t             thumb_fire[MAX_OUTPOOL_BUFFERS];  /* thumbnail outputs sampled, by output bit */
+  XlnxLumaStats       stats;  /* of the last frame received */
+  bool                stats_valid;
+  uint8_t             *stats_prev;  /* luma of the previous frame, width x height */
+  long long int       frame_sent;
+  long long int       frame_recv;
+  struct timespec     latency;
+  long long int       time_taken;
 #ifdef MEASURE_TIME
-  int send_count;
-  int recv_count;
-  long long int send_func_time;
-  long long int recv_func_time;
-  long long int send_xrt_time;
-  long long int recv_xrt_time;
+  int                 send_count;
+  int                 recv_count;
+  long long int       send_func_time;
+  long long int       recv_func_time;
+  long long int       send_xrt_time;
+  long long int       recv_xrt_time;
 #endif
-  long long int     frame_sent;
-  long long int     frame_recv;
-  struct timespec   latency;
-  long long int     time_taken;
-  int               latency_logging;
-  uint8_t                   hw_reg[MAX_PIPELINE_BUFFERS][XV_MULTI_SCALER_CTRL_REGMAP_SIZE];
-  XV_MULTISCALER_DESCRIPTOR *desc[MAX_PIPELINE_BUFFERS];
-  XmaBufferObj              desc_buffer[MAX_PIPELINE_BUFFERS][MAX_OUTPUTS];
-  int8_t                    pipe_idx;
-  int32_t           max_try[MAX_OUTPUTS];
-  int32_t           num_buffers_extended[MAX_OUTPUTS];
+
+  MultiScalerConfig   *cfg;  /* allocated at init, freed at close */
 } MultiScalerContext;
 
+/* Whether the kernel produces this output, as opposed to a suspended or aliased one */
+static inline bool channel_scaled(MultiScalerContext *ctx, int output_id)
+{
+  return !ctx->out_suspended[output_id] && !ctx->out_alias[output_id];
+}
+
 static void scaler_clear_hdr_side_data(XmaFrame *frame)
 {
     /* Clear HDR side data */
@@ -226,6 +446,105 @@ static XmaParameter* get_parameter (XmaParameter *params, int num_params, const
   return NULL;
 }
 
+/* Crop rectangles are passed as "x,y,width,height" strings */
+static void get_crop_param(XmaParameter *param, XlnxCropRect *rect)
+{
+  memset(rect, 0, sizeof(*rect));
+  if (!param || !param->value)
+    return;
+  if (sscanf((const char *)param->value, "%u,%u,%u,%u",
+             &rect->x, &rect->y, &rect->width, &rect->height) != 4) {
+    ERROR_PRINT("Ignoring malformed crop '%s' for %s, expected x,y,width,height",
+                (const char *)param->value, param->name);
+    memset(rect, 0, sizeof(*rect));
+  }
+}
+
+/* Filter kernels are passed as "default", "bicubic[:B,C]", "lanczos2",
+ * "lanczos3", "bilinear" or "sharp" strings
+ */
+static void get_filter_param(XmaParameter *param, uint8_t *kernel, float *B, float *C)
+{
+  const char *name;
+
+  if (!param || !param->value)
+    return;
+  name = (const char *)param->value;
+  if (!strcmp(name, "default")) {
+    *kernel = XLNX_FILTER_KERNEL_DEFAULT;
+  } else if (!strncmp(name, "bicubic", 7)) {
+    *kernel = XLNX_FILTER_KERNEL_BICUBIC;
+    *B = FILTER_DEFAULT_B;
+    *C = FILTER_DEFAULT_C;
+    if ((name[7] == ':') && (sscanf(name + 8, "%f,%f", B, C) != 2)) {
+      ERROR_PRINT("Malformed B,C in %s='%s', using B=%.2f C=%.2f", param->name, name,
+                  FILTER_DEFAULT_B, FILTER_DEFAULT_C);
+      *B = FILTER_DEFAULT_B;
+      *C = FILTER_DEFAULT_C;
+    }
+  } else if (!strcmp(name, "lanczos2")) {
+    *kernel = XLNX_FILTER_KERNEL_LANCZOS2;
+  } else if (!strcmp(name, "lanczos3")) {
+    *kernel = XLNX_FILTER_KERNEL_LANCZOS3;
+  } else if (!strcmp(name, "bilinear")) {
+    *kernel = XLNX_FILTER_KERNEL_BILINEAR;
+  } else if (!strcmp(name, "sharp")) {
+    *kernel = XLNX_FILTER_KERNEL_SHARP;
+  } else {
+    ERROR_PRINT("Unknown filter kernel %s='%s', keeping previous selection", param->name, name);
+  }
+}
+
+/* Tensor readback is passed as "rgb|bgr[,bt601|bt709][,limited|full][,f32|u8|s8]",
+ * mean and scale as "c0,c1,c2" in plane order
+ */
+static bool get_tensor_param(XmaParameter *param, XmaParameter *mean_param,
+                             XmaParameter *scale_param, XlnxTensorConv *conv)
+{
+  char spec[64], *tok, *save = NULL;
+  int bt709 = 0, full_range = 0, bgr = 0, type = XLNX_TENSOR_F32;
+  float mean[3] = {0.0f, 0.0f, 0.0f};
+  float scale[3] = {1.0f, 1.0f, 1.0f};
+
+  if (!param || !param->value)
+    return false;
+  strncpy(spec, (const char *)param->value, sizeof(spec) - 1);
+  spec[sizeof(spec) - 1] = '\0';
+  for (tok = strtok_r(spec, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+    if (!strcmp(tok, "rgb") || !strcmp(tok, "bgr"))
+      bgr = (tok[0] == 'b');
+    else if (!strcmp(tok, "bt601") || !strcmp(tok, "bt709"))
+      bt709 = !strcmp(tok, "bt709");
+    else if (!strcmp(tok, "limited") || !strcmp(tok, "full"))
+      full_range = !strcmp(tok, "full");
+    else if (!strcmp(tok, "f32"))
+      type = XLNX_TENSOR_F32;
+    else if (!strcmp(tok, "u8"))
+      type = XLNX_TENSOR_U8;
+    else if (!strcmp(tok, "s8"))
+      type = XLNX_TENSOR_S8;
+    else {
+      ERROR_PRINT("Unknown '%s' in %s='%s', output stays NV12", tok, param->name,
+                  (const char *)param->value);
+      return false;
+    }
+  }
+  if (mean_param && mean_param->value &&
+      (sscanf((const char *)mean_param->value, "%f,%f,%f", &mean[0], &mean[1], &mean[2]) != 3)) {
+    ERROR_PRINT("Ignoring malformed %s='%s', expected c0,c1,c2", mean_param->name,
+                (const char *)mean_param->value);
+    mean[0] = mean[1] = mean[2] = 0.0f;
+  }
+  if (scale_param && scale_param->value &&
+      (sscanf((const char *)scale_param->value, "%f,%f,%f", &scale[0], &scale[1], &scale[2]) != 3)) {
+    ERROR_PRINT("Ignoring malformed %s='%s', expected c0,c1,c2", scale_param->name,
+                (const char *)scale_param->value);
+    scale[0] = scale[1] = scale[2] = 1.0f;
+  }
+  xlnx_tensor_conv_init(conv, bt709, full_range, bgr, type, mean, scale);
+  return true;
+}
+
 static void get_user_params(XmaScalerSession *session)
 {
    XmaParameter *param;
@@ -236,13 +555,277 @@ static void get_user_params(XmaScalerSession *session)
   else
       ctx->enable_pipeline = -1;
 
-  if ((param = get_parameter (session->props.params, session->props.param_cnt, "MixRate")))
-       ctx->session_mix_rate = (XmaScalerSession *)*(uint64_t *)param->value;
+  if ((param = get_parameter (session->props.params, session->props.param_cnt, "shared_pools")))
+       ctx->cfg->shared_pools = *(uint32_t*)param->value;
+  else
+      ctx->cfg->shared_pools = 0;
+
+  /* legacy opt-in, the session it names is no longer needed */
+  if ((param = get_parameter (session->props.params, session->props.param_cnt, "MixRate")) &&
+      *(uint64_t *)param->value)
+       ctx->cfg->shared_pools = 1;
 
   if ((param = get_parameter (session->props.params, session->props.param_cnt, "latency_logging")))
        ctx->latency_logging = (int)*(int *)param->value;
   else
       ctx->latency_logging = 0;
+
+  /* Host input frames are P010/P016 and need packing to 10LE32 on upload */
+  if ((param = get_parameter (session->props.params, session->props.param_cnt, "p010_input")))
+       ctx->host_p010 = *(uint32_t*)param->value;
+  else
+      ctx->host_p010 = 0;
+
+  /* 10-bit outputs read back to host are unpacked to P010 or dithered NV12,
+   * host frames are then allocated as described in xlnx_multi_scaler_host_out.h */
+  if ((param = get_parameter (session->props.params, session->props.param_cnt, "unpack_10bit_output")))
+       ctx->host_unpack = *(uint32_t*)param->value;
+  else
+      ctx->host_unpack = XLNX_HOST_OUT_10LE32;
+
+  /* Keep device allocations in a process wide cache across close/init */
+  if ((param = get_parameter (session->props.params, session->props.param_cnt, "warm_pool")))
+       ctx->cfg->warm_pool = *(uint32_t*)param->value;
+  else
+      ctx->cfg->warm_pool = 0;
+
+  /* send and recv may run on separate threads */
+  if ((param = get_parameter (session->props.params, session->props.param_cnt, "split_threads")))
+       ctx->split_threads = *(uint32_t*)param->value;
+  else
+      ctx->split_threads = 0;
+
+  /* Reuse the previous outputs for repeated input frames */
+  if ((param = get_parameter (session->props.params, session->props.param_cnt, "dedup_frames")))
+       ctx->dedup_frames = *(uint32_t*)param->value;
+  else
+      ctx->dedup_frames = 0;
+
+  /* Hash only this many evenly spaced rows per plane; faster, but changes
+   * outside those rows are missed and the frame is treated as a repeat */
+  if ((param = get_parameter (session->props.params, session->props.param_cnt, "dedup_sample_rows")))
+       ctx->dedup_sample_rows = *(uint32_t*)param->value;
+  else
+      ctx->dedup_sample_rows = 0;
+
+  /* Outputs may be suspended and resumed while the session runs */
+  if ((param = get_parameter (session->props.params, session->props.param_cnt, "suspendable_outputs")))
+       ctx->suspendable_outputs = *(uint32_t*)param->value;
+  else
+      ctx->suspendable_outputs = 0;
+
+  /* Serve passthrough and repeated outputs without scaling them. Off by
+   * default: passthrough device outputs then hand on the input buffer */
+  if ((param = get_parameter (session->props.params, session->props.param_cnt, "alias_outputs")))
+       ctx->cfg->alias_outputs = *(uint32_t*)param->value;
+  else
+      ctx->cfg->alias_outputs = 0;
+
+  /* Report stalled work items early and reset the session after a hang */
+  if ((param = get_parameter (session->props.params, session->props.param_cnt, "hang_watchdog")))
+       ctx->hang_watchdog = *(uint32_t*)param->value;
+  else
+      ctx->hang_watchdog = 0;
+
+  /* Scale frames in bands of at least this many input rows as they arrive */
+  if ((param = get_parameter (session->props.params, session->props.param_cnt, "slice_rows")))
+       ctx->slice_rows = *(uint32_t*)param->value;
+  else
+      ctx->slice_rows = 0;
+
+  /* Scale the two fields of interlaced frames separately */
+  if ((param = get_parameter (session->props.params, session->props.param_cnt, "field_mode")))
+       ctx->field_mode = *(uint32_t*)param->value;
+  else
+      ctx->field_mode = 0;
+
+  /* separate_fields_<n> stacks the top field above the bottom one in output n */
+  for (int output_id = 0; output_id < MAX_OUTPUTS; output_id++) {
+    char name[32];
+    sprintf(name, "separate_fields_%d", output_id);
+    if ((param = get_parameter (session->props.params, session->props.param_cnt, name)))
+      ctx->separate_fields[output_id] = *(uint32_t*)param->value != 0;
+    else
+      ctx->separate_fields[output_id] = false;
+  }
+
+  /* Luma statistics of one output per frame, the smallest unless luma_stats_output is given */
+  if ((param = get_parameter (session->props.params, session->props.param_cnt, "luma_stats")))
+       ctx->luma_stats = *(uint32_t*)param->value;
+  else
+      ctx->luma_stats = 0;
+  if ((param = get_parameter (session->props.params, session->props.param_cnt, "luma_stats_output")))
+       ctx->stats_out = *(uint32_t*)param->value;
+  else
+      ctx->stats_out = -1;
+
+  /* Submit every frame at once and poll for its completion */
+  if ((param = get_parameter (session->props.params, session->props.param_cnt, "low_latency")))
+       ctx->low_latency = *(uint32_t*)param->value;
+  else
+      ctx->low_latency = 0;
+
+  /* Warn (1) or refuse (2) sessions that would oversubscribe the CU */
+  if ((param = get_parameter (session->props.params, session->props.param_cnt, "admission")))
+       ctx->cfg->admission = *(uint32_t*)param->value;
+  else
+      ctx->cfg->admission = XLNX_ADMISSION_WARN;
+
+  /* Share kernel starts with other opted in sessions on the same CU */
+  if ((param = get_parameter (session->props.params, session->props.param_cnt, "shared_cu")))
+       ctx->shared_cu = *(uint32_t*)param->value;
+  else
+      ctx->shared_cu = 0;
+
+  /* Chain this many frames' descriptors into one kernel start */
+  if ((param = get_parameter (session->props.params, session->props.param_cnt, "batch_frames")))
+       ctx->batch_frames = *(uint32_t*)param->value;
+  else
+      ctx->batch_frames = 1;
+
+  /* Spread output pools over these banks (bit mask), ddr_bank_<n> pins output n */
+  if ((param = get_parameter (session->props.params, session->props.param_cnt, "ddr_banks")))
+       ctx->cfg->ddr_banks = *(uint32_t*)param->value;
+  else
+      ctx->cfg->ddr_banks = 0;
+
+  for (int output_id = 0; output_id < MAX_OUTPUTS; output_id++) {
+    char name[16];
+    sprintf(name, "ddr_bank_%d", output_id);
+    if ((param = get_parameter (session->props.params, session->props.param_cnt, name)))
+      ctx->cfg->bank_hint[output_id] = *(int32_t*)param->value;
+    else
+      ctx->cfg->bank_hint[output_id] = -1;
+  }
+
+  /* "filter" selects the kernel for all outputs, filter_<n> overrides output n */
+  for (int output_id = 0; output_id < MAX_OUTPUTS; output_id++) {
+    char name[16];
+    ctx->cfg->filter_kernel[output_id] = XLNX_FILTER_KERNEL_DEFAULT;
+    ctx->cfg->filter_B[output_id]      = FILTER_DEFAULT_B;
+    ctx->cfg->filter_C[output_id]      = FILTER_DEFAULT_C;
+    get_filter_param(get_parameter (session->props.params, session->props.param_cnt, "filter"),
+                     &ctx->cfg->filter_kernel[output_id], &ctx->cfg->filter_B[output_id], &ctx->cfg->filter_C[output_id]);
+    sprintf(name, "filter_%d", output_id);
+    get_filter_param(get_parameter (session->props.params, session->props.param_cnt, name),
+                     &ctx->cfg->filter_kernel[output_id], &ctx->cfg->filter_B[output_id], &ctx->cfg->filter_C[output_id]);
+  }
+
+  /* tensor_<n> converts host readback of output n to planar RGB,
+   * tensor_mean_<n> and tensor_scale_<n> normalize it. The host frame
+   * layout is described in xlnx_multi_scaler_host_out.h */
+  for (int output_id = 0; output_id < MAX_OUTPUTS; output_id++) {
+    char name[3][24];
+    sprintf(name[0], "tensor_%d", output_id);
+    sprintf(name[1], "tensor_mean_%d", output_id);
+    sprintf(name[2], "tensor_scale_%d", output_id);
+    ctx->tensor_out[output_id] =
+      get_tensor_param(get_parameter (session->props.params, session->props.param_cnt, name[0]),
+                       get_parameter (session->props.params, session->props.param_cnt, name[1]),
+                       get_parameter (session->props.params, session->props.param_cnt, name[2]),
+                       &ctx->tensor_conv[output_id]);
+  }
+
+  /* thumb_interval_<n> and thumb_idr_<n> make output n a thumbnail output,
+   * sampled into a sprite sheet of thumb_tiles_<n> ("CxR") tiles */
+  for (int output_id = 0; output_id < MAX_OUTPUTS; output_id++) {
+    ThumbSprite *sprite = &ctx->cfg->thumb_sprite[output_id];
+    char name[32];
+    sprintf(name, "thumb_interval_%d", output_id);
+    if ((param = get_parameter (session->props.params, session->props.param_cnt, name)))
+      ctx->thumb_interval[output_id] = *(uint32_t*)param->value;
+    else
+      ctx->thumb_interval[output_id] = 0;
+    sprintf(name, "thumb_idr_%d", output_id);
+    if ((param = get_parameter (session->props.params, session->props.param_cnt, name)))
+      ctx->thumb_idr[output_id] = *(uint32_t*)param->value != 0;
+    else
+      ctx->thumb_idr[output_id] = false;
+    ctx->thumb_out[output_id] = ctx->thumb_interval[output_id] || ctx->thumb_idr[output_id];
+    sprite->cols = 1;
+    sprite->rows = 1;
+    sprintf(name, "thumb_tiles_%d", output_id);
+    if ((param = get_parameter (session->props.params, session->props.param_cnt, name)) && param->value &&
+        ((sscanf((const char *)param->value, "%ux%u", &sprite->cols, &sprite->rows) != 2) ||
+         !sprite->cols || !sprite->rows || (sprite->cols * sprite->rows > THUMB_MAX_TILES))) {
+      ERROR_PRINT("Ignoring malformed %s='%s', expected CxR with up to %d tiles", name,
+                  (const char *)param->value, THUMB_MAX_TILES);
+      sprite->cols = 1;
+      sprite->rows = 1;
+    }
+  }
+
+  /* coeff_set_<n> names the table pair used from a binary coefficient file */
+  for (int output_id = 0; output_id < MAX_OUTPUTS; output_id++) {
+    char name[16];
+    sprintf(name, "coeff_set_%d", output_id);
+    memset(ctx->cfg->coeff_set[output_id], 0, sizeof(ctx->cfg->coeff_set[output_id]));
+    if ((param = get_parameter (session->props.params, session->props.param_cnt, name)) && param->value)
+      strncpy(ctx->cfg->coeff_set[output_id], (const char *)param->value, XLNX_COEFF_SET_NAME_LEN - 1);
+  }
+
+  /* Session crop applies to the input, crop_<n> to the input of channel n */
+  get_crop_param(get_parameter (session->props.params, session->props.param_cnt, "crop"), &ctx->cfg->session_crop);
+  for (int output_id = 0; output_id < MAX_OUTPUTS; output_id++) {
+    char name[16];
+    sprintf(name, "crop_%d", output_id);
+    get_crop_param(get_parameter (session->props.params, session->props.param_cnt, name), &ctx->cfg->crop[output_id]);
+  }
+}
+
+/* Narrows channel input to its crop rectangle and records the address offsets
+ * applied to srcImgBuf. Stride and plane elevation stay those of the full frame.
+ */
+static int32_t apply_channel_crop(MultiScalerContext *ctx, int output_id, const XlnxCropRect *rect)
+{
+  uint32_t x_bytes;
+
+  if (!rect->width && !rect->height)
+    return XMA_SUCCESS;
+
+  if (!rect->width || !rect->height ||
+      ((rect->x + rect->width) > ctx->in_width[output_id]) ||
+      ((rect->y + rect->height) > ctx->in_height[output_id])) {
+    ERROR_PRINT("Channel %d crop %ux%u at (%u,%u) is outside its %dx%d input",
+                output_id, rect->width, rect->height, rect->x, rect->y,
+                ctx->in_width[output_id], ctx->in_height[output_id]);
+    return XMA_ERROR;
+  }
+
+  if ((rect->width % MULTISCALER_PPC) || (rect->height % MULTISCALER_PPC) || (rect->y % 2)) {
+    ERROR_PRINT("Channel %d crop %ux%u at (%u,%u): size must be a multiple of %d and y even",
+                output_id, rect->width, rect->height, rect->x, rect->y, MULTISCALER_PPC);
+    return XMA_ERROR;
+  }
+  if (ctx->field_mode && ((rect->y % 4) || (rect->height % 4))) {
+    /* both fields must start on a chroma line of their own and be as tall */
+    ERROR_PRINT("Channel %d crop y=%u and height=%u must be multiples of 4 in field mode",
+                output_id, rect->y, rect->height);
+    return XMA_ERROR;
+  }
+
+  if (ctx->in_format[output_id] == XV_MULTI_SCALER_Y_UV10_420) {
+    /* three samples per 32-bit word */
+    x_bytes = (rect->x / 3) * 4;
+  } else {
+    x_bytes = rect->x;
+  }
+  if ((x_bytes % SCL_CROP_ADDR_ALIGN) ||
+      ((ctx->in_format[output_id] == XV_MULTI_SCALER_Y_UV10_420) && (rect->x % 3))) {
+    ERROR_PRINT("Channel %d crop x=%u does not start on a %d byte boundary",
+                output_id, rect->x, SCL_CROP_ADDR_ALIGN);
+    return XMA_ERROR;
+  }
+
+  ctx->crop_offset[output_id][0] = (uint64_t)rect->y * ctx->in_stride[output_id] + x_bytes;
+  ctx->crop_offset[output_id][1] = (uint64_t)(rect->y / 2) * ctx->in_stride[output_id] + x_bytes;
+  ctx->in_width[output_id]  = rect->width;
+  ctx->in_height[output_id] = rect->height;
+
+  xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "Channel %d crop %ux%u at (%u,%u), offsets = %lu, %lu",
+             output_id, rect->width, rect->height, rect->x, rect->y,
+             ctx->crop_offset[output_id][0], ctx->crop_offset[output_id][1]);
+  return XMA_SUCCESS;
 }
 
 
@@ -283,6 +866,137 @@ get_num_video_planes (XmaFormatType format)
   }
 }
 
+/* Takes channel input from output src_id, or the session input when negative */
+static void set_channel_input(XmaScalerSession *session, int output_id, int src_id)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+
+  if (src_id < 0) {
+    ctx->in_height[output_id] = session->props.input.height;
+    ctx->in_width[output_id]  = session->props.input.width;
+    ctx->in_format[output_id] = get_multiscaler_ip_format(session->props.input.format);
+
+    if (ctx->in_format[output_id] == XV_MULTI_SCALER_Y_UV10_420)
+    {
+       ctx->in_stride[output_id] = MULTISCALER_ALIGN(((session->props.input.width + 2) / 3) * 4, SCL_IN_WIDTH_ALIGN);
+    }
+    else
+    {
+       ctx->in_stride[output_id] = MULTISCALER_ALIGN(session->props.input.width, SCL_IN_WIDTH_ALIGN);
+    }
+    ctx->in_hgt_align[output_id] = MULTISCALER_ALIGN(ctx->in_height[output_id], SCL_IN_HEIGHT_ALIGN);
+  } else {
+    /* assign input parameters with source channel output paramters */
+    ctx->in_height[output_id] = session->props.output[src_id].height;
+    ctx->in_width[output_id]  = session->props.output[src_id].width;
+    ctx->in_format[output_id] = get_multiscaler_ip_format(session->props.output[src_id].format);
+    if (ctx->in_format[output_id] == XV_MULTI_SCALER_Y_UV10_420)
+    {
+       ctx->in_stride[output_id] = MULTISCALER_ALIGN(((session->props.output[src_id].width + 2) / 3) * 4, SCL_OUT_WIDTH_ALIGN);
+    }
+    else
+    {
+      ctx->in_stride[output_id] = MULTISCALER_ALIGN(session->props.output[src_id].width, SCL_OUT_WIDTH_ALIGN);
+    }
+    ctx->in_hgt_align[output_id] = ctx->out_hgt_align[src_id];
+  }
+  memset(ctx->crop_offset[output_id], 0, sizeof(ctx->crop_offset[output_id]));
+}
+
+static void set_channel_rates(MultiScalerContext *ctx, int output_id)
+{
+  ctx->cfg->pixel_rate[output_id] = (uint32_t)((float)((ctx->in_width[output_id]*
+      STEP_PRECISION)+(ctx->out_width[output_id]/2))/(float)ctx->out_width[output_id]);
+  ctx->cfg->line_rate[output_id] = (uint32_t)((float)((ctx->in_height[output_id]*
+      STEP_PRECISION)+(ctx->out_height[output_id]/2))/(float)ctx->out_height[output_id]);
+}
+
+/* True when output_id or any output it is scaled from, down to the session
+ * input, has a crop. src_out must be set for output_id and its sources.
+ */
+static bool crop_in_chain(MultiScalerContext *ctx, int output_id)
+{
+  int id;
+
+  for (id = output_id; id >= 0; id = ctx->src_out[id]) {
+    if (ctx->cfg->crop[id].width || ctx->cfg->crop[id].height)
+      return true;
+  }
+  return ctx->cfg->session_crop.width || ctx->cfg->session_crop.height;
+}
+
+/* Serves output_id from the session input when it matches it, or from an
+ * earlier scaled output with the same geometry, format and filter setup.
+ * Outputs with a crop anywhere along their source chain always go through
+ * the kernel, and are never used as an alias source either.
+ */
+static void find_output_alias(XmaScalerSession *session, int output_id)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  XmaScalerInOutProperties *out = &session->props.output[output_id];
+  int src_id;
+
+  if (crop_in_chain(ctx, output_id))
+    return;
+
+  if ((out->width == session->props.input.width) && (out->height == session->props.input.height) &&
+      (out->format == session->props.input.format)) {
+    ctx->out_alias[output_id]       = true;
+    ctx->alias_of[output_id]        = -1;
+    ctx->alias_stride[output_id]    = ctx->in_stride[0];
+    ctx->alias_hgt_align[output_id] = ctx->in_hgt_align[0];
+    return;
+  }
+
+  for (src_id = 0; src_id < output_id; src_id++) {
+    XmaScalerInOutProperties *src = &session->props.output[src_id];
+
+    if (ctx->out_alias[src_id] || crop_in_chain(ctx, src_id))
+      continue;
+    if ((src->width != out->width) || (src->height != out->height) || (src->format != out->format) ||
+        (src->coeffLoad != out->coeffLoad) ||
+        (ctx->cfg->filter_kernel[src_id] != ctx->cfg->filter_kernel[output_id]) ||
+        (ctx->cfg->filter_B[src_id] != ctx->cfg->filter_B[output_id]) ||
+        (ctx->cfg->filter_C[src_id] != ctx->cfg->filter_C[output_id]) ||
+        strncmp(ctx->cfg->coeff_set[src_id], ctx->cfg->coeff_set[output_id], XLNX_COEFF_SET_NAME_LEN))
+      continue;
+    ctx->out_alias[output_id]       = true;
+    ctx->alias_of[output_id]        = src_id;
+    ctx->alias_stride[output_id]    = ctx->out_stride[src_id];
+    ctx->alias_hgt_align[output_id] = ctx->out_hgt_align[src_id];
+    return;
+  }
+}
+
+static void resolve_output_aliases(XmaScalerSession *session)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  int max_outputs = MIN(ctx->num_outs, MAX_OUTPUTS);
+  int output_id, num_scaled = 0;
+
+  for (output_id = 0; output_id < max_outputs; output_id++)
+    num_scaled += !ctx->out_alias[output_id];
+  /* keep the kernel busy with at least one output, an identity scale of the input */
+  if (!num_scaled)
+    ctx->out_alias[0] = false;
+
+  ctx->num_passthrough = 0;
+  ctx->first_out = -1;
+  for (output_id = 0; output_id < max_outputs; output_id++) {
+    if (!ctx->out_alias[output_id]) {
+      /* thumbnails are linked after the regular outputs */
+      if ((ctx->first_out < 0) && !ctx->thumb_out[output_id])
+        ctx->first_out = output_id;
+      continue;
+    }
+    if (ctx->alias_of[output_id] < 0)
+      ctx->num_passthrough++;
+    xma_logmsg(XMA_INFO_LOG, XMA_MULTISCALER, "Output %d is served from %s%d without scaling", output_id,
+               ctx->alias_of[output_id] < 0 ? "the input" : "output ",
+               ctx->alias_of[output_id] < 0 ? 0 : ctx->alias_of[output_id]);
+  }
+}
+
 static int32_t
 get_plane_size (int32_t stride, int32_t height, XmaFormatType format, int32_t plane_id, int hgt_align)
 {
@@ -317,6 +1031,222 @@ get_plane_size (int32_t stride, int32_t height, XmaFormatType format, int32_t pl
   }
 }
 
+typedef int16_t FilterTable[HSC_PHASES][HSC_TAPS];
+
+typedef struct
+{
+  bool        valid;
+  double      B;
+  double      C;
+  FilterTable *tables;
+} FilterBankUserSlot;
+
+/* Process wide filter bank, shared by all sessions */
+static FilterTable        *filter_bank;
+static pthread_once_t     filter_bank_once = PTHREAD_ONCE_INIT;
+static FilterBankUserSlot filter_bank_user[FILTER_BANK_USER_SLOTS];
+static pthread_mutex_t    filter_bank_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static double filter_bank_ratio(int idx)
+{
+  return 1.0 + (double)idx / FILTER_BANK_RATIO_STEPS;
+}
+
+static void filter_bank_generate(FilterTable *tables, int kernel, double B, double C)
+{
+  int r;
+  for (r = 0; r < FILTER_BANK_NUM_RATIOS; r++)
+    Generate_kernel_filter(kernel, B, C, filter_bank_ratio(r), tables[r]);
+}
+
+static void filter_bank_init(void)
+{
+  int kernel;
+  FilterTable *bank = (FilterTable *)malloc((XLNX_FILTER_KERNEL_NUM - 1) *
+                                            FILTER_BANK_NUM_RATIOS * sizeof(FilterTable));
+  if (!bank)
+    return;
+  for (kernel = XLNX_FILTER_KERNEL_BICUBIC; kernel < XLNX_FILTER_KERNEL_NUM; kernel++) {
+    filter_bank_generate(bank + (kernel - 1) * FILTER_BANK_NUM_RATIOS, kernel,
+                         FILTER_DEFAULT_B, FILTER_DEFAULT_C);
+  }
+  filter_bank = bank;
+}
+
+/* Bicubic tables for non default B/C are generated once per pair on first use */
+static FilterTable *filter_bank_user_tables(double B, double C)
+{
+  FilterTable *tables = NULL;
+  int i;
+
+  pthread_mutex_lock(&filter_bank_lock);
+  for (i = 0; i < FILTER_BANK_USER_SLOTS; i++) {
+    if (filter_bank_user[i].valid && (filter_bank_user[i].B == B) && (filter_bank_user[i].C == C)) {
+      tables = filter_bank_user[i].tables;
+      break;
+    }
+    if (!filter_bank_user[i].valid) {
+      tables = (FilterTable *)malloc(FILTER_BANK_NUM_RATIOS * sizeof(FilterTable));
+      if (tables) {
+        filter_bank_generate(tables, XLNX_FILTER_KERNEL_BICUBIC, B, C);
+        filter_bank_user[i].B      = B;
+        filter_bank_user[i].C      = C;
+        filter_bank_user[i].tables = tables;
+        filter_bank_user[i].valid  = true;
+      }
+      break;
+    }
+  }
+  pthread_mutex_unlock(&filter_bank_lock);
+  return tables;
+}
+
+/* Returns the bank table closest to the scale ratio src/dst */
+static FilterTable *filter_bank_lookup(int kernel, float B, float C, int src, int dst)
+{
+  FilterTable *tables;
+  double ratio = (double)src / (double)dst;
+  int idx = 0;
+
+  if (ratio > 1.0)
+    idx = MIN((int)((ratio - 1.0) * FILTER_BANK_RATIO_STEPS + 0.5), FILTER_BANK_NUM_RATIOS - 1);
+
+  if ((kernel == XLNX_FILTER_KERNEL_BICUBIC) &&
+      ((B != (float)FILTER_DEFAULT_B) || (C != (float)FILTER_DEFAULT_C))) {
+    tables = filter_bank_user_tables(B, C);
+  } else {
+    pthread_once(&filter_bank_once, filter_bank_init);
+    tables = filter_bank ? filter_bank + (kernel - 1) * FILTER_BANK_NUM_RATIOS : NULL;
+  }
+  return tables ? &tables[idx] : NULL;
+}
+
+/* Mapped binary coefficient files, shared by all sessions of the process and
+ * reused while the file on disk is unchanged. Sessions only hold a reference
+ * while copying their tables out.
+ */
+typedef struct
+{
+  char      path[256];
+  dev_t     dev;
+  ino_t     ino;
+  time_t    mtime;
+  size_t    size;
+  uint8_t   *base;
+  int       refcnt;
+} CoeffFileMap;
+
+static CoeffFileMap    coeff_file_cache[COEFF_FILE_CACHE_SIZE];
+static pthread_mutex_t coeff_file_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Returns the mapped binary file, or NULL with *is_text set when the file
+ * does not carry the binary magic and should go through the text loader.
+ */
+static CoeffFileMap *coeff_file_acquire(const char *path, int *is_text)
+{
+  CoeffFileMap *map = NULL, *slot = NULL;
+  char magic[sizeof(((XlnxCoeffFileHeader *)0)->magic)];
+  const char *reason;
+  struct stat st;
+  uint8_t *base;
+  int fd, i;
+
+  *is_text = 0;
+  fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    ERROR_PRINT ("failed to open file %s for reading. reason : %s [%d]", path, strerror(errno), errno);
+    return NULL;
+  }
+  if (fstat(fd, &st) ||
+      (pread(fd, magic, sizeof(magic), 0) != (ssize_t)sizeof(magic)) ||
+      memcmp(magic, XLNX_COEFF_FILE_MAGIC, sizeof(magic))) {
+    close(fd);
+    *is_text = 1;
+    return NULL;
+  }
+
+  pthread_mutex_lock(&coeff_file_lock);
+  for (i = 0; i < COEFF_FILE_CACHE_SIZE; i++) {
+    CoeffFileMap *e = &coeff_file_cache[i];
+    if (e->base && (e->dev == st.st_dev) && (e->ino == st.st_ino) &&
+        (e->mtime == st.st_mtime) && (e->size == (size_t)st.st_size)) {
+      e->refcnt++;
+      pthread_mutex_unlock(&coeff_file_lock);
+      close(fd);
+      return e;
+    }
+    if (!slot && !e->refcnt)
+      slot = e;
+  }
+  if (!slot) {
+    ERROR_PRINT ("All %d coefficient file mappings are in use", COEFF_FILE_CACHE_SIZE);
+    goto out;
+  }
+
+  base = (uint8_t *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (base == MAP_FAILED) {
+    ERROR_PRINT ("failed to map %s. reason : %s [%d]", path, strerror(errno), errno);
+    goto out;
+  }
+  if ((reason = xlnx_coeff_file_validate(base, st.st_size))) {
+    ERROR_PRINT ("Coefficient file %s rejected: %s", path, reason);
+    munmap(base, st.st_size);
+    goto out;
+  }
+
+  if (slot->base)
+    munmap(slot->base, slot->size);
+  strncpy(slot->path, path, sizeof(slot->path) - 1);
+  slot->path[sizeof(slot->path) - 1] = '\0';
+  slot->dev    = st.st_dev;
+  slot->ino    = st.st_ino;
+  slot->mtime  = st.st_mtime;
+  slot->size   = st.st_size;
+  slot->base   = base;
+  slot->refcnt = 1;
+  map = slot;
+  DEBUG_PRINT ("Mapped coefficient file %s, %u sets", path,
+               ((XlnxCoeffFileHeader *)base)->num_sets);
+out:
+  pthread_mutex_unlock(&coeff_file_lock);
+  close(fd);
+  return map;
+}
+
+static void coeff_file_release(CoeffFileMap *map)
+{
+  pthread_mutex_lock(&coeff_file_lock);
+  map->refcnt--;
+  pthread_mutex_unlock(&coeff_file_lock);
+}
+
+static int32_t load_binary_coeff_file(XmaScalerSession *session, CoeffFileMap *map)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  int max_outputs = MIN(ctx->num_outs, MAX_OUTPUTS);
+  const XlnxCoeffTable *htbl, *vtbl;
+  int output_id;
+
+  for (output_id = 0; output_id < max_outputs; output_id++) {
+    if (session->props.output[output_id].coeffLoad != XMA_COEFF_LOAD_FROM_FILE)
+      continue;
+    htbl = xlnx_coeff_file_find(map->base, ctx->cfg->coeff_set[output_id], output_id,
+                                XLNX_COEFF_DIR_HORIZONTAL,
+                                ctx->in_width[output_id], ctx->out_width[output_id]);
+    vtbl = xlnx_coeff_file_find(map->base, ctx->cfg->coeff_set[output_id], output_id,
+                                XLNX_COEFF_DIR_VERTICAL,
+                                ctx->in_height[output_id], ctx->out_height[output_id]);
+    if (!htbl || !vtbl) {
+      ERROR_PRINT ("Coefficient file %s has no %s set for output %d '%s'", map->path,
+                   !htbl ? "horizontal" : "vertical", output_id, ctx->cfg->coeff_set[output_id]);
+      return XMA_ERROR;
+    }
+    memcpy(ctx->cfg->FilterCoeffs[output_id].HfltCoeff, *htbl, sizeof(ctx->cfg->FilterCoeffs[output_id].HfltCoeff));
+    memcpy(ctx->cfg->FilterCoeffs[output_id].VfltCoeff, *vtbl, sizeof(ctx->cfg->FilterCoeffs[output_id].VfltCoeff));
+  }
+  return XMA_SUCCESS;
+}
+
 static int32_t
 xlnx_multi_scaler_prepare_filter_tables (XmaScalerSession *session)
 {
@@ -334,8 +1264,17 @@ xlnx_multi_scaler_prepare_filter_tables (XmaScalerSession *session)
   int temp = 0, r=1, d, i, j;
   FILE *fp_coeff = NULL;
 
-  for (output_id = 0; output_id < max_outputs; output_id++) {
-    /* store width scaling ratio  */
+  /* host copy of the tables lives only until upload_filter_coeffs() */
+  if (!ctx->cfg->FilterCoeffs) {
+    ctx->cfg->FilterCoeffs = (ScalerFilterCoeffs *)calloc(MAX_OUTPUTS, sizeof(*ctx->cfg->FilterCoeffs));
+    if (!ctx->cfg->FilterCoeffs) {
+      ERROR_PRINT ("Filter coefficient host memory allocation failed");
+      return XMA_ERROR;
+    }
+  }
+
+  for (output_id = 0; output_id < max_outputs; output_id++) {
+    /* store width scaling ratio  */
     if (ctx->in_width[output_id] >= ctx->out_width[output_id]) {
       scale_ratio[0][output_id] = ((float)ctx->in_width[output_id]/(float)ctx->out_width[output_id]); //downscale
     } else {
@@ -373,6 +1312,31 @@ xlnx_multi_scaler_prepare_filter_tables (XmaScalerSession *session)
           scale_ratio[d][output_id], filterSet[d][output_id]);
     }
 
+    if ((ctx->cfg->filter_kernel[output_id] != XLNX_FILTER_KERNEL_DEFAULT) &&
+        (session->props.output[output_id].coeffLoad != XMA_COEFF_LOAD_FROM_FILE)) {
+      FilterTable *htbl = filter_bank_lookup(ctx->cfg->filter_kernel[output_id],
+                                             ctx->cfg->filter_B[output_id], ctx->cfg->filter_C[output_id],
+                                             ctx->in_width[output_id], ctx->out_width[output_id]);
+      FilterTable *vtbl = filter_bank_lookup(ctx->cfg->filter_kernel[output_id],
+                                             ctx->cfg->filter_B[output_id], ctx->cfg->filter_C[output_id],
+                                             ctx->in_height[output_id], ctx->out_height[output_id]);
+      if (htbl && vtbl) {
+        DEBUG_PRINT ("channel = %d, using filter bank kernel %d", output_id, ctx->cfg->filter_kernel[output_id]);
+        memcpy(ctx->cfg->FilterCoeffs[output_id].HfltCoeff, *htbl, sizeof(ctx->cfg->FilterCoeffs[output_id].HfltCoeff));
+        memcpy(ctx->cfg->FilterCoeffs[output_id].VfltCoeff, *vtbl, sizeof(ctx->cfg->FilterCoeffs[output_id].VfltCoeff));
+      } else {
+        /* bank unavailable (no memory or user B/C slots exhausted), generate in place */
+        DEBUG_PRINT ("channel = %d, generating filter kernel %d", output_id, ctx->cfg->filter_kernel[output_id]);
+        Generate_kernel_filter(ctx->cfg->filter_kernel[output_id], ctx->cfg->filter_B[output_id], ctx->cfg->filter_C[output_id],
+                               (double)ctx->in_width[output_id] / ctx->out_width[output_id],
+                               ctx->cfg->FilterCoeffs[output_id].HfltCoeff);
+        Generate_kernel_filter(ctx->cfg->filter_kernel[output_id], ctx->cfg->filter_B[output_id], ctx->cfg->filter_C[output_id],
+                               (double)ctx->in_height[output_id] / ctx->out_height[output_id],
+                               ctx->cfg->FilterCoeffs[output_id].VfltCoeff);
+      }
+      continue;
+    }
+
     // TODO: loading coefficients default is not handled.. need to check why not in abr
     if (session->props.output[output_id].coeffLoad == XMA_COEFF_AUTO_GENERATE) {
       /* Auto generate cardinal cubic coefficients when coeffLoad is 0 */
@@ -381,11 +1345,11 @@ xlnx_multi_scaler_prepare_filter_tables (XmaScalerSession *session)
       if ((rt[0][output_id]==0) && (upscale_enable[0][output_id]!=1)) {
         DEBUG_PRINT ("Generate cardinal cubic horizontal coefficients");
         Generate_cardinal_cubic_spline(ctx->in_width[output_id], ctx->out_width[output_id],
-            filterSize, B, C, (int16_t *)ctx->FilterCoeffs[output_id].HfltCoeff);
+            filterSize, B, C, (int16_t *)ctx->cfg->FilterCoeffs[output_id].HfltCoeff);
       } else {
         /* get fixed horizontal filters*/
         DEBUG_PRINT ("Consider predefined horizontal filter coefficients");
-        copy_filt_set((ctx->FilterCoeffs[output_id].HfltCoeff), filterSet[0][output_id]);
+        copy_filt_set((ctx->cfg->FilterCoeffs[output_id].HfltCoeff), filterSet[0][output_id]);
       }
       /* horizontal filters */
       rt[1][output_id] = feasibilityCheck(ctx->in_height[output_id], ctx->out_height[output_id],
@@ -394,26 +1358,38 @@ xlnx_multi_scaler_prepare_filter_tables (XmaScalerSession *session)
         DEBUG_PRINT ("Generate cardinal cubic vertical coefficients");
         Generate_cardinal_cubic_spline(ctx->in_height[output_id],
             ctx->out_height[output_id], filterSize, B, C,
-            (int16_t *)ctx->FilterCoeffs[output_id].VfltCoeff);
+            (int16_t *)ctx->cfg->FilterCoeffs[output_id].VfltCoeff);
       } else {
         /* get fixed vertical filters*/
         DEBUG_PRINT ("Consider predefined vertical filter coefficients");
-        copy_filt_set((ctx->FilterCoeffs[output_id].VfltCoeff), filterSet[1][output_id]);
+        copy_filt_set((ctx->cfg->FilterCoeffs[output_id].VfltCoeff), filterSet[1][output_id]);
       }
     } else if ((session->props.output[output_id].coeffLoad == XMA_COEFF_LOAD_FROM_FILE)) {
       load_coeff_file = true;
     } else { //XMA_COEFF_USE_DEFAULT
       /* get fixed horizontal filters*/
       DEBUG_PRINT ("Consider predefined horizontal filter coefficients");
-      copy_filt_set((ctx->FilterCoeffs[output_id].HfltCoeff), filterSet[0][output_id]);
+      copy_filt_set((ctx->cfg->FilterCoeffs[output_id].HfltCoeff), filterSet[0][output_id]);
 
       /* get fixed vertical filters*/
       DEBUG_PRINT ("Consider predefined vertical filter coefficients");
-      copy_filt_set((ctx->FilterCoeffs[output_id].VfltCoeff), filterSet[1][output_id]);
+      copy_filt_set((ctx->cfg->FilterCoeffs[output_id].VfltCoeff), filterSet[1][output_id]);
     }
   }
 
   if (load_coeff_file) {
+    CoeffFileMap *map;
+    int is_text;
+
+    map = coeff_file_acquire(session->props.input.coeffFile, &is_text);
+    if (map) {
+      int32_t ret = load_binary_coeff_file(session, map);
+      coeff_file_release(map);
+      return ret;
+    } else if (!is_text) {
+      return XMA_ERROR;
+    }
+
     xma_logmsg(XMA_INFO_LOG, XMA_MULTISCALER, " --------------------------------------------------------------");
     xma_logmsg(XMA_INFO_LOG, XMA_MULTISCALER, "INFO: Expects to load from 'FilterCoeff.txt'."
         "For all output resolutions coeffLoad is set to 2,  "
@@ -436,7 +1412,7 @@ xlnx_multi_scaler_prepare_filter_tables (XmaScalerSession *session)
         /* load horizontal filters from file when specific out index requires */
         if ((session->props.output[output_id].coeffLoad == XMA_COEFF_LOAD_FROM_FILE) && load_coeff_file) {
           r &= (fscanf(fp_coeff, "%d", &temp)!=EOF);
-          ctx->FilterCoeffs[output_id].HfltCoeff[i][j] = (int16_t) temp;
+          ctx->cfg->FilterCoeffs[output_id].HfltCoeff[i][j] = (int16_t) temp;
         }
       }
     }
@@ -448,7 +1424,7 @@ xlnx_multi_scaler_prepare_filter_tables (XmaScalerSession *session)
         /* load horizontal filters from file when specific out index requires */
         if ((session->props.output[output_id].coeffLoad == XMA_COEFF_LOAD_FROM_FILE) && load_coeff_file) {
           r &= (fscanf(fp_coeff, "%d", &temp)!=EOF);
-          ctx->FilterCoeffs[output_id].VfltCoeff[i][j] = (int16_t) temp;
+          ctx->cfg->FilterCoeffs[output_id].VfltCoeff[i][j] = (int16_t) temp;
         }
       }
     }
@@ -466,26 +1442,193 @@ xlnx_multi_scaler_prepare_filter_tables (XmaScalerSession *session)
   return XMA_SUCCESS;
 }
 
+/* A whole output frame: a band may cover every row but those above it */
+static size_t slice_scratch_size(MultiScalerContext *ctx, int output_id)
+{
+  return ((size_t)ctx->out_stride[output_id] * ctx->out_hgt_align[output_id] * 3) / 2;
+}
+
+static void carve_dev_region(MultiScalerContext *ctx, XlnxDevRegion *region, size_t size, size_t *offset)
+{
+  region->offset = *offset;
+  region->size   = size;
+  region->data   = ctx->dev_arena.data + *offset;
+  region->paddr  = ctx->dev_arena.paddr + *offset;
+  *offset += ALIGN(size, SCL_DEV_REGION_ALIGN);
+}
+
+/* send host copy of an arena region to the device */
+static int32_t write_dev_region(XmaScalerSession *session, XlnxDevRegion *region)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  return xma_plg_buffer_write(session->base, ctx->dev_arena, region->size, region->offset);
+}
+
+/*****************************************************************************
+ * Shared output pools
+ * Sessions opted in with "shared_pools" draw output buffers from a process
+ * wide registry keyed by device, bank and buffer size. Every session joining
+ * a pool grows it to MAX_OUTPOOL_BUFFERS per user and the last user to leave
+ * destroys it. XVBM pools can not shrink, so a pool stays at the size of
+ * its peak number of users until then.
+*****************************************************************************/
+typedef struct
+{
+  int32_t         dev_index;
+  int32_t         bank_index;
+  size_t          size;
+  XvbmPoolHandle  pool;
+  int32_t         users;
+} SharedPoolEntry;
+
+static SharedPoolEntry shared_pool[SHARED_POOL_MAX_ENTRIES];
+static pthread_mutex_t shared_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static XvbmPoolHandle shared_pool_acquire(XmaScalerSession *session, size_t size, int32_t bank)
+{
+  XmaSession xma_session = session->base;
+  SharedPoolEntry *entry = NULL, *free_entry = NULL;
+  XvbmBufferHandle buffer;
+  XvbmPoolHandle pool = NULL;
+  int32_t have, need;
+  int i;
+
+  pthread_mutex_lock(&shared_pool_lock);
+  for (i = 0; i < SHARED_POOL_MAX_ENTRIES; i++) {
+    if (!shared_pool[i].users) {
+      if (!free_entry)
+        free_entry = &shared_pool[i];
+      continue;
+    }
+    if ((shared_pool[i].dev_index == xma_session.hw_session.dev_index) &&
+        (shared_pool[i].bank_index == bank) &&
+        (shared_pool[i].size == size)) {
+      entry = &shared_pool[i];
+      break;
+    }
+  }
+
+  if (entry) {
+    /* buffers added by earlier pool extensions count towards the share */
+    buffer = xvbm_get_buffer_handle(entry->pool, 0);
+    have   = xvbm_buffer_pool_num_buffers_get(buffer);
+    need   = (entry->users + 1) * MAX_OUTPOOL_BUFFERS;
+    if ((have < need) && (xvbm_buffer_pool_extend(buffer, need - have) != (uint32_t)need)) {
+      ERROR_PRINT ("Shared pool %p extension to %d buffers failed", entry->pool, need);
+      pthread_mutex_unlock(&shared_pool_lock);
+      return NULL;
+    }
+    entry->users++;
+    pool = entry->pool;
+    xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "      Joined shared pool %p, %d users, %d buffers\n",
+               pool, entry->users, have < need ? need : have);
+  } else {
+    pool = xvbm_buffer_pool_create(xma_plg_get_dev_handle(xma_session),
+                                   MAX_OUTPOOL_BUFFERS, size, bank);
+    if (pool && free_entry) {
+      free_entry->dev_index  = xma_session.hw_session.dev_index;
+      free_entry->bank_index = bank;
+      free_entry->size       = size;
+      free_entry->pool       = pool;
+      free_entry->users      = 1;
+    } else if (pool) {
+      xma_logmsg(XMA_INFO_LOG, XMA_MULTISCALER, "Shared pool registry full, pool %p is private\n", pool);
+    }
+  }
+  pthread_mutex_unlock(&shared_pool_lock);
+  return pool;
+}
+
+static void shared_pool_release(XvbmPoolHandle pool)
+{
+  int i;
+
+  pthread_mutex_lock(&shared_pool_lock);
+  for (i = 0; i < SHARED_POOL_MAX_ENTRIES; i++) {
+    if (shared_pool[i].users && (shared_pool[i].pool == pool)) {
+      if (--shared_pool[i].users == 0) {
+        xvbm_buffer_pool_destroy(pool);
+        memset(&shared_pool[i], 0, sizeof(shared_pool[i]));
+      }
+      pthread_mutex_unlock(&shared_pool_lock);
+      return;
+    }
+  }
+  pthread_mutex_unlock(&shared_pool_lock);
+  /* created while the registry was full */
+  xvbm_buffer_pool_destroy(pool);
+}
+
+static XvbmPoolHandle create_output_pool(XmaScalerSession *session, int output_id, int plane_id)
+{
+  XmaSession xma_session = session->base;
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  XvbmPoolHandle p_handle;
+  size_t b_size;
+
+  b_size = get_plane_size(ctx->out_stride[output_id], ctx->out_height[output_id],
+                          session->props.output[output_id].format,
+                          plane_id,  SCL_OUT_HEIGHT_ALIGN);
+  if (ctx->cfg->shared_pools)
+    p_handle = shared_pool_acquire(session, b_size, ctx->cfg->out_bank[output_id]);
+  else
+    p_handle = xvbm_buffer_pool_create(xma_plg_get_dev_handle(xma_session),
+                                       ctx->thumb_out[output_id] ? THUMB_POOL_BUFFERS : MAX_OUTPOOL_BUFFERS,
+                                       b_size,
+                                       ctx->cfg->out_bank[output_id]);
+  if (p_handle)
+    xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "      [plane_id: %d]:: Created Pool %p (%4d x %4d) on bank %d\n",plane_id,
+                    p_handle,
+                    ctx->out_stride[output_id],
+                    ctx->out_hgt_align[output_id],
+                    ctx->cfg->out_bank[output_id]);
+  return p_handle;
+}
+
+static void destroy_output_pools(XmaScalerSession *session, int output_id)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  int plane_id;
+
+  for (plane_id = 0; plane_id < MAX_VPLANES; plane_id++) {
+    if (!ctx->out_phandle[output_id][plane_id])
+      continue;
+    if (ctx->cfg->shared_pools)
+      shared_pool_release(ctx->out_phandle[output_id][plane_id]);
+    else
+      xvbm_buffer_pool_destroy(ctx->out_phandle[output_id][plane_id]);
+    ctx->out_phandle[output_id][plane_id] = NULL;
+  }
+}
+
 static int32_t
 multi_scaler_allocate_buffers (XmaScalerSession *session)
 {
   XmaSession xma_session = session->base;
   MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
   int output_id = 0, ret=0;
-  int plane_id, pipe_id;
+  int plane_id, pipe_id, desc_id;
   int max_outputs   = MIN(ctx->num_outs, MAX_OUTPUTS);
+  /* a slice band takes a second descriptor per output for its copy out */
+  int num_desc      = max_outputs * ctx->batch_frames * ctx->num_fields * (ctx->slice_rows ? 2 : 1);
   int ddr_bank_index = xma_session.hw_session.bank_index;
-  size_t        b_size;
+  size_t        b_size, offset;
   XmaBufferObj  bo_handle;
   XvbmPoolHandle  p_handle;
+  uint32_t      num;
 
   /* allocate input buffers */
   xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "Allocate buffer pool for input ->");
   b_size = (ctx->in_stride[0] * ALIGN(session->props.input.height,
            SCL_IN_HEIGHT_ALIGN)) * 1.5;
 
+  /* batching keeps a full batch queued while the previous one drains,
+   * passthrough outputs lend input buffers downstream */
+  num = ctx->batch_frames > 1 ? ctx->batch_frames + 1 : (ctx->split_threads ? SPLIT_RING_DEPTH : 1);
+  if (ctx->num_passthrough)
+    num += MAX_OUTPOOL_BUFFERS;
   p_handle = xvbm_buffer_pool_create(xma_plg_get_dev_handle(xma_session),
-                                     1,
+                                     num,
                                      b_size,
                                      ddr_bank_index);
   if (!p_handle) {
@@ -501,109 +1644,63 @@ multi_scaler_allocate_buffers (XmaScalerSession *session)
 
   for (output_id = 0; output_id < max_outputs; output_id++) {
     xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "    [Chan id=%d]", output_id);
+    if (ctx->out_alias[output_id])
+      continue;
 
     for (plane_id = 0; plane_id < get_num_video_planes(session->props.output[output_id].format); plane_id++) {
-      b_size = get_plane_size(ctx->out_stride[output_id], ctx->out_height[output_id],
-                              session->props.output[output_id].format,
-                              plane_id,  SCL_OUT_HEIGHT_ALIGN);
-      /* For normal session allocate buffers from new pool */
-      if (!ctx->session_mix_rate) {
-          p_handle = xvbm_buffer_pool_create(xma_plg_get_dev_handle(xma_session),
-                                             MAX_OUTPOOL_BUFFERS,
-                                             b_size,
-                                             ddr_bank_index);
-          if (!p_handle) {
-             ERROR_PRINT ("Output buffer pool create failed\n");
-             goto cleanup;
-          }
-          ctx->out_phandle[output_id][plane_id] = p_handle;
-          xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "      [plane_id: %d]:: Created Pool %p (%4d x %4d)\n",plane_id,
-                          ctx->out_phandle[output_id][plane_id],
-                          ctx->out_stride[output_id],
-                          ctx->out_hgt_align[output_id]);
-      } else {
-        /* For mix_rate session extend the pool allocated in previous session */
-        MultiScalerContext *mixrate_ctx = (MultiScalerContext *)ctx->session_mix_rate->base.plugin_data;
-        XvbmPoolHandle shared_pool = NULL;
-        XvbmBufferHandle buffer    = NULL;
-        size_t prev_size           = 0;
-        int num = 0;
-
-        shared_pool = mixrate_ctx->out_phandle[output_id][plane_id];
-        if (shared_pool) {
-            //pool for requested output_id exists. Join sessions by extending existing pool
-            xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "Chan_id = %d :: Shared Pool %p Exists with %d buffers\n",
-                      output_id,shared_pool,xvbm_get_freelist_count(shared_pool));
-            buffer    = xvbm_get_buffer_handle(shared_pool, 0);
-            prev_size = xvbm_buffer_get_size(buffer);
-            //ensure buffers in prev_pool is of same size as requested for this session
-            if (prev_size == b_size) {
-                int cnt = xvbm_buffer_pool_num_buffers_get(buffer);
-                num     = xvbm_buffer_pool_extend(buffer, MAX_OUTPOOL_BUFFERS);
-                if (num == (cnt + MAX_OUTPOOL_BUFFERS)) {
-                    xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "Chan_id = %d :: Extended Shared pool to %d buffers\n",output_id,num);
-                } else {
-                    ERROR_PRINT("%s : scaler pool extension failed\n", __func__);
-                    goto cleanup;
-                }
-                ctx->out_phandle[output_id][plane_id] = shared_pool;
-            } else {
-                ERROR_PRINT ("ERROR:: output_id = %d shared output buffer size mismatch\n", output_id);
-                goto cleanup;
-            }
-        } else {
-          ERROR_PRINT ("ERROR:: Shared Output buffer pool create failed. Unable to join sessions\n");
-          goto cleanup;
-        }
+      p_handle = create_output_pool(session, output_id, plane_id);
+      if (!p_handle) {
+         ERROR_PRINT ("Output buffer pool create failed\n");
+         goto cleanup;
       }
+      ctx->out_phandle[output_id][plane_id] = p_handle;
     }/* plane_id */
   }/* output_id */
 
-  //Allocate memory for filtercoeffs and get addr HfltCoeff & VfltCoeff
+  /* Filter coeffs and DDR Register Descriptors of all outputs are carved
+   * from one device allocation to limit BO count and fragmentation */
+  b_size = 0;
   for (output_id = 0; output_id < max_outputs; output_id++) {
-    b_size    = sizeof(ctx->FilterCoeffs[output_id].HfltCoeff);
-    bo_handle = xma_plg_buffer_alloc(xma_session, b_size, false, &ret);
-    if (ret == XMA_SUCCESS) {
-        ctx->HfltCoeff_Buffer[output_id] = bo_handle;
-        DEBUG_PRINT ("HfltCoeff[%d] : paddr = %p, bo_handle = %u, size = %lu",
-                     output_id,
-                     (void*)ctx->HfltCoeff_Buffer[output_id].paddr,
-                     ctx->HfltCoeff_Buffer[output_id].data, b_size);
-    } else {
-        ERROR_PRINT("H_FilterCoeff Buffer Allocation Failed");
-        goto cleanup;
-    }
-    //VfltCoeff
-    b_size    = sizeof(ctx->FilterCoeffs[output_id].VfltCoeff);
+    b_size += ALIGN(sizeof(ctx->cfg->FilterCoeffs[output_id].HfltCoeff), SCL_DEV_REGION_ALIGN);
+    b_size += ALIGN(sizeof(ctx->cfg->FilterCoeffs[output_id].VfltCoeff), SCL_DEV_REGION_ALIGN) * ctx->num_fields;
+  }
+  b_size += MAX_PIPELINE_BUFFERS * num_desc * ALIGN(sizeof(XV_MULTISCALER_DESCRIPTOR), SCL_DEV_REGION_ALIGN);
+  if (ctx->slice_rows) {
+    b_size += ALIGN(sizeof(ctx->cfg->FilterCoeffs[0].VfltCoeff), SCL_DEV_REGION_ALIGN);
+    for (output_id = 0; output_id < max_outputs; output_id++)
+      b_size += ALIGN(slice_scratch_size(ctx, output_id), SCL_DEV_REGION_ALIGN);
+  }
+  if (ctx->cfg->arena_bank != ddr_bank_index)
+    bo_handle = xma_plg_buffer_alloc_ddr(xma_session, b_size, false, ctx->cfg->arena_bank, &ret);
+  else
     bo_handle = xma_plg_buffer_alloc(xma_session, b_size, false, &ret);
-    if (ret == XMA_SUCCESS) {
-        ctx->VfltCoeff_Buffer[output_id] = bo_handle;
-        DEBUG_PRINT ("VfltCoeff[%d] : paddr = %p, bo_handle = %u, size = %lu",
-                     output_id,
-                     (void*)ctx->VfltCoeff_Buffer[output_id].paddr,
-                     ctx->VfltCoeff_Buffer[output_id],
-                     b_size);
-    } else {
-        ERROR_PRINT("V_FilterCoeff Buffer Allocation Failed");
-        goto cleanup;
-    }
+  if (ret != XMA_SUCCESS) {
+    ERROR_PRINT("Coefficient/Descriptor Device Buffer Allocation Failed");
+    goto cleanup;
+  }
+  ctx->dev_arena = bo_handle;
+  DEBUG_PRINT ("Device arena : paddr = %p, size = %lu", (void*)ctx->dev_arena.paddr, b_size);
 
-    //Allocate device buffer for DDR Register Descriptor
-    for (pipe_id = 0; pipe_id < MAX_PIPELINE_BUFFERS; pipe_id++) {
-      b_size = sizeof(*ctx->desc[pipe_id]);
-      bo_handle = xma_plg_buffer_alloc(xma_session, b_size, false, &ret);
-      if (ret == XMA_SUCCESS) {
-        ctx->desc_buffer[pipe_id][output_id] = bo_handle;
-      } else {
-        ERROR_PRINT("Command Block Device Buffer Allocation Failed");
-        goto cleanup;
-      }
-    }
+  offset = 0;
+  for (output_id = 0; output_id < max_outputs; output_id++) {
+    carve_dev_region(ctx, &ctx->cfg->HfltCoeff_Buffer[output_id], sizeof(ctx->cfg->FilterCoeffs[output_id].HfltCoeff), &offset);
+    carve_dev_region(ctx, &ctx->cfg->VfltCoeff_Buffer[output_id], sizeof(ctx->cfg->FilterCoeffs[output_id].VfltCoeff), &offset);
+    if (ctx->num_fields > 1)
+      carve_dev_region(ctx, &ctx->cfg->VfltField_Buffer[output_id], sizeof(ctx->cfg->FilterCoeffs[output_id].VfltCoeff), &offset);
+  }
+  for (pipe_id = 0; pipe_id < MAX_PIPELINE_BUFFERS; pipe_id++) {
+    for (desc_id = 0; desc_id < num_desc; desc_id++)
+      carve_dev_region(ctx, &ctx->desc_buffer[pipe_id][desc_id], sizeof(XV_MULTISCALER_DESCRIPTOR), &offset);
+  }
+  if (ctx->slice_rows) {
+    carve_dev_region(ctx, &ctx->slice_copy_coeff, sizeof(ctx->cfg->FilterCoeffs[0].VfltCoeff), &offset);
+    for (output_id = 0; output_id < max_outputs; output_id++)
+      carve_dev_region(ctx, &ctx->slice_scratch[output_id], slice_scratch_size(ctx, output_id), &offset);
   }
 
   //Allocate HOST memory for DDR Register Descriptor Context
   for (pipe_id = 0; pipe_id < MAX_PIPELINE_BUFFERS; pipe_id++) {
-    ctx->desc[pipe_id] = (XV_MULTISCALER_DESCRIPTOR *)calloc(max_outputs, sizeof(*ctx->desc[0]));
+    ctx->desc[pipe_id] = (XV_MULTISCALER_DESCRIPTOR *)calloc(num_desc, sizeof(*ctx->desc[0]));
     if(!ctx->desc[pipe_id]) {
       ERROR_PRINT("HW Descriptor Host Memory Allocation Failed");
       goto cleanup;
@@ -612,29 +1709,18 @@ multi_scaler_allocate_buffers (XmaScalerSession *session)
 
   return XMA_SUCCESS;
 cleanup:
-  for (output_id = 0; output_id < max_outputs; output_id++) {
-    //@TODO add and use pool sharing API in xvbm
-    if (!ctx->session_mix_rate) {
-      for (plane_id = 0; plane_id < get_num_video_planes(session->props.output[output_id].format); plane_id++) {
-        if (ctx->out_phandle[output_id][plane_id]) {
-            xvbm_buffer_pool_destroy(ctx->out_phandle[output_id][plane_id]);
-        }
-      }/* plane_id */
-    }
+  for (output_id = 0; output_id < max_outputs; output_id++)
+    destroy_output_pools(session, output_id);
 
-    if(ctx->HfltCoeff_Buffer[output_id].data) {
-      xma_plg_buffer_free(xma_session, ctx->HfltCoeff_Buffer[output_id]);
-    }
-    if (ctx->VfltCoeff_Buffer[output_id].data) {
-      xma_plg_buffer_free(xma_session, ctx->VfltCoeff_Buffer[output_id]);
-    }
+  if (ctx->in_phandle) {
+    xvbm_buffer_pool_destroy(ctx->in_phandle);
+    ctx->in_phandle = NULL;
+  }
 
-    for (pipe_id = 0; pipe_id < MAX_PIPELINE_BUFFERS; pipe_id++) {
-      if(ctx->desc_buffer[pipe_id][output_id].data) {
-        xma_plg_buffer_free(xma_session, ctx->desc_buffer[pipe_id][output_id]);
-       }
-    }
-  }/* output_id */
+  if (ctx->dev_arena.data) {
+    xma_plg_buffer_free(xma_session, ctx->dev_arena);
+    memset(&ctx->dev_arena, 0, sizeof(ctx->dev_arena));
+  }
 
   for (pipe_id = 0; pipe_id < MAX_PIPELINE_BUFFERS; pipe_id++) {
     if (ctx->desc[pipe_id])
@@ -715,605 +1801,3412 @@ void print_desc_config(XmaScalerSession *session)
 *****************************************************************************/
 static void write_desc_data_to_device(XmaScalerSession *session)
 {
-  XmaSession xma_session = session->base;
   MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
 
-  int output_id;
+  int desc_id;
   int max_outputs = MIN(ctx->num_outs, MAX_OUTPUTS);
+  int first_desc  = ctx->batch_fill * max_outputs;
 
-  for (output_id = 0; output_id < max_outputs ; output_id++) {
+  //only the descriptors of the batch slot being filled change
+  for (desc_id = first_desc; desc_id < first_desc + max_outputs * (int)ctx->num_fields; desc_id++) {
     //copy host config data to allocated device buffer
-    memcpy(ctx->desc_buffer[ctx->pipe_idx][output_id].data,
-           &ctx->desc[ctx->pipe_idx][output_id],
-           ctx->desc_buffer[ctx->pipe_idx][output_id].size);
+    memcpy(ctx->desc_buffer[ctx->pipe_idx][desc_id].data,
+           &ctx->desc[ctx->pipe_idx][desc_id],
+           ctx->desc_buffer[ctx->pipe_idx][desc_id].size);
 
     //send config data to device
-    xma_plg_buffer_write(xma_session,
-                         ctx->desc_buffer[ctx->pipe_idx][output_id],
-                         ctx->desc_buffer[ctx->pipe_idx][output_id].size, 0);
+    write_dev_region(session, &ctx->desc_buffer[ctx->pipe_idx][desc_id]);
   }
   //set device ddr start address for desc data in hw_reg
   memcpy((ctx->hw_reg[ctx->pipe_idx] + XV_MULTI_SCALER_CTRL_ADDR_START_ADDR_DATA),
-         &(ctx->desc_buffer[ctx->pipe_idx][0].paddr),
+         &(ctx->desc_buffer[ctx->pipe_idx][ctx->first_out].paddr),
          sizeof(uint64_t));
 }
 
+static void free_filter_coeffs(MultiScalerContext *ctx)
+{
+  free(ctx->cfg->FilterCoeffs);
+  ctx->cfg->FilterCoeffs = NULL;
+}
+
+/* Moves the sampling grid of a vertical table down by 'shift' input lines.
+ * Taps pushed out of the window are dropped and their weight is given to the
+ * largest remaining tap.
+ */
+static void field_shift_taps(int16_t src[VSC_PHASES][VSC_TAPS], double shift,
+                             int16_t dst[VSC_PHASES][VSC_TAPS])
+{
+  int p, t, n, q, src_sum, sum, max_t;
+  double pos;
+
+  for (p = 0; p < VSC_PHASES; p++) {
+    pos = (double)p / VSC_PHASES + shift;
+    n = (int)floor(pos);
+    q = (int)floor((pos - n) * VSC_PHASES + 0.5);
+    if (q == VSC_PHASES) {
+      q = 0;
+      n++;
+    }
+    src_sum = sum = max_t = 0;
+    for (t = 0; t < VSC_TAPS; t++) {
+      src_sum += src[q][t];
+      dst[p][t] = ((t - n >= 0) && (t - n < VSC_TAPS)) ? src[q][t - n] : 0;
+      sum += dst[p][t];
+      if (dst[p][t] > dst[p][max_t])
+        max_t = t;
+    }
+    dst[p][max_t] += src_sum - sum;
+  }
+}
+
+static void upload_filter_coeffs(XmaScalerSession *session)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  int output_id;
+  int max_outputs = MIN(ctx->num_outs, MAX_OUTPUTS);
+
+  for (output_id = 0; output_id < max_outputs ; output_id++) {
+    //copy Horz Filter Coeffs to allocated buffer
+    memcpy(ctx->cfg->HfltCoeff_Buffer[output_id].data,
+           ctx->cfg->FilterCoeffs[output_id].HfltCoeff,
+           ctx->cfg->HfltCoeff_Buffer[output_id].size);
+
+    //send Horz Filter Data to device
+    write_dev_region(session, &ctx->cfg->HfltCoeff_Buffer[output_id]);
+
+    //copy Vert Filter Coeffs to allocated buffer
+    if (ctx->num_fields > 1) {
+      /* scaled on its own, the top field samples (ratio - 1) / 4 field lines
+       * below where the frame grid puts it and the bottom field as far above */
+      double shift = ((double)ctx->in_height[output_id] / ctx->out_height[output_id] - 1.0) / 4;
+
+      field_shift_taps(ctx->cfg->FilterCoeffs[output_id].VfltCoeff, -shift,
+                       (int16_t (*)[VSC_TAPS])ctx->cfg->VfltCoeff_Buffer[output_id].data);
+      field_shift_taps(ctx->cfg->FilterCoeffs[output_id].VfltCoeff, shift,
+                       (int16_t (*)[VSC_TAPS])ctx->cfg->VfltField_Buffer[output_id].data);
+      write_dev_region(session, &ctx->cfg->VfltField_Buffer[output_id]);
+    } else {
+      memcpy(ctx->cfg->VfltCoeff_Buffer[output_id].data,
+             ctx->cfg->FilterCoeffs[output_id].VfltCoeff,
+             ctx->cfg->VfltCoeff_Buffer[output_id].size);
+    }
+
+    //send Vert Filter Data to device
+    write_dev_region(session, &ctx->cfg->VfltCoeff_Buffer[output_id]);
+  }
+  if (ctx->slice_rows) {
+    /* 1:1 copy of band rows out of the scratch, the taps of a phase sum to 4096 */
+    int16_t (*taps)[VSC_TAPS] = (int16_t (*)[VSC_TAPS])ctx->slice_copy_coeff.data;
+    memset(taps, 0, ctx->slice_copy_coeff.size);
+    for (int phase = 0; phase < VSC_PHASES; phase++)
+      taps[phase][VSC_TAPS / 2 - 1] = 4096;
+    write_dev_region(session, &ctx->slice_copy_coeff);
+  }
+  free_filter_coeffs(ctx);
+}
+
 static int32_t write_registers(XmaScalerSession *session)
 {
-  XmaSession xma_session = session->base;
   MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
   uint32_t value;
-  int output_id, pipe_id;
+  int output_id, pipe_id, desc_id, prev_id;
   int max_outputs = MIN(ctx->num_outs, MAX_OUTPUTS);
+  int num_desc    = max_outputs * ctx->batch_frames * ctx->num_fields;
 
   for (pipe_id = 0; pipe_id < MAX_PIPELINE_BUFFERS; pipe_id++) {
-    /* write num outputs */
-    value = ctx->num_outs;
-    memcpy((ctx->hw_reg[pipe_id] + XV_MULTI_SCALER_CTRL_ADDR_NUM_OUTS_DATA), &value, sizeof(value));
-
-    for (output_id = 0; output_id < max_outputs ; output_id++) {
+    for (desc_id = 0; desc_id < num_desc ; desc_id++) {
+      output_id = desc_id % max_outputs;
       /*in_height*/
-      ctx->desc[pipe_id][output_id].heightIn = ctx->in_height[output_id];
+      ctx->desc[pipe_id][desc_id].heightIn = ctx->in_height[output_id];
 
       /*in_width*/
-      ctx->desc[pipe_id][output_id].widthIn = ctx->in_width[output_id];
+      ctx->desc[pipe_id][desc_id].widthIn = ctx->in_width[output_id];
 
       /*out_height*/
-      ctx->desc[pipe_id][output_id].heightOut = ctx->out_height[output_id];
+      ctx->desc[pipe_id][desc_id].heightOut = ctx->out_height[output_id];
 
       /*out_width*/
-      ctx->desc[pipe_id][output_id].widthOut = ctx->out_width[output_id];
+      ctx->desc[pipe_id][desc_id].widthOut = ctx->out_width[output_id];
 
       /*in_format*/
-      ctx->desc[pipe_id][output_id].inPixelFmt = ctx->in_format[output_id];
+      ctx->desc[pipe_id][desc_id].inPixelFmt = ctx->in_format[output_id];
 
       /*out_format*/
-      ctx->desc[pipe_id][output_id].outPixelFmt = ctx->out_format[output_id];
+      ctx->desc[pipe_id][desc_id].outPixelFmt = ctx->out_format[output_id];
 
       /*pixel_rate*/
-      ctx->desc[pipe_id][output_id].pixelRate = ctx->pixel_rate[output_id];
+      ctx->desc[pipe_id][desc_id].pixelRate = ctx->cfg->pixel_rate[output_id];
 
       /*line_rate*/
-      ctx->desc[pipe_id][output_id].lineRate = ctx->line_rate[output_id];
+      ctx->desc[pipe_id][desc_id].lineRate = ctx->cfg->line_rate[output_id];
 
       /*in_stride*/
-      ctx->desc[pipe_id][output_id].strideIn = ctx->in_stride[output_id];
+      ctx->desc[pipe_id][desc_id].strideIn = ctx->in_stride[output_id];
 
       /*out_stride*/
-      ctx->desc[pipe_id][output_id].strideOut = ctx->out_stride[output_id];
+      ctx->desc[pipe_id][desc_id].strideOut = ctx->out_stride[output_id];
 
       /*Filter coefficients*/
-      ctx->desc[pipe_id][output_id].hfltCoeffAddr = ctx->HfltCoeff_Buffer[output_id].paddr;
-      ctx->desc[pipe_id][output_id].vfltCoeffAddr = ctx->VfltCoeff_Buffer[output_id].paddr;
-
-      //copy Horz Filter Coeffs to allocated buffer
-      memcpy(ctx->HfltCoeff_Buffer[output_id].data,
-             ctx->FilterCoeffs[output_id].HfltCoeff,
-             ctx->HfltCoeff_Buffer[output_id].size);
-
-      //send Horz Filter Data to device
-      xma_plg_buffer_write(xma_session,
-                           ctx->HfltCoeff_Buffer[output_id],
-                           ctx->HfltCoeff_Buffer[output_id].size, 0);
-
-      //copy Vert Filter Coeffs to allocated buffer
-      memcpy(ctx->VfltCoeff_Buffer[output_id].data,
-             ctx->FilterCoeffs[output_id].VfltCoeff,
-             ctx->VfltCoeff_Buffer[output_id].size);
-
-      //send Vert Filter Data to device
-      xma_plg_buffer_write(xma_session,
-                           ctx->VfltCoeff_Buffer[output_id],
-                           ctx->VfltCoeff_Buffer[output_id].size, 0);
-
-      //set address of next block, in device memory
-      if (output_id < (max_outputs-1)) {
-          ctx->desc[pipe_id][output_id].nxtaddr = ctx->desc_buffer[pipe_id][output_id+1].paddr;
-      } else {
-          ctx->desc[pipe_id][output_id].nxtaddr = 0;
+      ctx->desc[pipe_id][desc_id].hfltCoeffAddr = ctx->cfg->HfltCoeff_Buffer[output_id].paddr;
+      ctx->desc[pipe_id][desc_id].vfltCoeffAddr = ctx->cfg->VfltCoeff_Buffer[output_id].paddr;
+
+      if (ctx->num_fields > 1) {
+        /* one descriptor per field, top fields first; inputs are always woven */
+        ctx->desc[pipe_id][desc_id].heightIn  = ctx->in_height[output_id] / 2;
+        ctx->desc[pipe_id][desc_id].heightOut = ctx->out_height[output_id] / 2;
+        ctx->desc[pipe_id][desc_id].strideIn  = ctx->in_stride[output_id] * 2;
+        if (!ctx->separate_fields[output_id])
+          ctx->desc[pipe_id][desc_id].strideOut = ctx->out_stride[output_id] * 2;
+        if (desc_id >= max_outputs)
+          ctx->desc[pipe_id][desc_id].vfltCoeffAddr = ctx->cfg->VfltField_Buffer[output_id].paddr;
       }
     }
+
+    //set address of next block in device memory, skipping outputs not scaled
+    value = 0;
+    prev_id = -1;
+    for (desc_id = 0; desc_id < num_desc ; desc_id++) {
+      if (!channel_scaled(ctx, desc_id % max_outputs))
+        continue;
+      if (prev_id >= 0)
+        ctx->desc[pipe_id][prev_id].nxtaddr = ctx->desc_buffer[pipe_id][desc_id].paddr;
+      prev_id = desc_id;
+      value++;
+    }
+    ctx->desc[pipe_id][prev_id].nxtaddr = 0;
+    memcpy((ctx->hw_reg[pipe_id] + XV_MULTI_SCALER_CTRL_ADDR_NUM_OUTS_DATA), &value, sizeof(value));
   }
   return XMA_SUCCESS;
 }
 
-/* Multi Scaler Initialization
- * Uses session properties to create buffers, selecting filter coefficients and
- * write one time kernel configuration registers/buffers
- */
-static int32_t
-xlnx_multi_scaler_init(XmaScalerSession *session)
+/*****************************************************************************
+ * Session warm pool
+ * Sessions opted in with "warm_pool" hand their pools, coefficient and
+ * descriptor buffers to a process wide cache on close. A later init with an
+ * identical ladder on the same device and bank adopts them, skipping filter
+ * generation, allocation and the coefficient upload. Entries are freed when
+ * evicted and when the plugin is unloaded.
+*****************************************************************************/
+typedef struct
 {
-  openlog ("XMA_Scaler", LOG_PID, LOG_USER);
-  assert(session != NULL);
-  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
-  int output_id = 0;
-  int max_outputs;
-  //XmaParameter* param;
-  int32_t xma_ret = XMA_SUCCESS;
-
-  ctx->enable_pipeline  = -1;
-  ctx->session_mix_rate = NULL;
-  syslog(LOG_DEBUG, "xma_scaler_handle = %p\n", ctx);
-  clock_gettime (CLOCK_REALTIME, &ctx->latency);
-  ctx->time_taken = (ctx->latency.tv_sec * 1e3) + (ctx->latency.tv_nsec / 1e6);
-  syslog(LOG_DEBUG, "%s : %p :  xma_start at %lld \n", __func__, ctx, ctx->time_taken);
-
-#ifdef DUMP_INPUT_FRAMES
-  infp = fopen ("xma_inframes.yuv", "w+");
-#endif
+  int32_t           dev_index;
+  int32_t           bank_index;
+  int32_t           num_outs;
+  uint32_t          batch_frames;
+  uint32_t          split_threads;
+  uint32_t          alias_outputs;
+  int32_t           coeff_load[MAX_OUTPUTS];
+  uint16_t          in_height[MAX_OUTPUTS];
+  uint16_t          in_width[MAX_OUTPUTS];
+  uint16_t          out_height[MAX_OUTPUTS];
+  uint16_t          out_width[MAX_OUTPUTS];
+  int32_t           in_format[MAX_OUTPUTS];
+  int32_t           out_format[MAX_OUTPUTS];
+  XlnxCropRect      crop[MAX_OUTPUTS];
+  uint8_t           filter_kernel[MAX_OUTPUTS];
+  float             filter_B[MAX_OUTPUTS];
+  float             filter_C[MAX_OUTPUTS];
+} WarmPoolKey;
+
+typedef struct
+{
+  bool                      valid;
+  uint64_t                  last_used;
+  WarmPoolKey               key;
+  XmaSession                owner;  /* copy of the releasing session, for its device handle */
+  XvbmPoolHandle            in_phandle;
+  XvbmPoolHandle            out_phandle[MAX_OUTPUTS][MAX_VPLANES];
+  int32_t                   num_buffers_extended[MAX_OUTPUTS];
+  XmaBufferObj              dev_arena;
+  XlnxDevRegion             HfltCoeff_Buffer[MAX_OUTPUTS];
+  XlnxDevRegion             VfltCoeff_Buffer[MAX_OUTPUTS];
+  XV_MULTISCALER_DESCRIPTOR *desc[MAX_PIPELINE_BUFFERS];
+  XlnxDevRegion             desc_buffer[MAX_PIPELINE_BUFFERS][MAX_OUTPUTS];
+} WarmPoolEntry;
 
-  //extract user extended property params
-  get_user_params(session);
-  xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "MultiScaler Pipeline Mode: %s", ((ctx->enable_pipeline == 1)  ? "Enabled" : ((ctx->enable_pipeline == 0) ? "Disabled" : "Automatic")));
-  if (ctx->session_mix_rate)
-    xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "MultiScaler MixRate  Mode: Enabled");
+static WarmPoolEntry   warm_pool[WARM_POOL_MAX_SESSIONS];
+static uint64_t        warm_pool_clock;
+static pthread_mutex_t warm_pool_lock = PTHREAD_MUTEX_INITIALIZER;
 
-  ctx->num_outs = session->props.num_outputs;
-  max_outputs = MIN(ctx->num_outs, MAX_OUTPUTS);
-  ctx->current_pipe = 0;
-  ctx->first_frame = 0;
-  ctx->recv_frame_cnt = 0;
-  ctx->sent_frame_cnt = 0;
-  ctx->s_idx = 0;
-  ctx->r_idx = 0;
-  ctx->pipe_idx = 0;
+static void warm_pool_make_key(XmaScalerSession *session, WarmPoolKey *key)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  int output_id;
 
-  if (ctx->num_outs > MAX_OUTPUTS) {
-     ERROR_PRINT("Number of outputs programmed %d, exceeds Maximum supported outputs %d.", ctx->num_outs, MAX_OUTPUTS);
-     return XMA_ERROR;
-  }
-  else if (ctx->num_outs <= 0) {
-     ERROR_PRINT("Number of outputs programmed %d, is incorrect. Need to mention atleast 1 to get a scaler output.", ctx->num_outs, MAX_OUTPUTS);
-     return XMA_ERROR;
+  /* zeroed first so padding compares equal */
+  memset(key, 0, sizeof(*key));
+  key->dev_index  = session->base.hw_session.dev_index;
+  key->bank_index = session->base.hw_session.bank_index;
+  key->num_outs   = ctx->num_outs;
+  key->batch_frames = ctx->batch_frames;
+  key->split_threads = ctx->split_threads;
+  key->alias_outputs = ctx->cfg->alias_outputs;
+  for (output_id = 0; output_id < MIN(ctx->num_outs, MAX_OUTPUTS); output_id++) {
+    key->coeff_load[output_id]    = session->props.output[output_id].coeffLoad;
+    key->in_height[output_id]     = ctx->in_height[output_id];
+    key->in_width[output_id]      = ctx->in_width[output_id];
+    key->out_height[output_id]    = ctx->out_height[output_id];
+    key->out_width[output_id]     = ctx->out_width[output_id];
+    key->in_format[output_id]     = ctx->in_format[output_id];
+    key->out_format[output_id]    = ctx->out_format[output_id];
+    key->crop[output_id]          = ctx->cfg->crop[output_id];
+    key->filter_kernel[output_id] = ctx->cfg->filter_kernel[output_id];
+    key->filter_B[output_id]      = ctx->cfg->filter_B[output_id];
+    key->filter_C[output_id]      = ctx->cfg->filter_C[output_id];
   }
+}
 
-  if ((session->props.input.width % MULTISCALER_PPC) > 0) {
-     ERROR_PRINT("in_width=%d is not supported as it is not a multiple of %d.\n",session->props.input.width,MULTISCALER_PPC );
-     return XMA_ERROR;
-  }
+static bool warm_pool_cacheable(XmaScalerSession *session)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  int output_id;
 
-  if ((session->props.input.height % MULTISCALER_PPC) > 0) {
-     ERROR_PRINT("in_height=%d is not supported as it is not a multiple of %d.\n",session->props.input.height,MULTISCALER_PPC );
-     return XMA_ERROR;
+  /* shared pools and file coefficients may change under a cached entry,
+   * cached pools sit on the session bank, field and slice mode have their
+   * own layout, thumbnail pools are smaller */
+  if (!ctx->cfg->warm_pool || ctx->cfg->shared_pools || ctx->cfg->num_suspended || ctx->cfg->ddr_banks || ctx->field_mode ||
+      ctx->num_thumbs || ctx->slice_rows)
+    return false;
+  for (output_id = 0; output_id < MIN(ctx->num_outs, MAX_OUTPUTS); output_id++) {
+    if (session->props.output[output_id].coeffLoad == XMA_COEFF_LOAD_FROM_FILE)
+      return false;
+    if (ctx->cfg->bank_hint[output_id] >= 0)
+      return false;
   }
+  return true;
+}
 
-  for (output_id=0; output_id < max_outputs; output_id++) {
-    if (output_id==0) {
-      ctx->in_height[output_id] = session->props.input.height;
-      ctx->in_width[output_id]  = session->props.input.width;
-      ctx->in_format[output_id] = get_multiscaler_ip_format(session->props.input.format);
-
-      if (ctx->in_format[output_id] == XV_MULTI_SCALER_Y_UV10_420)
-      {
-         ctx->in_stride[output_id] = MULTISCALER_ALIGN(((session->props.input.width + 2) / 3) * 4, SCL_IN_WIDTH_ALIGN);
-      }
-      else
-      {
-         ctx->in_stride[output_id] = MULTISCALER_ALIGN(session->props.input.width, SCL_IN_WIDTH_ALIGN);
-      }
-      ctx->in_hgt_align[output_id] = MULTISCALER_ALIGN(ctx->in_height[output_id], SCL_IN_HEIGHT_ALIGN);
-    } else {
-      /* assign input parameters with previous channel output paramters */
-      ctx->in_height[output_id] = session->props.output[output_id-1].height;
-      ctx->in_width[output_id]  = session->props.output[output_id-1].width;
-      ctx->in_format[output_id] = get_multiscaler_ip_format(session->props.output[output_id-1].format);
-      if (ctx->in_format[output_id] == XV_MULTI_SCALER_Y_UV10_420)
-      {
-         ctx->in_stride[output_id] = MULTISCALER_ALIGN(((session->props.output[output_id-1].width + 2) / 3) * 4, SCL_OUT_WIDTH_ALIGN);
-      }
-      else
-      {
-        ctx->in_stride[output_id] = MULTISCALER_ALIGN(session->props.output[output_id-1].width, SCL_OUT_WIDTH_ALIGN);
-      }
-      ctx->in_hgt_align[output_id] = ctx->out_hgt_align[output_id-1];
+/* The releasing session is gone by now. Its copy still carries the device
+ * handle the arena was allocated on, which stays open for the process.
+ */
+static void warm_pool_free_entry(WarmPoolEntry *entry)
+{
+  int output_id, plane_id, pipe_id;
+
+  if (entry->in_phandle)
+    xvbm_buffer_pool_destroy(entry->in_phandle);
+  if (entry->dev_arena.data)
+    xma_plg_buffer_free(entry->owner, entry->dev_arena);
+  for (output_id = 0; output_id < MIN(entry->key.num_outs, MAX_OUTPUTS); output_id++) {
+    for (plane_id = 0; plane_id < MAX_VPLANES; plane_id++) {
+      if (entry->out_phandle[output_id][plane_id])
+        xvbm_buffer_pool_destroy(entry->out_phandle[output_id][plane_id]);
     }
+  }
+  for (pipe_id = 0; pipe_id < MAX_PIPELINE_BUFFERS; pipe_id++)
+    free(entry->desc[pipe_id]);
+  memset(entry, 0, sizeof(*entry));
+}
 
-    ctx->out_height[output_id] = session->props.output[output_id].height;
-    ctx->out_width[output_id]  = session->props.output[output_id].width;
-    ctx->out_format[output_id] = get_multiscaler_ip_format(session->props.output[output_id].format);
-    if (ctx->out_format[output_id] == XV_MULTI_SCALER_Y_UV10_420)
-    {
-      ctx->out_stride[output_id] = MULTISCALER_ALIGN(((ctx->out_width[output_id] + 2) / 3) * 4, SCL_OUT_WIDTH_ALIGN);
-    }
-    else
-    {
-      ctx->out_stride[output_id] = MULTISCALER_ALIGN(ctx->out_width[output_id] , SCL_OUT_WIDTH_ALIGN);
+/* Moves cached resources into the session context, returns true on a hit */
+static bool warm_pool_adopt(XmaScalerSession *session)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  WarmPoolEntry *entry = NULL;
+  WarmPoolKey key;
+  int i;
+
+  if (!warm_pool_cacheable(session))
+    return false;
+
+  warm_pool_make_key(session, &key);
+  pthread_mutex_lock(&warm_pool_lock);
+  for (i = 0; i < WARM_POOL_MAX_SESSIONS; i++) {
+    if (warm_pool[i].valid && !memcmp(&warm_pool[i].key, &key, sizeof(key))) {
+      entry = &warm_pool[i];
+      break;
     }
+  }
+  if (entry) {
+    ctx->in_phandle = entry->in_phandle;
+    memcpy(ctx->out_phandle, entry->out_phandle, sizeof(ctx->out_phandle));
+    memcpy(ctx->num_buffers_extended, entry->num_buffers_extended, sizeof(ctx->num_buffers_extended));
+    ctx->dev_arena = entry->dev_arena;
+    memcpy(ctx->cfg->HfltCoeff_Buffer, entry->HfltCoeff_Buffer, sizeof(ctx->cfg->HfltCoeff_Buffer));
+    memcpy(ctx->cfg->VfltCoeff_Buffer, entry->VfltCoeff_Buffer, sizeof(ctx->cfg->VfltCoeff_Buffer));
+    memcpy(ctx->desc, entry->desc, sizeof(ctx->desc));
+    memcpy(ctx->desc_buffer, entry->desc_buffer, sizeof(ctx->desc_buffer));
+    memset(entry, 0, sizeof(*entry));
+  }
+  pthread_mutex_unlock(&warm_pool_lock);
 
-    ctx->out_hgt_align[output_id] = MULTISCALER_ALIGN(ctx->out_height[output_id], SCL_OUT_HEIGHT_ALIGN);
+  if (entry)
+    xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "Adopted warm pool session resources");
+  return entry != NULL;
+}
 
-    //check if resolution is within the limits (landscape or portrait mode)
-    if ((ctx->in_width[output_id]<=0)   || (ctx->in_width[output_id]>MAX_WIDTH)   ||
-        (ctx->in_height[output_id]<=0)  || (ctx->in_height[output_id]>MAX_WIDTH)  ||
-        (ctx->out_width[output_id]<=0)  || (ctx->out_width[output_id]>MAX_WIDTH)  ||
-        (ctx->out_height[output_id]<=0) || (ctx->out_height[output_id]>MAX_WIDTH) ||
-        ((ctx->in_width[output_id]  * ctx->in_height[output_id])  > MAX_PIXELS)   ||
-        ((ctx->out_width[output_id] * ctx->out_height[output_id]) > MAX_PIXELS)) {
-         ERROR_PRINT("Output %d (%dx%d to %dx%d): Maximum supported "
-             "resolution is %4dx%4d (%4dx%4d) and Minimum is 256x144.\n",
-             output_id,ctx->in_width[output_id],ctx->in_height[output_id],ctx->out_width[output_id],
-             ctx->out_height[output_id],MAX_WIDTH,MAX_HEIGHT,MAX_HEIGHT,MAX_WIDTH);
-         return XMA_ERROR;
+/* Hands a drained session's resources to the cache, returns true if taken */
+static bool warm_pool_release(XmaScalerSession *session)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  WarmPoolEntry *entry = NULL;
+  int i;
+
+  /* pools with buffers still held after a reset are not handed on */
+  if (!warm_pool_cacheable(session) || (ctx->recv_frame_cnt != ctx->sent_frame_cnt) || ctx->wd_num_held)
+    return false;
+
+  pthread_mutex_lock(&warm_pool_lock);
+  for (i = 0; i < WARM_POOL_MAX_SESSIONS; i++) {
+    if (!warm_pool[i].valid) {
+      entry = &warm_pool[i];
+      break;
     }
-
-    if ((ctx->out_width[output_id] % MULTISCALER_PPC) > 0) {
-        ERROR_PRINT("out_%d_width=%d is not supported as it is not a multiple of %d.\n",output_id+1, ctx->out_width[output_id],MULTISCALER_PPC );
-        return XMA_ERROR;
+  }
+  if (!entry) {
+    /* evict least recently cached entry on this device */
+    for (i = 0; i < WARM_POOL_MAX_SESSIONS; i++) {
+      if ((warm_pool[i].key.dev_index == session->base.hw_session.dev_index) &&
+          (!entry || (warm_pool[i].last_used < entry->last_used)))
+        entry = &warm_pool[i];
     }
+    if (entry)
+      warm_pool_free_entry(entry);
+  }
+  if (entry) {
+    warm_pool_make_key(session, &entry->key);
+    entry->owner = session->base;
+    entry->in_phandle = ctx->in_phandle;
+    memcpy(entry->out_phandle, ctx->out_phandle, sizeof(ctx->out_phandle));
+    memcpy(entry->num_buffers_extended, ctx->num_buffers_extended, sizeof(ctx->num_buffers_extended));
+    entry->dev_arena = ctx->dev_arena;
+    memcpy(entry->HfltCoeff_Buffer, ctx->cfg->HfltCoeff_Buffer, sizeof(ctx->cfg->HfltCoeff_Buffer));
+    memcpy(entry->VfltCoeff_Buffer, ctx->cfg->VfltCoeff_Buffer, sizeof(ctx->cfg->VfltCoeff_Buffer));
+    memcpy(entry->desc, ctx->desc, sizeof(ctx->desc));
+    memcpy(entry->desc_buffer, ctx->desc_buffer, sizeof(ctx->desc_buffer));
+    entry->last_used = ++warm_pool_clock;
+    entry->valid     = true;
+  }
+  pthread_mutex_unlock(&warm_pool_lock);
 
-    if ((ctx->out_height[output_id] % MULTISCALER_PPC) > 0) {
-        ERROR_PRINT("out_%d_height=%d is not supported as it is not a multiple of %d.\n",output_id+1, ctx->out_height[output_id],MULTISCALER_PPC );
-        return XMA_ERROR;
-    }
+  if (entry)
+    xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "Returned session resources to warm pool");
+  return entry != NULL;
+}
 
-    ctx->pixel_rate[output_id] = (uint32_t)((float)((ctx->in_width[output_id]*
-        STEP_PRECISION)+(ctx->out_width[output_id]/2))/(float)ctx->out_width[output_id]);
-    ctx->line_rate[output_id] = (uint32_t)((float)((ctx->in_height[output_id]*
-        STEP_PRECISION)+(ctx->out_height[output_id]/2))/(float)ctx->out_height[output_id]);
-  }
+/* Runs when the plugin is unloaded, at dlclose or process exit. The XRT
+ * libraries were loaded before the plugin, so their devices are still open.
+ */
+__attribute__((destructor)) static void warm_pool_teardown(void)
+{
+  int i;
 
-  for (output_id = 0; output_id < max_outputs; output_id++) {
-      xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "----------- Channel [%d] Params START -----------", output_id);
-      xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "Input : width = %u, height = %u, multiscale_fmt = %d (xma_fmt = %d), stride = %d",
-          ctx->in_width[output_id], ctx->in_height[output_id], ctx->in_format[output_id],
-          output_id == 0 ? session->props.input.format : session->props.output[output_id-1].format,
-          ctx->in_stride[output_id]);
-      xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "Output : width = %u, height = %u, multiscale_fmt = %d (xma_fmt = %d), stride = %d",
-          ctx->out_width[output_id], ctx->out_height[output_id], ctx->out_format[output_id], session->props.output[output_id].format, ctx->out_stride[output_id]);
-      xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "Channel pixel_rate = %d, linerate = %d", ctx->pixel_rate[output_id], ctx->line_rate[output_id]);
-      xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "----------- Channel [%d] Params END -----------", output_id);
+  pthread_mutex_lock(&warm_pool_lock);
+  for (i = 0; i < WARM_POOL_MAX_SESSIONS; i++) {
+    if (warm_pool[i].valid)
+      warm_pool_free_entry(&warm_pool[i]);
   }
+  pthread_mutex_unlock(&warm_pool_lock);
+}
 
-  /* prepare filter coefficients */
-  xma_ret = xlnx_multi_scaler_prepare_filter_tables (session);
-  if (xma_ret != XMA_SUCCESS) {
-    ERROR_PRINT ("failed to prepare filter tables...");
+/* Multi Scaler Initialization
+ * Uses session properties to create buffers, selecting filter coefficients and
+ * write one time kernel configuration registers/buffers
+ */
+/*****************************************************************************
+ * Shared CU queue
+ * Sessions opted in with "shared_cu" on the same device and CU append their
+ * descriptor chains to a common batch instead of starting the kernel on their
+ * own. The first member to reach recv links the chains, starts the kernel
+ * once for the whole batch and reaps the completion; the other members only
+ * wait for the batch to be marked done.
+ *
+ * A batch is "done" once its result is reported and "complete" once the
+ * device has finished it. A wait that times out reports an error, but the
+ * batch stays held as shared_stale until it is seen complete: the submitter
+ * keeps polling for it, the other members wait for that, before the next
+ * frame and at close. A session closing while its chain may still be read
+ * leaks its arena and pools rather than free them under the kernel.
+*****************************************************************************/
+typedef struct SharedCuBatch
+{
+  XmaScalerSession  *member[MAX_OUTPUTS];
+  int8_t            pipe[MAX_OUTPUTS];
+  int               num_members;
+  uint32_t          num_desc;
+  int               refcnt;
+  int32_t           group;
+  XmaScalerSession  *submitter;
+  bool              submitted;
+  bool              done;  /* status is set, waiters may return */
+  bool              complete;  /* the kernel no longer reads the member chains */
+  int32_t           status;
+} SharedCuBatch;
+
+typedef struct
+{
+  int               num_sessions;
+  int32_t           dev_index;
+  int32_t           cu_index;
+  char              cu_name[64];
+  SharedCuBatch     *open;
+} SharedCuGroup;
+
+static SharedCuGroup   shared_cu_group[SHARED_CU_MAX_GROUPS];
+static pthread_mutex_t shared_cu_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  shared_cu_cond = PTHREAD_COND_INITIALIZER;
+
+static bool shared_cu_same_cu(SharedCuGroup *group, XmaScalerSession *session)
+{
+  const char *cu_name = session->props.cu_name ? session->props.cu_name : "";
+
+  return (group->dev_index == session->props.dev_index) &&
+         (group->cu_index == session->props.cu_index) &&
+         !strncmp(group->cu_name, cu_name, sizeof(group->cu_name));
+}
+
+static int32_t shared_cu_join(XmaScalerSession *session)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  SharedCuGroup *free_group = NULL;
+  int i;
+
+  pthread_mutex_lock(&shared_cu_lock);
+  ctx->shared_cu_group = -1;
+  for (i = 0; i < SHARED_CU_MAX_GROUPS; i++) {
+    if (shared_cu_group[i].num_sessions && shared_cu_same_cu(&shared_cu_group[i], session)) {
+      ctx->shared_cu_group = i;
+      break;
+    }
+    if (!free_group && !shared_cu_group[i].num_sessions)
+      free_group = &shared_cu_group[i];
+  }
+  if ((ctx->shared_cu_group < 0) && free_group) {
+    free_group->dev_index = session->props.dev_index;
+    free_group->cu_index  = session->props.cu_index;
+    strncpy(free_group->cu_name, session->props.cu_name ? session->props.cu_name : "",
+            sizeof(free_group->cu_name) - 1);
+    free_group->open = NULL;
+    ctx->shared_cu_group = free_group - shared_cu_group;
+  }
+  if (ctx->shared_cu_group >= 0)
+    shared_cu_group[ctx->shared_cu_group].num_sessions++;
+  pthread_mutex_unlock(&shared_cu_lock);
+
+  if (ctx->shared_cu_group < 0) {
+    ERROR_PRINT ("All %d shared CU groups are in use", SHARED_CU_MAX_GROUPS);
+    return XMA_ERROR;
+  }
+  DEBUG_PRINT ("joined shared CU group %d", ctx->shared_cu_group);
+  return XMA_SUCCESS;
+}
+
+/* called with shared_cu_lock held */
+static void shared_cu_put_batch(SharedCuBatch *batch)
+{
+  if (--batch->refcnt)
+    return;
+  if (shared_cu_group[batch->group].open == batch)
+    shared_cu_group[batch->group].open = NULL;
+  free(batch);
+}
+
+/* Queues the descriptors written on the current pipe; replaces the kernel start */
+static int32_t shared_cu_enqueue(XmaScalerSession *session)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  SharedCuGroup *group = &shared_cu_group[ctx->shared_cu_group];
+  uint32_t num_desc = MIN(ctx->num_outs, MAX_OUTPUTS);
+  SharedCuBatch *batch;
+
+  pthread_mutex_lock(&shared_cu_lock);
+  batch = group->open;
+  if (!batch || batch->submitted || ((batch->num_desc + num_desc) > MAX_OUTPUTS)) {
+    batch = (SharedCuBatch *)calloc(1, sizeof(*batch));
+    if (!batch) {
+      pthread_mutex_unlock(&shared_cu_lock);
+      ERROR_PRINT ("shared CU batch allocation failed");
+      return XMA_ERROR;
+    }
+    batch->group = ctx->shared_cu_group;
+    group->open  = batch;
+  }
+  batch->member[batch->num_members] = session;
+  batch->pipe[batch->num_members]   = ctx->pipe_idx;
+  batch->num_members++;
+  batch->num_desc += num_desc;
+  batch->refcnt++;
+  ctx->shared_batch = batch;
+  pthread_mutex_unlock(&shared_cu_lock);
+  return XMA_SUCCESS;
+}
+
+/* Links the member chains on device and starts the kernel once for all */
+static int32_t shared_cu_submit(XmaScalerSession *session, SharedCuBatch *batch)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  MultiScalerContext *head = (MultiScalerContext*)batch->member[0]->base.plugin_data;
+  uint8_t regmap[XV_MULTI_SCALER_CTRL_REGMAP_SIZE];
+  int32_t xma_ret = XMA_SUCCESS;
+  int i;
+
+  for (i = 0; i < batch->num_members - 1; i++) {
+    MultiScalerContext *cur  = (MultiScalerContext*)batch->member[i]->base.plugin_data;
+    MultiScalerContext *next = (MultiScalerContext*)batch->member[i + 1]->base.plugin_data;
+    XlnxDevRegion *tail = &cur->desc_buffer[batch->pipe[i]][MIN(cur->num_outs, MAX_OUTPUTS) - 1];
+
+    /* device copy only, the member's host descriptor keeps ending its chain */
+    ((XV_MULTISCALER_DESCRIPTOR *)tail->data)->nxtaddr = next->desc_buffer[batch->pipe[i + 1]][0].paddr;
+    write_dev_region(batch->member[i], tail);
+  }
+
+  memcpy(regmap, ctx->hw_reg[ctx->pipe_idx], sizeof(regmap));
+  memcpy(regmap + XV_MULTI_SCALER_CTRL_ADDR_NUM_OUTS_DATA, &batch->num_desc, sizeof(batch->num_desc));
+  memcpy(regmap + XV_MULTI_SCALER_CTRL_ADDR_START_ADDR_DATA,
+         &head->desc_buffer[batch->pipe[0]][0].paddr, sizeof(uint64_t));
+
+  DEBUG_PRINT ("starting shared CU batch of %d sessions, %u descriptors", batch->num_members, batch->num_desc);
+  xma_plg_schedule_work_item(session->base, regmap, XV_MULTI_SCALER_CTRL_REGMAP_SIZE, &xma_ret);
+  if (xma_ret != XMA_SUCCESS)
+    ERROR_PRINT ("failed schedule request to XRT...val = %d", xma_ret);
+  return xma_ret;
+}
+
+/* Waits up to timeout_ms for a submitted batch to complete on the device.
+ * The submitter polls its session, on which the completion is counted. The
+ * reference is dropped once complete; returns false while it is not.
+ */
+static bool shared_cu_settle(XmaScalerSession *session, SharedCuBatch *batch, int32_t timeout_ms)
+{
+  struct timespec deadline;
+  bool complete;
+
+  pthread_mutex_lock(&shared_cu_lock);
+  if (!batch->complete && (batch->submitter == session)) {
+    pthread_mutex_unlock(&shared_cu_lock);
+    complete = xma_plg_is_work_item_done(session->base, timeout_ms) == XMA_SUCCESS;
+    pthread_mutex_lock(&shared_cu_lock);
+    if (complete) {
+      batch->complete = true;
+      pthread_cond_broadcast(&shared_cu_cond);
+    }
+  } else {
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    while (!batch->complete) {
+      if (pthread_cond_timedwait(&shared_cu_cond, &shared_cu_lock, &deadline) == ETIMEDOUT)
+        break;
+    }
+  }
+  complete = batch->complete;
+  if (complete)
+    shared_cu_put_batch(batch);
+  pthread_mutex_unlock(&shared_cu_lock);
+  return complete;
+}
+
+/* Waits for the batch holding this session's frame; replaces the done check */
+static int32_t shared_cu_wait(XmaScalerSession *session)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  SharedCuBatch *batch = ctx->shared_batch;
+  struct timespec deadline;
+  int32_t xma_ret;
+
+  if (!batch) {
+    ERROR_PRINT ("receive called with no frame queued on the shared CU");
+    return XMA_ERROR;
+  }
+  /* an earlier batch that failed must be off the device first, also so
+   * that the submitter does not take its completion for this one */
+  if (ctx->shared_stale) {
+    if (!shared_cu_settle(session, ctx->shared_stale, SHARED_CU_WAIT_MS)) {
+      ERROR_PRINT ("Scaler Stopped responding (earlier shared CU batch still running)");
+      return XMA_ERROR;
+    }
+    ctx->shared_stale = NULL;
+  }
+
+  pthread_mutex_lock(&shared_cu_lock);
+  if (!batch->submitted) {
+    bool complete;
+
+    /* first member to need its output starts the batch for everyone */
+    batch->submitted = true;
+    batch->submitter = session;
+    if (shared_cu_group[batch->group].open == batch)
+      shared_cu_group[batch->group].open = NULL;
+    pthread_mutex_unlock(&shared_cu_lock);
+
+    xma_ret = shared_cu_submit(session, batch);
+    /* a batch that was never started is complete as well */
+    complete = true;
+    if (xma_ret == XMA_SUCCESS) {
+      xma_ret = xma_plg_is_work_item_done(session->base, WD_MAX_MS);
+      if (xma_ret != XMA_SUCCESS) {
+        ERROR_PRINT ("Scaler Stopped responding");
+        complete = false;
+      }
+    }
+
+    pthread_mutex_lock(&shared_cu_lock);
+    batch->status   = xma_ret;
+    batch->done     = true;
+    batch->complete = complete;
+    pthread_cond_broadcast(&shared_cu_cond);
+  } else {
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += SHARED_CU_WAIT_MS / 1000;
+    while (!batch->done) {
+      if (pthread_cond_timedwait(&shared_cu_cond, &shared_cu_lock, &deadline) == ETIMEDOUT) {
+        ERROR_PRINT ("Scaler Stopped responding (shared CU batch)");
+        break;
+      }
+    }
+  }
+  xma_ret = batch->done ? batch->status : XMA_ERROR;
+  if (batch->complete)
+    shared_cu_put_batch(batch);
+  else
+    ctx->shared_stale = batch;  /* the kernel may still read this session's chain */
+  ctx->shared_batch = NULL;
+  pthread_mutex_unlock(&shared_cu_lock);
+  return xma_ret;
+}
+
+/* Returns true when the device may still read this session's descriptors */
+static bool shared_cu_leave(XmaScalerSession *session)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  SharedCuBatch *batch = ctx->shared_batch;
+  SharedCuBatch *stale = ctx->shared_stale;
+  bool in_use = false;
+  int i;
+
+  if (ctx->shared_cu_group < 0)
+    return false;
+
+  /* completions are counted in order, the older batch settles first */
+  if (stale && shared_cu_settle(session, stale, SHARED_CU_WAIT_MS))
+    stale = NULL;
+  in_use = stale != NULL;
+  ctx->shared_stale = NULL;
+
+  pthread_mutex_lock(&shared_cu_lock);
+  if (batch && !batch->submitted) {
+    /* frame never started, take the chain out before its buffers go away */
+    for (i = 0; i < batch->num_members; i++) {
+      if (batch->member[i] == session)
+        break;
+    }
+    for (; i < batch->num_members - 1; i++) {
+      batch->member[i] = batch->member[i + 1];
+      batch->pipe[i]   = batch->pipe[i + 1];
+    }
+    batch->num_members--;
+    batch->num_desc -= MIN(ctx->num_outs, MAX_OUTPUTS);
+    shared_cu_put_batch(batch);
+    batch = NULL;
+  } else if (batch) {
+    /* the kernel may still read this session's descriptors */
+    while (!batch->done)
+      pthread_cond_wait(&shared_cu_cond, &shared_cu_lock);
+  }
+  ctx->shared_batch = NULL;
+  shared_cu_group[ctx->shared_cu_group].num_sessions--;
+  ctx->shared_cu_group = -1;
+  pthread_mutex_unlock(&shared_cu_lock);
+
+  if (batch && !in_use && shared_cu_settle(session, batch, SHARED_CU_WAIT_MS))
+    batch = NULL;
+  in_use = in_use || (batch != NULL);
+
+  /* batches not seen complete keep their reference and are never freed;
+   * nobody polls for them once their submitter is gone */
+  pthread_mutex_lock(&shared_cu_lock);
+  if (stale && (stale->submitter == session))
+    stale->submitter = NULL;
+  if (batch && (batch->submitter == session))
+    batch->submitter = NULL;
+  pthread_mutex_unlock(&shared_cu_lock);
+  return in_use;
+}
+
+/*****************************************************************************
+ * CU capacity model
+ * Each session's kernel load is estimated from its cascade (see
+ * xlnx_multi_scaler_capacity.h) and committed against its CU at init. A
+ * session that would push the CU past its usable cycles is warned about or
+ * refused depending on the "admission" parameter.
+*****************************************************************************/
+typedef struct
+{
+  int               num_sessions;
+  int32_t           dev_index;
+  int32_t           cu_index;
+  char              cu_name[64];
+  XlnxScalerCuLoad  load;
+} CuLoadEntry;
+
+static CuLoadEntry     cu_load[CU_LOAD_MAX_ENTRIES];
+static pthread_mutex_t cu_load_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* frames per 1000 seconds, keeps fractional rates exact enough */
+static uint64_t capacity_fps_milli(XmaFraction fr)
+{
+  uint64_t fps_milli;
+
+  if ((fr.numerator <= 0) || (fr.denominator <= 0))
+    return MAX_FRAMERATE * 1000ULL;
+  fps_milli = ((uint64_t)fr.numerator * 1000) / fr.denominator;
+  /* callers divide by it */
+  return fps_milli ? fps_milli : 1;
+}
+
+static void capacity_add_channel(XlnxScalerCuLoad *load, uint64_t fps_milli,
+                                 uint32_t in_w, uint32_t in_h, uint32_t out_w, uint32_t out_h)
+{
+  uint64_t w = in_w > out_w ? in_w : out_w;
+  uint64_t h = in_h > out_h ? in_h : out_h;
+  uint64_t cycles = (w * h) / MULTISCALER_PPC + SCL_CHANNEL_OVERHEAD_CYCLES;
+
+  load->cycles_per_sec       += (cycles * fps_milli) / 1000;
+  load->read_pixels_per_sec  += ((uint64_t)in_w * in_h * fps_milli) / 1000;
+  load->write_pixels_per_sec += ((uint64_t)out_w * out_h * fps_milli) / 1000;
+}
+
+static void capacity_finish(XlnxScalerCuLoad *load)
+{
+  load->capacity_cycles_per_sec = (SCL_CU_CLOCK_HZ * SCL_CU_HEADROOM_PCT) / 100;
+  load->load_percent = (uint32_t)((load->cycles_per_sec * 100) / load->capacity_cycles_per_sec);
+}
+
+static bool capacity_same_cu(CuLoadEntry *entry, int32_t dev_index, int32_t cu_index, const char *cu_name)
+{
+  return (entry->dev_index == dev_index) && (entry->cu_index == cu_index) &&
+         (!cu_name || !strncmp(entry->cu_name, cu_name, sizeof(entry->cu_name)));
+}
+
+static int32_t capacity_admit(XmaScalerSession *session)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  const char *cu_name = session->props.cu_name ? session->props.cu_name : "";
+  uint64_t fps_milli = capacity_fps_milli(session->props.input.framerate);
+  XlnxScalerCuLoad projected;
+  CuLoadEntry *entry = NULL;
+  int output_id, i;
+
+  memset(&ctx->cfg->cu_load_cost, 0, sizeof(ctx->cfg->cu_load_cost));
+  for (output_id = 0; output_id < MIN(ctx->num_outs, MAX_OUTPUTS); output_id++) {
+    if (!channel_scaled(ctx, output_id))
+      continue;
+    /* thumbnails only at their sampling interval, IDR samples are not modelled */
+    if (ctx->thumb_out[output_id]) {
+      if (ctx->thumb_interval[output_id])
+        capacity_add_channel(&ctx->cfg->cu_load_cost, fps_milli / ctx->thumb_interval[output_id],
+                             ctx->in_width[output_id], ctx->in_height[output_id],
+                             ctx->out_width[output_id], ctx->out_height[output_id]);
+      continue;
+    }
+    capacity_add_channel(&ctx->cfg->cu_load_cost, fps_milli,
+                         ctx->in_width[output_id], ctx->in_height[output_id],
+                         ctx->out_width[output_id], ctx->out_height[output_id]);
+    /* the second field fetches its own descriptor and coefficients */
+    if (ctx->num_fields > 1)
+      ctx->cfg->cu_load_cost.cycles_per_sec += (SCL_CHANNEL_OVERHEAD_CYCLES * fps_milli) / 1000;
+  }
+  ctx->cfg->cu_load_cost.num_sessions = 1;
+  capacity_finish(&ctx->cfg->cu_load_cost);
+
+  pthread_mutex_lock(&cu_load_lock);
+  for (i = 0; i < CU_LOAD_MAX_ENTRIES; i++) {
+    if (cu_load[i].num_sessions &&
+        capacity_same_cu(&cu_load[i], session->props.dev_index, session->props.cu_index, cu_name)) {
+      entry = &cu_load[i];
+      break;
+    }
+  }
+  for (i = 0; !entry && (i < CU_LOAD_MAX_ENTRIES); i++) {
+    if (!cu_load[i].num_sessions) {
+      entry = &cu_load[i];
+      memset(entry, 0, sizeof(*entry));
+      entry->dev_index = session->props.dev_index;
+      entry->cu_index  = session->props.cu_index;
+      strncpy(entry->cu_name, cu_name, sizeof(entry->cu_name) - 1);
+    }
+  }
+  if (!entry) {
+    pthread_mutex_unlock(&cu_load_lock);
+    xma_logmsg(XMA_WARNING_LOG, XMA_MULTISCALER, "CU load table full, session load is not tracked");
+    return XMA_SUCCESS;
+  }
+
+  projected = entry->load;
+  projected.num_sessions++;
+  projected.cycles_per_sec       += ctx->cfg->cu_load_cost.cycles_per_sec;
+  projected.read_pixels_per_sec  += ctx->cfg->cu_load_cost.read_pixels_per_sec;
+  projected.write_pixels_per_sec += ctx->cfg->cu_load_cost.write_pixels_per_sec;
+  capacity_finish(&projected);
+
+  if ((projected.load_percent > 100) && (ctx->cfg->admission != XLNX_ADMISSION_OFF)) {
+    if (ctx->cfg->admission == XLNX_ADMISSION_REFUSE) {
+      pthread_mutex_unlock(&cu_load_lock);
+      ERROR_PRINT ("Session refused: CU %d:%d would be loaded to %u%% (session needs %u%%)",
+                   session->props.dev_index, session->props.cu_index,
+                   projected.load_percent, ctx->cfg->cu_load_cost.load_percent);
+      return XMA_ERROR;
+    }
+    xma_logmsg(XMA_WARNING_LOG, XMA_MULTISCALER,
+               "CU %d:%d oversubscribed: %u%% with this session (%u%%), expect dropped frames",
+               session->props.dev_index, session->props.cu_index,
+               projected.load_percent, ctx->cfg->cu_load_cost.load_percent);
+  }
+
+  entry->load = projected;
+  entry->num_sessions++;
+  ctx->cfg->cu_load_slot = entry - cu_load;
+  pthread_mutex_unlock(&cu_load_lock);
+  DEBUG_PRINT ("CU %d:%d load %u%% after adding session (%u%%)", session->props.dev_index,
+               session->props.cu_index, projected.load_percent, ctx->cfg->cu_load_cost.load_percent);
+  return XMA_SUCCESS;
+}
+
+static void capacity_release(XmaScalerSession *session)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  CuLoadEntry *entry;
+
+  if (ctx->cfg->cu_load_slot < 0)
+    return;
+  pthread_mutex_lock(&cu_load_lock);
+  entry = &cu_load[ctx->cfg->cu_load_slot];
+  entry->load.num_sessions--;
+  entry->load.cycles_per_sec       -= ctx->cfg->cu_load_cost.cycles_per_sec;
+  entry->load.read_pixels_per_sec  -= ctx->cfg->cu_load_cost.read_pixels_per_sec;
+  entry->load.write_pixels_per_sec -= ctx->cfg->cu_load_cost.write_pixels_per_sec;
+  capacity_finish(&entry->load);
+  entry->num_sessions--;
+  pthread_mutex_unlock(&cu_load_lock);
+  ctx->cfg->cu_load_slot = -1;
+}
+
+extern "C" int32_t xlnx_multi_scaler_get_cu_load(int32_t dev_index, int32_t cu_index, XlnxScalerCuLoad *load)
+{
+  int i;
+
+  if (!load)
+    return XMA_ERROR;
+  memset(load, 0, sizeof(*load));
+  pthread_mutex_lock(&cu_load_lock);
+  for (i = 0; i < CU_LOAD_MAX_ENTRIES; i++) {
+    if (cu_load[i].num_sessions && capacity_same_cu(&cu_load[i], dev_index, cu_index, NULL)) {
+      load->num_sessions         += cu_load[i].load.num_sessions;
+      load->cycles_per_sec       += cu_load[i].load.cycles_per_sec;
+      load->read_pixels_per_sec  += cu_load[i].load.read_pixels_per_sec;
+      load->write_pixels_per_sec += cu_load[i].load.write_pixels_per_sec;
+    }
+  }
+  pthread_mutex_unlock(&cu_load_lock);
+  capacity_finish(load);
+  return XMA_SUCCESS;
+}
+
+extern "C" int32_t xlnx_multi_scaler_estimate_load(const XmaScalerProperties *props, XlnxScalerCuLoad *load)
+{
+  uint64_t fps_milli;
+  uint32_t in_w, in_h;
+  int output_id;
+
+  if (!props || !load || (props->num_outputs <= 0) || (props->num_outputs > MAX_OUTPUTS))
+    return XMA_ERROR;
+  memset(load, 0, sizeof(*load));
+  fps_milli = capacity_fps_milli(props->input.framerate);
+  in_w = props->input.width;
+  in_h = props->input.height;
+  for (output_id = 0; output_id < props->num_outputs; output_id++) {
+    capacity_add_channel(load, fps_milli, in_w, in_h,
+                         props->output[output_id].width, props->output[output_id].height);
+    /* cascade, next channel reads this output */
+    in_w = props->output[output_id].width;
+    in_h = props->output[output_id].height;
+  }
+  load->num_sessions = 1;
+  capacity_finish(load);
+  return XMA_SUCCESS;
+}
+
+/*****************************************************************************
+ * DDR bank placement
+ * By default every pool and buffer lands on the session's bank. With
+ * "ddr_banks" the output pools, largest traffic first, go to whichever
+ * allowed bank carries the least committed traffic on the device, and the
+ * coefficient/descriptor arena to the least loaded bank after that.
+ * ddr_bank_<n> pins output n to a bank regardless of the policy. The input
+ * pool always stays on the session's bank. Traffic is modelled in bytes
+ * per second: an output buffer is written once, read once downstream and
+ * once more by each output cascading from it; the input is written once
+ * and read by every channel fed from it.
+ *
+ * Only banks the session can allocate on are used: listed ones it can not
+ * are dropped from "ddr_banks" with a warning, a ddr_bank_<n> naming one
+ * fails init. Device buffer outputs are handed downstream on the bank they
+ * were placed on and the plugin does not see who reads them, so both
+ * parameters must only name banks the consuming CUs are connected to.
+*****************************************************************************/
+typedef struct
+{
+  int               num_sessions;
+  int32_t           dev_index;
+  uint64_t          bytes_per_sec[DDR_MAX_BANKS];
+} BankLoadEntry;
+
+static BankLoadEntry   bank_load[BANK_LOAD_MAX_DEVICES];
+static pthread_mutex_t bank_load_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t bank_output_bytes(XmaScalerSession *session, int output_id)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  uint64_t bytes = 0;
+  int plane_id;
+
+  for (plane_id = 0; plane_id < get_num_video_planes(session->props.output[output_id].format); plane_id++)
+    bytes += get_plane_size(ctx->out_stride[output_id], ctx->out_height[output_id],
+                            session->props.output[output_id].format, plane_id, SCL_OUT_HEIGHT_ALIGN);
+  return bytes;
+}
+
+/* Buffer readers besides the kernel write: scaled outputs fed from it and aliases of it */
+static int bank_readers(MultiScalerContext *ctx, int src_id)
+{
+  int output_id, readers = 0;
+
+  for (output_id = 0; output_id < MIN(ctx->num_outs, MAX_OUTPUTS); output_id++) {
+    if (channel_scaled(ctx, output_id) && (ctx->src_out[output_id] == src_id))
+      readers++;
+    else if (ctx->out_alias[output_id] && (ctx->alias_of[output_id] == src_id))
+      readers++;
+  }
+  return readers;
+}
+
+/* Probes with a small allocation whether the session's CU can use 'bank' */
+static bool bank_reachable(XmaScalerSession *session, int32_t bank)
+{
+  XmaBufferObj bo_handle;
+  int32_t ret = XMA_ERROR;
+
+  if (bank == session->base.hw_session.bank_index)
+    return true;
+  bo_handle = xma_plg_buffer_alloc_ddr(session->base, SCL_DEV_REGION_ALIGN, true, bank, &ret);
+  if (ret != XMA_SUCCESS)
+    return false;
+  xma_plg_buffer_free(session->base, bo_handle);
+  return true;
+}
+
+static int32_t bank_least_loaded(const uint64_t *load, const uint64_t *cost, uint32_t allowed)
+{
+  int32_t bank, best = -1;
+
+  for (bank = 0; bank < DDR_MAX_BANKS; bank++) {
+    if (!(allowed & (1U << bank)))
+      continue;
+    if ((best < 0) || (load[bank] + cost[bank] < load[best] + cost[best]))
+      best = bank;
+  }
+  return best;
+}
+
+static int32_t bank_place(XmaScalerSession *session)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  int max_outputs = MIN(ctx->num_outs, MAX_OUTPUTS);
+  int32_t session_bank = session->base.hw_session.bank_index;
+  uint64_t fps_milli = capacity_fps_milli(session->props.input.framerate);
+  uint64_t load[DDR_MAX_BANKS] = {0};
+  uint64_t out_bytes[MAX_OUTPUTS], in_bytes;
+  uint32_t allowed = ctx->cfg->ddr_banks;
+  bool placed[MAX_OUTPUTS] = {false};
+  BankLoadEntry *entry = NULL;
+  int output_id, k, i;
+
+  if ((session_bank < 0) || (session_bank >= DDR_MAX_BANKS))
+    return XMA_SUCCESS;  /* untracked bank, keep everything on it */
+  allowed |= 1U << session_bank;
+  for (i = 0; i < DDR_MAX_BANKS; i++) {
+    if ((allowed & (1U << i)) && !bank_reachable(session, i)) {
+      xma_logmsg(XMA_WARNING_LOG, XMA_MULTISCALER, "ddr_banks: bank %d is not usable by this session, skipped", i);
+      allowed &= ~(1U << i);
+    }
+  }
+  for (output_id = 0; output_id < max_outputs; output_id++) {
+    if (ctx->cfg->bank_hint[output_id] >= DDR_MAX_BANKS) {
+      ERROR_PRINT ("ddr_bank_%d=%d is out of range (0 to %d)", output_id,
+                   ctx->cfg->bank_hint[output_id], DDR_MAX_BANKS - 1);
+      return XMA_ERROR;
+    }
+    if ((ctx->cfg->bank_hint[output_id] >= 0) && !(allowed & (1U << ctx->cfg->bank_hint[output_id])) &&
+        !bank_reachable(session, ctx->cfg->bank_hint[output_id])) {
+      ERROR_PRINT ("ddr_bank_%d=%d is not usable by this session", output_id, ctx->cfg->bank_hint[output_id]);
+      return XMA_ERROR;
+    }
+  }
+
+  memset(ctx->cfg->bank_cost, 0, sizeof(ctx->cfg->bank_cost));
+  in_bytes = (uint64_t)ctx->in_stride[0] * ALIGN(session->props.input.height, SCL_IN_HEIGHT_ALIGN) * 3 / 2;
+  ctx->cfg->bank_cost[session_bank] += (in_bytes * (1 + bank_readers(ctx, -1)) * fps_milli) / 1000;
+  for (output_id = 0; output_id < max_outputs; output_id++)
+    out_bytes[output_id] = ctx->out_alias[output_id] ? 0 :
+                           (bank_output_bytes(session, output_id) * (2 + bank_readers(ctx, output_id)) * fps_milli) / 1000;
+
+  pthread_mutex_lock(&bank_load_lock);
+  for (i = 0; i < BANK_LOAD_MAX_DEVICES; i++) {
+    if (bank_load[i].num_sessions && (bank_load[i].dev_index == session->base.hw_session.dev_index)) {
+      entry = &bank_load[i];
+      break;
+    }
+  }
+  for (i = 0; !entry && (i < BANK_LOAD_MAX_DEVICES); i++) {
+    if (!bank_load[i].num_sessions) {
+      entry = &bank_load[i];
+      memset(entry, 0, sizeof(*entry));
+      entry->dev_index = session->base.hw_session.dev_index;
+    }
+  }
+  if (entry)
+    memcpy(load, entry->bytes_per_sec, sizeof(load));
+
+  /* greedy, heaviest output first */
+  for (k = 0; k < max_outputs; k++) {
+    int heaviest = -1;
+    for (output_id = 0; output_id < max_outputs; output_id++) {
+      if (!placed[output_id] && ((heaviest < 0) || (out_bytes[output_id] > out_bytes[heaviest])))
+        heaviest = output_id;
+    }
+    placed[heaviest] = true;
+    if (ctx->cfg->bank_hint[heaviest] >= 0)
+      ctx->cfg->out_bank[heaviest] = ctx->cfg->bank_hint[heaviest];
+    else
+      ctx->cfg->out_bank[heaviest] = bank_least_loaded(load, ctx->cfg->bank_cost, allowed);
+    ctx->cfg->bank_cost[ctx->cfg->out_bank[heaviest]] += out_bytes[heaviest];
+  }
+  ctx->cfg->arena_bank = ctx->cfg->ddr_banks ? bank_least_loaded(load, ctx->cfg->bank_cost, allowed) : session_bank;
+
+  if (entry) {
+    for (i = 0; i < DDR_MAX_BANKS; i++)
+      entry->bytes_per_sec[i] += ctx->cfg->bank_cost[i];
+    entry->num_sessions++;
+    ctx->cfg->bank_load_slot = entry - bank_load;
+  } else {
+    xma_logmsg(XMA_WARNING_LOG, XMA_MULTISCALER, "Bank load table full, session traffic is not tracked");
+  }
+  pthread_mutex_unlock(&bank_load_lock);
+
+  for (output_id = 0; output_id < max_outputs; output_id++)
+    DEBUG_PRINT ("Output %d on bank %d, %lu MB/s", output_id, ctx->cfg->out_bank[output_id],
+                 out_bytes[output_id] >> 20);
+  DEBUG_PRINT ("Input on bank %d, arena on bank %d", session_bank, ctx->cfg->arena_bank);
+  return XMA_SUCCESS;
+}
+
+static void bank_release(XmaScalerSession *session)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  BankLoadEntry *entry;
+  int i;
+
+  if (ctx->cfg->bank_load_slot < 0)
+    return;
+  pthread_mutex_lock(&bank_load_lock);
+  entry = &bank_load[ctx->cfg->bank_load_slot];
+  for (i = 0; i < DDR_MAX_BANKS; i++)
+    entry->bytes_per_sec[i] -= ctx->cfg->bank_cost[i];
+  entry->num_sessions--;
+  pthread_mutex_unlock(&bank_load_lock);
+  ctx->cfg->bank_load_slot = -1;
+}
+
+/*****************************************************************************
+ * Output suspend / resume
+ * With "suspendable_outputs" single outputs can be taken out of the running
+ * ladder. The descriptor chain links only active outputs and every active
+ * output reads from the nearest active one above it (src_out), so the
+ * kernel never touches a suspended channel. Changes are applied between
+ * frames: inputs are rewired, filters regenerated and uploaded, descriptors
+ * rebuilt and the committed CU load updated.
+*****************************************************************************/
+static bool outputs_can_rewire(MultiScalerContext *ctx)
+{
+  int max_outputs = MIN(ctx->num_outs, MAX_OUTPUTS);
+  int output_id, src = -1;
+
+  for (output_id = 0; output_id < max_outputs; output_id++) {
+    if (ctx->out_suspended[output_id])
+      continue;
+    /* a crop rectangle is only meaningful on the output it was given for */
+    if ((src != output_id - 1) && (ctx->cfg->crop[output_id].width || ctx->cfg->crop[output_id].height)) {
+      ERROR_PRINT ("Output %d has its own crop and can not be fed from %s", output_id,
+                   src < 0 ? "the session input" : "another output");
+      return false;
+    }
+    src = output_id;
+  }
+  return src >= 0;
+}
+
+static int32_t outputs_rewire(XmaScalerSession *session)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  int max_outputs = MIN(ctx->num_outs, MAX_OUTPUTS);
+  int output_id, src = -1;
+  const XlnxCropRect *rect;
+
+  ctx->cfg->num_suspended = 0;
+  for (output_id = 0; output_id < max_outputs; output_id++) {
+    if (ctx->out_suspended[output_id]) {
+      ctx->cfg->num_suspended++;
+      continue;
+    }
+    if (src < 0)
+      ctx->first_out = output_id;
+
+    set_channel_input(session, output_id, src);
+    ctx->src_out[output_id] = src;
+    /* the session crop follows whichever output reads the input */
+    if (src == output_id - 1)
+      rect = &ctx->cfg->crop[output_id];
+    else
+      rect = src < 0 ? &ctx->cfg->session_crop : NULL;
+    if (rect && (apply_channel_crop(ctx, output_id, rect) != XMA_SUCCESS))
+      return XMA_ERROR;
+    set_channel_rates(ctx, output_id);
+    src = output_id;
+  }
+  return XMA_SUCCESS;
+}
+
+static int32_t outputs_alloc_pools(XmaScalerSession *session, int output_id)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  int plane_id;
+
+  for (plane_id = 0; plane_id < get_num_video_planes(session->props.output[output_id].format); plane_id++) {
+    ctx->out_phandle[output_id][plane_id] = create_output_pool(session, output_id, plane_id);
+    if (!ctx->out_phandle[output_id][plane_id]) {
+      ERROR_PRINT ("Output %d buffer pool create failed", output_id);
+      return XMA_ERROR;
+    }
+  }
+  return XMA_SUCCESS;
+}
+
+static void outputs_free_pools(XmaScalerSession *session, int output_id)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+
+  destroy_output_pools(session, output_id);
+  ctx->num_buffers_extended[output_id] = 0;
+  ctx->max_try[output_id] = 0;
+}
+
+/* Replaces the session's committed load; 'enforce' applies the admission policy */
+static int32_t outputs_readmit(XmaScalerSession *session, bool enforce)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  uint32_t admission = ctx->cfg->admission;
+  int32_t ret;
+
+  capacity_release(session);
+  if (!enforce)
+    ctx->cfg->admission = XLNX_ADMISSION_OFF;
+  ret = capacity_admit(session);
+  ctx->cfg->admission = admission;
+  return ret;
+}
+
+static int32_t outputs_reload(XmaScalerSession *session)
+{
+  int32_t ret;
+
+  ret = xlnx_multi_scaler_prepare_filter_tables(session);
+  if (ret != XMA_SUCCESS) {
+    ERROR_PRINT ("failed to prepare filter tables for the new ladder");
+    return ret;
+  }
+  upload_filter_coeffs(session);
+  return write_registers(session);
+}
+
+static int32_t outputs_check_call(XmaScalerSession *session, int32_t output_id)
+{
+  MultiScalerContext *ctx;
+
+  if (!session || !session->base.plugin_data)
+    return XMA_ERROR;
+  ctx = (MultiScalerContext*)session->base.plugin_data;
+  if (!ctx->suspendable_outputs || (output_id < 0) || (output_id >= MIN(ctx->num_outs, MAX_OUTPUTS)))
+    return XMA_ERROR;
+  /* descriptors and pools of a frame in flight must stay as they are */
+  if (ctx->recv_frame_cnt != ctx->sent_frame_cnt)
+    return XMA_TRY_AGAIN;
+  return XMA_SUCCESS;
+}
+
+extern "C" int32_t xlnx_multi_scaler_suspend_output(XmaScalerSession *session, int32_t output_id)
+{
+  MultiScalerContext *ctx;
+  int32_t ret;
+
+  ret = outputs_check_call(session, output_id);
+  if (ret != XMA_SUCCESS)
+    return ret;
+  ctx = (MultiScalerContext*)session->base.plugin_data;
+  if (ctx->out_suspended[output_id])
+    return XMA_SUCCESS;
+
+  ctx->out_suspended[output_id] = true;
+  if (!outputs_can_rewire(ctx)) {
+    ctx->out_suspended[output_id] = false;
+    ERROR_PRINT ("Output %d can not be suspended", output_id);
+    return XMA_ERROR;
+  }
+  ret = outputs_rewire(session);
+  if (ret == XMA_SUCCESS)
+    ret = outputs_reload(session);
+  if (ret != XMA_SUCCESS)
+    return ret;
+  outputs_free_pools(session, output_id);
+  outputs_readmit(session, false);
+
+  xma_logmsg(XMA_INFO_LOG, XMA_MULTISCALER, "Output %d suspended, %d of %d outputs active",
+             output_id, ctx->num_outs - ctx->cfg->num_suspended, ctx->num_outs);
+  return XMA_SUCCESS;
+}
+
+extern "C" int32_t xlnx_multi_scaler_resume_output(XmaScalerSession *session, int32_t output_id)
+{
+  MultiScalerContext *ctx;
+  int32_t ret;
+
+  ret = outputs_check_call(session, output_id);
+  if (ret != XMA_SUCCESS)
+    return ret;
+  ctx = (MultiScalerContext*)session->base.plugin_data;
+  if (!ctx->out_suspended[output_id])
+    return XMA_SUCCESS;
+
+  ctx->out_suspended[output_id] = false;
+  if (!outputs_can_rewire(ctx) || (outputs_alloc_pools(session, output_id) != XMA_SUCCESS)) {
+    outputs_free_pools(session, output_id);
+    ctx->out_suspended[output_id] = true;
+    ERROR_PRINT ("Output %d can not be resumed", output_id);
+    return XMA_ERROR;
+  }
+  ret = outputs_rewire(session);
+  if ((ret == XMA_SUCCESS) && (outputs_readmit(session, true) != XMA_SUCCESS)) {
+    /* refused by admission control, go back to the previous ladder */
+    ctx->out_suspended[output_id] = true;
+    outputs_rewire(session);
+    outputs_free_pools(session, output_id);
+    outputs_readmit(session, false);
+    return XMA_ERROR;
+  }
+  if (ret == XMA_SUCCESS)
+    ret = outputs_reload(session);
+  if (ret != XMA_SUCCESS)
+    return ret;
+
+  xma_logmsg(XMA_INFO_LOG, XMA_MULTISCALER, "Output %d resumed, %d of %d outputs active",
+             output_id, ctx->num_outs - ctx->cfg->num_suspended, ctx->num_outs);
+  return XMA_SUCCESS;
+}
+
+/*****************************************************************************
+ * Thumbnail outputs
+ * Outputs with "thumb_interval_<n>" or "thumb_idr_<n>" are linked into the
+ * descriptor chain, after the regular outputs, only on the frames they
+ * sample. Nothing reads from them, so leaving them out needs no rewiring.
+ * recv reads a sample back and tiles it into the host sprite sheet.
+*****************************************************************************/
+static inline bool thumb_idle(MultiScalerContext *ctx, int output_id, int idx)
+{
+  return ctx->thumb_out[output_id] && !(ctx->thumb_fire[idx] & (1 << output_id));
+}
+
+/* Limited range black, so tiles not yet written read as empty */
+static void thumb_clear(ThumbSprite *sprite)
+{
+  size_t luma = (sprite->size / 3) * 2;
+
+  memset(sprite->sheet[sprite->fill], 16, luma);
+  memset(sprite->sheet[sprite->fill] + luma, 128, sprite->size - luma);
+  sprite->fill_tiles = 0;
+}
+
+static void thumb_free_sheets(MultiScalerContext *ctx)
+{
+  int output_id, i;
+
+  for (output_id = 0; output_id < MAX_OUTPUTS; output_id++) {
+    ThumbSprite *sprite = &ctx->cfg->thumb_sprite[output_id];
+
+    if (sprite->dropped)
+      xma_logmsg(XMA_INFO_LOG, XMA_MULTISCALER, "Output %d: %lu sprite sheets dropped, not taken in time",
+                 output_id, sprite->dropped);
+    for (i = 0; i < 2; i++) {
+      free(sprite->sheet[i]);
+      free(sprite->pts[i]);
+      sprite->sheet[i] = NULL;
+      sprite->pts[i]   = NULL;
+    }
+    sprite->dropped = 0;
+  }
+}
+
+static int32_t thumb_alloc_sheets(XmaScalerSession *session)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  int max_outputs = MIN(ctx->num_outs, MAX_OUTPUTS);
+  int output_id, i;
+
+  for (output_id = 0; output_id < max_outputs; output_id++) {
+    ThumbSprite *sprite = &ctx->cfg->thumb_sprite[output_id];
+
+    if (!ctx->thumb_out[output_id])
+      continue;
+    sprite->size = ((size_t)sprite->cols * ctx->out_width[output_id] *
+                    sprite->rows * ctx->out_height[output_id] * 3) / 2;
+    for (i = 0; i < 2; i++) {
+      sprite->sheet[i] = (uint8_t *)malloc(sprite->size);
+      sprite->pts[i]   = (uint64_t *)calloc(sprite->cols * sprite->rows, sizeof(uint64_t));
+      if (!sprite->sheet[i] || !sprite->pts[i]) {
+        ERROR_PRINT("Output %d: sprite sheet of %zu bytes could not be allocated", output_id, sprite->size);
+        thumb_free_sheets(ctx);
+        return XMA_ERROR;
+      }
+    }
+    sprite->fill = 0;
+    sprite->done = false;
+    thumb_clear(sprite);
+    /* the first frame is always sampled */
+    ctx->thumb_since[output_id] = ctx->thumb_interval[output_id] ? ctx->thumb_interval[output_id] - 1 : 0;
+    xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "Output %d: thumbnail every %u frames%s, %ux%u tiles",
+               output_id, ctx->thumb_interval[output_id], ctx->thumb_idr[output_id] ? " and on IDR" : "",
+               sprite->cols, sprite->rows);
+  }
+  return XMA_SUCCESS;
+}
+
+/* Picks the thumbnails sampled from the frame at s_idx; counters move in thumb_link */
+static void thumb_select(MultiScalerContext *ctx)
+{
+  int max_outputs = MIN(ctx->num_outs, MAX_OUTPUTS);
+  uint8_t fire = 0;
+  int output_id;
+
+  for (output_id = 0; output_id < max_outputs; output_id++) {
+    if (!ctx->thumb_out[output_id])
+      continue;
+    if ((ctx->thumb_interval[output_id] && (ctx->thumb_since[output_id] + 1 >= ctx->thumb_interval[output_id])) ||
+        (ctx->thumb_idr[output_id] && ctx->is_idr[ctx->s_idx]))
+      fire |= 1 << output_id;
+  }
+  ctx->thumb_fire[ctx->s_idx] = fire;
+}
+
+/* Chains the regular outputs, then the sampled thumbnails, once the frame's buffers are in place */
+static void thumb_link(MultiScalerContext *ctx)
+{
+  int max_outputs = MIN(ctx->num_outs, MAX_OUTPUTS);
+  XV_MULTISCALER_DESCRIPTOR *desc = ctx->desc[ctx->pipe_idx];
+  int output_id, pass, prev_id = -1;
+  uint32_t num = 0;
+
+  for (output_id = 0; output_id < max_outputs; output_id++) {
+    if (ctx->thumb_out[output_id])
+      ctx->thumb_since[output_id] = thumb_idle(ctx, output_id, ctx->s_idx) ?
+                                    ctx->thumb_since[output_id] + 1 : 0;
+  }
+  for (pass = 0; pass < 2; pass++) {
+    for (output_id = 0; output_id < max_outputs; output_id++) {
+      if (!channel_scaled(ctx, output_id) || (ctx->thumb_out[output_id] != (pass == 1)) ||
+          thumb_idle(ctx, output_id, ctx->s_idx))
+        continue;
+      if (prev_id >= 0)
+        desc[prev_id].nxtaddr = ctx->desc_buffer[ctx->pipe_idx][output_id].paddr;
+      prev_id = output_id;
+      num++;
+    }
+  }
+  desc[prev_id].nxtaddr = 0;
+  memcpy((ctx->hw_reg[ctx->pipe_idx] + XV_MULTI_SCALER_CTRL_ADDR_NUM_OUTS_DATA), &num, sizeof(num));
+}
+
+/* Reads a sample back and writes it into the next tile of the sheet being filled */
+static int32_t thumb_store(MultiScalerContext *ctx, int output_id, XvbmBufferHandle b_handle, uint64_t pts)
+{
+  ThumbSprite *sprite = &ctx->cfg->thumb_sprite[output_id];
+  uint32_t tile_w = ctx->out_width[output_id];
+  uint32_t tile_h = ctx->out_height[output_id];
+  uint32_t stride = ctx->out_stride[output_id];
+  uint32_t hgt    = ctx->out_hgt_align[output_id];
+  size_t   pitch  = (size_t)sprite->cols * tile_w;
+  size_t   x      = (sprite->fill_tiles % sprite->cols) * tile_w;
+  size_t   y      = (sprite->fill_tiles / sprite->cols) * tile_h;
+  uint8_t *luma   = sprite->sheet[sprite->fill];
+  uint8_t *chroma = luma + pitch * sprite->rows * tile_h;
+  uint8_t *hbuf;
+  uint32_t h;
+
+  hbuf = b_handle ? (uint8_t *)xvbm_buffer_get_host_ptr(b_handle) : NULL;
+  if (!hbuf) {
+    ERROR_PRINT ("Output %d: no buffer for the sampled thumbnail", output_id);
+    return XMA_ERROR;
+  }
+  if (xvbm_buffer_read(b_handle, hbuf, (stride * hgt * 3) / 2, 0)) {
+    ERROR_PRINT ("host buffer read failed\n");
+    return XMA_ERROR;
+  }
+  for (h = 0; h < tile_h; h++)
+    memcpy(luma + (y + h) * pitch + x, hbuf + (size_t)h * stride, tile_w);
+  for (h = 0; h < tile_h / 2; h++)
+    memcpy(chroma + (y / 2 + h) * pitch + x, hbuf + (size_t)(hgt + h) * stride, tile_w);
+  sprite->pts[sprite->fill][sprite->fill_tiles++] = pts;
+
+  if (sprite->fill_tiles == sprite->cols * sprite->rows) {
+    /* the complete sheet waits in place, an untaken older one is overwritten */
+    if (sprite->done)
+      sprite->dropped++;
+    sprite->done = true;
+    sprite->fill ^= 1;
+    thumb_clear(sprite);
+  }
+  return XMA_SUCCESS;
+}
+
+static ThumbSprite *thumb_sprite_of(XmaScalerSession *session, int32_t output_id)
+{
+  MultiScalerContext *ctx;
+
+  if (!session || !session->base.plugin_data)
+    return NULL;
+  ctx = (MultiScalerContext*)session->base.plugin_data;
+  if ((output_id < 0) || (output_id >= MIN(ctx->num_outs, MAX_OUTPUTS)) || !ctx->thumb_out[output_id])
+    return NULL;
+  return &ctx->cfg->thumb_sprite[output_id];
+}
+
+extern "C" int32_t xlnx_multi_scaler_get_sprite_layout(XmaScalerSession *session, int32_t output_id,
+                                                       XlnxSpriteLayout *layout)
+{
+  ThumbSprite *sprite = thumb_sprite_of(session, output_id);
+  MultiScalerContext *ctx;
+
+  if (!sprite || !layout)
+    return XMA_ERROR;
+  ctx = (MultiScalerContext*)session->base.plugin_data;
+  layout->tile_width  = ctx->out_width[output_id];
+  layout->tile_height = ctx->out_height[output_id];
+  layout->cols        = sprite->cols;
+  layout->rows        = sprite->rows;
+  layout->width       = sprite->cols * layout->tile_width;
+  layout->height      = sprite->rows * layout->tile_height;
+  layout->size        = sprite->size;
+  return XMA_SUCCESS;
+}
+
+extern "C" int32_t xlnx_multi_scaler_take_sprite(XmaScalerSession *session, int32_t output_id, uint8_t *dst,
+                                                 uint64_t *pts, uint32_t *num_tiles, int32_t partial)
+{
+  ThumbSprite *sprite = thumb_sprite_of(session, output_id);
+  uint32_t tiles;
+  int idx;
+
+  if (!sprite || !dst)
+    return XMA_ERROR;
+  if (sprite->done) {
+    idx   = sprite->fill ^ 1;
+    tiles = sprite->cols * sprite->rows;
+    sprite->done = false;
+  } else if (partial && sprite->fill_tiles) {
+    idx   = sprite->fill;
+    tiles = sprite->fill_tiles;
+  } else {
+    return XMA_TRY_AGAIN;
+  }
+  memcpy(dst, sprite->sheet[idx], sprite->size);
+  if (pts)
+    memcpy(pts, sprite->pts[idx], tiles * sizeof(uint64_t));
+  if (num_tiles)
+    *num_tiles = tiles;
+  if (idx == sprite->fill)
+    thumb_clear(sprite);
+  return XMA_SUCCESS;
+}
+
+/*****************************************************************************
+ * Luma statistics
+ * With "luma_stats" recv measures the luma plane of one small output:
+ * histogram, mean, variance and the SAD against the previous frame, kept
+ * for xlnx_multi_scaler_get_luma_stats() until the next recv. Repeated
+ * frames of dedup_frames are not measured again.
+*****************************************************************************/
+static int32_t stats_update(MultiScalerContext *ctx, int output_id, XvbmBufferHandle b_handle,
+                            uint32_t stride, bool need_read)
+{
+  XlnxLumaStats *st = &ctx->stats;
+  uint32_t width  = ctx->out_width[output_id];
+  uint32_t height = ctx->out_height[output_id];
+  const uint8_t *luma = (const uint8_t *)xvbm_buffer_get_host_ptr(b_handle);
+  uint64_t sum = 0, sum_sq = 0, sad = 0;
+  double mean;
+  uint32_t x, y;
+
+  if (!luma) {
+    ERROR_PRINT ("Invalid host buffer\n");
+    return XMA_ERROR;
+  }
+  /* only the luma plane is needed from device outputs */
+  if (need_read && xvbm_buffer_read(b_handle, (void *)luma, stride * height, 0)) {
+    ERROR_PRINT ("host buffer read failed\n");
+    return XMA_ERROR;
+  }
+
+  memset(st->hist, 0, sizeof(st->hist));
+  for (y = 0; y < height; y++) {
+    const uint8_t *row = luma + (size_t)y * stride;
+    uint8_t *prev = ctx->stats_prev + (size_t)y * width;
+    uint32_t row_sum = 0, row_sq = 0, row_sad = 0;
+
+    /* 32-bit row sums hold up to MAX_WIDTH pixels */
+    for (x = 0; x < width; x++) {
+      uint32_t v = row[x];
+      st->hist[v]++;
+      row_sum += v;
+      row_sq  += v * v;
+      row_sad += v > prev[x] ? v - prev[x] : prev[x] - v;
+    }
+    sum    += row_sum;
+    sum_sq += row_sq;
+    sad    += row_sad;
+    memcpy(prev, row, width);
+  }
+
+  mean = (double)sum / ((double)width * height);
+  st->pts       = ctx->pts[ctx->r_idx];
+  st->output_id = output_id;
+  st->width     = width;
+  st->height    = height;
+  st->mean      = (float)mean;
+  st->variance  = (float)((double)sum_sq / ((double)width * height) - mean * mean);
+  st->sad       = st->has_prev ? sad : 0;
+  st->has_prev  = 1;
+  ctx->stats_valid = true;
+  return XMA_SUCCESS;
+}
+
+extern "C" int32_t xlnx_multi_scaler_get_luma_stats(XmaScalerSession *session, XlnxLumaStats *stats)
+{
+  MultiScalerContext *ctx;
+
+  if (!session || !session->base.plugin_data || !stats)
+    return XMA_ERROR;
+  ctx = (MultiScalerContext*)session->base.plugin_data;
+  if (!ctx->luma_stats)
+    return XMA_ERROR;
+  if (!ctx->stats_valid)
+    return XMA_TRY_AGAIN;
+  *stats = ctx->stats;
+  return XMA_SUCCESS;
+}
+
+static int32_t split_sync_init(MultiScalerContext *ctx);
+
+static int32_t
+multi_scaler_init_session(XmaScalerSession *session)
+{
+  openlog ("XMA_Scaler", LOG_PID, LOG_USER);
+  assert(session != NULL);
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  int output_id = 0;
+  int max_outputs;
+  //XmaParameter* param;
+  int32_t xma_ret = XMA_SUCCESS;
+
+  ctx->enable_pipeline  = -1;
+  ctx->shared_cu_group  = -1;
+  ctx->shared_batch     = NULL;
+  ctx->shared_stale     = NULL;
+  ctx->cfg->cu_load_slot     = -1;
+  ctx->cfg->bank_load_slot   = -1;
+  syslog(LOG_DEBUG, "xma_scaler_handle = %p\n", ctx);
+  clock_gettime (CLOCK_REALTIME, &ctx->latency);
+  ctx->time_taken = (ctx->latency.tv_sec * 1e3) + (ctx->latency.tv_nsec / 1e6);
+  syslog(LOG_DEBUG, "%s : %p :  xma_start at %lld \n", __func__, ctx, ctx->time_taken);
+
+#ifdef DUMP_INPUT_FRAMES
+  infp = fopen ("xma_inframes.yuv", "w+");
+#endif
+
+  //extract user extended property params
+  get_user_params(session);
+  xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "MultiScaler Pipeline Mode: %s", ((ctx->enable_pipeline == 1)  ? "Enabled" : ((ctx->enable_pipeline == 0) ? "Disabled" : "Automatic")));
+  if (ctx->cfg->shared_pools)
+    xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "MultiScaler Shared Pool Mode: Enabled");
+
+  /* everything on the session bank until placement runs */
+  ctx->cfg->arena_bank = session->base.hw_session.bank_index;
+  for (output_id = 0; output_id < MAX_OUTPUTS; output_id++)
+    ctx->cfg->out_bank[output_id] = ctx->cfg->bank_hint[output_id] >= 0 ? ctx->cfg->bank_hint[output_id] :
+                                                                session->base.hw_session.bank_index;
+
+  ctx->num_outs = session->props.num_outputs;
+  max_outputs = MIN(ctx->num_outs, MAX_OUTPUTS);
+  ctx->current_pipe = 0;
+  ctx->first_frame = 0;
+  ctx->recv_frame_cnt = 0;
+  ctx->sent_frame_cnt = 0;
+  ctx->s_idx = 0;
+  ctx->r_idx = 0;
+  ctx->pipe_idx = 0;
+
+  if (ctx->num_outs > MAX_OUTPUTS) {
+     ERROR_PRINT("Number of outputs programmed %d, exceeds Maximum supported outputs %d.", ctx->num_outs, MAX_OUTPUTS);
+     return XMA_ERROR;
+  }
+  else if (ctx->num_outs <= 0) {
+     ERROR_PRINT("Number of outputs programmed %d, is incorrect. Need to mention atleast 1 to get a scaler output.", ctx->num_outs, MAX_OUTPUTS);
+     return XMA_ERROR;
+  }
+
+  if (ctx->host_p010 && (session->props.input.format != XMA_VCU_NV12_10LE32_FMT_TYPE)) {
+     ERROR_PRINT("p010_input requires input format XMA_VCU_NV12_10LE32_FMT_TYPE (got %d).", session->props.input.format);
+     return XMA_ERROR;
+  }
+
+  if (ctx->host_unpack > XLNX_HOST_OUT_NV12_DITHER) {
+     ERROR_PRINT("unpack_10bit_output=%u is invalid. Use 0 (10LE32), 1 (P010) or 2 (NV12 dithered).", ctx->host_unpack);
+     return XMA_ERROR;
+  }
+
+  for (int output_id = 0; output_id < max_outputs; output_id++) {
+     if (ctx->tensor_out[output_id] && (session->props.output[output_id].format != XMA_VCU_NV12_FMT_TYPE)) {
+       ERROR_PRINT("tensor_%d needs an 8-bit NV12 output, output %d has format %d.",
+                   output_id, output_id, session->props.output[output_id].format);
+       return XMA_ERROR;
+     }
+  }
+
+  if (!ctx->batch_frames)
+     ctx->batch_frames = 1;
+  if ((ctx->batch_frames > MAX_BATCH_FRAMES) || ((ctx->batch_frames * ctx->num_outs) > MAX_OUTPUTS)) {
+     ERROR_PRINT("batch_frames=%u with %d outputs is not supported. Batched descriptors (frames x outputs) are limited to %d, frames to %d.",
+                 ctx->batch_frames, ctx->num_outs, MAX_OUTPUTS, MAX_BATCH_FRAMES);
+     return XMA_ERROR;
+  }
+  if (ctx->batch_frames > 1) {
+     /* batches are double buffered across the descriptor pipes already */
+     ctx->enable_pipeline = 0;
+     xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "MultiScaler Batch Mode: %u frames per kernel start", ctx->batch_frames);
+  }
+  if (ctx->split_threads) {
+     if ((ctx->batch_frames > 1) || ctx->shared_cu || ctx->low_latency) {
+       ERROR_PRINT("split_threads can not be combined with batch_frames, shared_cu or low_latency.");
+       return XMA_ERROR;
+     }
+     /* recv must not touch pipe_idx, so no pipelined fallback */
+     ctx->enable_pipeline = 0;
+     ctx->ring_head = 0;
+     ctx->ring_tail = 0;
+     ctx->split_eos = 0;
+     if (split_sync_init(ctx) != XMA_SUCCESS)
+       return XMA_ERROR;
+     xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "MultiScaler Split Thread Mode: Enabled");
+  }
+  if (ctx->dedup_frames) {
+     if ((ctx->batch_frames > 1) || ctx->shared_cu || ctx->split_threads) {
+       ERROR_PRINT("dedup_frames can not be combined with batch_frames, shared_cu or split_threads.");
+       return XMA_ERROR;
+     }
+     /* a repeat is only known once the previous frame has been received */
+     ctx->enable_pipeline = 0;
+     xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "MultiScaler Duplicate Frame Detection: Enabled, hashing %s rows",
+                ctx->dedup_sample_rows ? "sampled" : "all");
+  }
+  if (ctx->suspendable_outputs) {
+     if ((ctx->batch_frames > 1) || ctx->shared_cu || ctx->split_threads || ctx->dedup_frames) {
+       ERROR_PRINT("suspendable_outputs can not be combined with batch_frames, shared_cu, split_threads or dedup_frames.");
+       return XMA_ERROR;
+     }
+     /* the ladder is only changed with no frame in flight */
+     ctx->enable_pipeline = 0;
+  }
+  if (ctx->slice_rows) {
+     if ((ctx->batch_frames > 1) || ctx->shared_cu || ctx->split_threads || ctx->dedup_frames ||
+         ctx->suspendable_outputs || ctx->low_latency) {
+       ERROR_PRINT("slice_rows can not be combined with batch_frames, shared_cu, split_threads, dedup_frames, suspendable_outputs or low_latency.");
+       return XMA_ERROR;
+     }
+     if ((ctx->num_outs * 2) > MAX_OUTPUTS) {
+       ERROR_PRINT("slice_rows supports up to %d outputs, each band output takes a second descriptor to copy it out.",
+                   MAX_OUTPUTS / 2);
+       return XMA_ERROR;
+     }
+     for (int output_id = 0; output_id < max_outputs; output_id++) {
+       if ((session->props.output[output_id].format != XMA_VCU_NV12_FMT_TYPE) &&
+           (session->props.output[output_id].format != XMA_VCU_NV12_10LE32_FMT_TYPE)) {
+         ERROR_PRINT("slice_rows needs NV12 or NV12 10LE32 outputs, output %d has format %d.",
+                     output_id, session->props.output[output_id].format);
+         return XMA_ERROR;
+       }
+     }
+     /* bands alternate between the descriptor pipes and are waited on in send */
+     ctx->enable_pipeline = 0;
+     ctx->slice_open = false;
+     ctx->slice_first_rows = -1;
+     ctx->slice_pipe = 0;
+     xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "MultiScaler Slice Mode: bands of at least %u input rows", ctx->slice_rows);
+  }
+  if (ctx->field_mode) {
+     if ((ctx->batch_frames > 1) || ctx->shared_cu || ctx->slice_rows || ctx->suspendable_outputs) {
+       ERROR_PRINT("field_mode can not be combined with batch_frames, shared_cu, slice_rows or suspendable_outputs.");
+       return XMA_ERROR;
+     }
+     if ((ctx->num_outs * 2) > MAX_OUTPUTS) {
+       ERROR_PRINT("field_mode supports up to %d outputs, each field takes a descriptor.", MAX_OUTPUTS / 2);
+       return XMA_ERROR;
+     }
+     /* each field is a 4:2:0 picture of half the height */
+     if (session->props.input.height % 4) {
+       ERROR_PRINT("field_mode needs an input height that is a multiple of 4, got %d.",
+                   session->props.input.height);
+       return XMA_ERROR;
+     }
+     for (int output_id = 0; output_id < max_outputs; output_id++) {
+       if (session->props.output[output_id].height % 4) {
+         ERROR_PRINT("field_mode needs output heights that are a multiple of 4, output %d is %d.",
+                     output_id, session->props.output[output_id].height);
+         return XMA_ERROR;
+       }
+       if ((session->props.output[output_id].format != XMA_VCU_NV12_FMT_TYPE) &&
+           (session->props.output[output_id].format != XMA_VCU_NV12_10LE32_FMT_TYPE)) {
+         ERROR_PRINT("field_mode needs NV12 or NV12 10LE32 outputs, output %d has format %d.",
+                     output_id, session->props.output[output_id].format);
+         return XMA_ERROR;
+       }
+     }
+     xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "MultiScaler Field Mode: Enabled");
+  }
+  ctx->num_fields = ctx->field_mode ? 2 : 1;
+  ctx->num_thumbs = 0;
+  for (int output_id = 0; output_id < max_outputs; output_id++) {
+     if (!ctx->thumb_out[output_id])
+       continue;
+     if (session->props.output[output_id].format != XMA_VCU_NV12_FMT_TYPE) {
+       ERROR_PRINT("Thumbnail output %d needs 8-bit NV12, it has format %d.",
+                   output_id, session->props.output[output_id].format);
+       return XMA_ERROR;
+     }
+     ctx->num_thumbs++;
+  }
+  if (ctx->num_thumbs) {
+     if ((ctx->batch_frames > 1) || ctx->shared_cu || ctx->dedup_frames || ctx->suspendable_outputs ||
+         ctx->slice_rows || ctx->field_mode) {
+       ERROR_PRINT("Thumbnail outputs can not be combined with batch_frames, shared_cu, dedup_frames, suspendable_outputs, slice_rows or field_mode.");
+       return XMA_ERROR;
+     }
+     if (ctx->num_thumbs == (uint32_t)max_outputs) {
+       ERROR_PRINT("Thumbnail outputs need at least one regular output in the session.");
+       return XMA_ERROR;
+     }
+     xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "MultiScaler Thumbnail Outputs: %u", ctx->num_thumbs);
+  }
+  if (ctx->luma_stats) {
+     if (ctx->suspendable_outputs) {
+       /* a suspended output has no frame to measure */
+       ERROR_PRINT("luma_stats can not be combined with suspendable_outputs.");
+       return XMA_ERROR;
+     }
+     if (ctx->stats_out < 0) {
+       uint32_t area = 0;
+       for (int output_id = 0; output_id < max_outputs; output_id++) {
+         uint32_t a = session->props.output[output_id].width * session->props.output[output_id].height;
+         if (ctx->thumb_out[output_id] || (session->props.output[output_id].format != XMA_VCU_NV12_FMT_TYPE))
+           continue;
+         if ((ctx->stats_out < 0) || (a < area)) {
+           ctx->stats_out = output_id;
+           area = a;
+         }
+       }
+     }
+     if ((ctx->stats_out < 0) || (ctx->stats_out >= max_outputs) || ctx->thumb_out[ctx->stats_out] ||
+         (session->props.output[ctx->stats_out].format != XMA_VCU_NV12_FMT_TYPE)) {
+       ERROR_PRINT("luma_stats needs an 8-bit NV12 output that is not a thumbnail (luma_stats_output=%d).",
+                   ctx->stats_out);
+       return XMA_ERROR;
+     }
+     xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "MultiScaler Luma Statistics: output %d", ctx->stats_out);
+  } else {
+     ctx->stats_out = -1;
+  }
+  if (ctx->cfg->alias_outputs &&
+      ((ctx->batch_frames > 1) || ctx->shared_cu || ctx->dedup_frames || ctx->suspendable_outputs ||
+       ctx->slice_rows || ctx->field_mode || ctx->num_thumbs)) {
+     /* these modes assume one descriptor and buffer per output */
+     ctx->cfg->alias_outputs = 0;
+     xma_logmsg(XMA_WARNING_LOG, XMA_MULTISCALER,
+                "alias_outputs can not be combined with batch_frames, shared_cu, dedup_frames, suspendable_outputs, slice_rows, field_mode or thumbnail outputs, ignored.");
+  }
+  if (ctx->low_latency) {
+     if ((ctx->batch_frames > 1) || ctx->shared_cu) {
+       ERROR_PRINT("low_latency can not be combined with batch_frames or shared_cu.");
+       return XMA_ERROR;
+     }
+     /* stays off, host frames no longer switch pipelining on */
+     ctx->enable_pipeline = 0;
+     ctx->ll_kernel_us = 0;
+     ctx->ll_count = 0;
+     ctx->ll_sum_us = 0;
+     ctx->ll_max_us = 0;
+     xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "MultiScaler Low Latency Mode: Enabled");
+  }
+  if (ctx->shared_cu) {
+     if (ctx->batch_frames > 1) {
+       ERROR_PRINT("shared_cu and batch_frames can not be combined.");
+       return XMA_ERROR;
+     }
+     /* kernel starts are issued from recv, one frame in flight per session */
+     ctx->enable_pipeline = 0;
+  }
+  ctx->batch_fill    = 0;
+  ctx->batch_pending = 0;
+  ctx->batch_avail   = 0;
+  ctx->batch_primed  = false;
+
+  if ((session->props.input.width % MULTISCALER_PPC) > 0) {
+     ERROR_PRINT("in_width=%d is not supported as it is not a multiple of %d.\n",session->props.input.width,MULTISCALER_PPC );
+     return XMA_ERROR;
+  }
+
+  if ((session->props.input.height % MULTISCALER_PPC) > 0) {
+     ERROR_PRINT("in_height=%d is not supported as it is not a multiple of %d.\n",session->props.input.height,MULTISCALER_PPC );
+     return XMA_ERROR;
+  }
+
+  memset(ctx->crop_offset, 0, sizeof(ctx->crop_offset));
+
+  /* crop_0 is relative to the session crop */
+  if (ctx->cfg->session_crop.width || ctx->cfg->session_crop.height) {
+    if (ctx->cfg->crop[0].width || ctx->cfg->crop[0].height) {
+      ctx->cfg->crop[0].x += ctx->cfg->session_crop.x;
+      ctx->cfg->crop[0].y += ctx->cfg->session_crop.y;
+    } else {
+      ctx->cfg->crop[0] = ctx->cfg->session_crop;
+    }
+  }
+
+  for (output_id=0; output_id < max_outputs; output_id++) {
+    /* channel 0 reads the session input, the others the previous output
+     * or, when that one is an alias, the buffer it is served from */
+    int src_id = output_id - 1;
+    if ((src_id >= 0) && ctx->out_alias[src_id])
+      src_id = ctx->alias_of[src_id];
+    /* separate field outputs are not woven, read what they were scaled from */
+    while (ctx->field_mode && (src_id >= 0) && ctx->separate_fields[src_id]) {
+      if (ctx->cfg->crop[output_id].width || ctx->cfg->crop[output_id].height) {
+        ERROR_PRINT("Output %d has its own crop and can not follow separate field output %d",
+                    output_id, src_id);
+        return XMA_ERROR;
+      }
+      src_id = ctx->src_out[src_id];
+    }
+    /* thumbnail outputs are not scaled every frame either */
+    while ((src_id >= 0) && ctx->thumb_out[src_id]) {
+      if (ctx->cfg->crop[output_id].width || ctx->cfg->crop[output_id].height) {
+        ERROR_PRINT("Output %d has its own crop and can not follow thumbnail output %d",
+                    output_id, src_id);
+        return XMA_ERROR;
+      }
+      src_id = ctx->src_out[src_id];
+    }
+    set_channel_input(session, output_id, src_id);
+    ctx->src_out[output_id] = src_id;
+
+    if (apply_channel_crop(ctx, output_id, &ctx->cfg->crop[output_id]) != XMA_SUCCESS)
+      return XMA_ERROR;
+
+    ctx->out_height[output_id] = session->props.output[output_id].height;
+    ctx->out_width[output_id]  = session->props.output[output_id].width;
+    ctx->out_format[output_id] = get_multiscaler_ip_format(session->props.output[output_id].format);
+    if (ctx->out_format[output_id] == XV_MULTI_SCALER_Y_UV10_420)
+    {
+      ctx->out_stride[output_id] = MULTISCALER_ALIGN(((ctx->out_width[output_id] + 2) / 3) * 4, SCL_OUT_WIDTH_ALIGN);
+    }
+    else
+    {
+      ctx->out_stride[output_id] = MULTISCALER_ALIGN(ctx->out_width[output_id] , SCL_OUT_WIDTH_ALIGN);
+    }
+
+    ctx->out_hgt_align[output_id] = MULTISCALER_ALIGN(ctx->out_height[output_id], SCL_OUT_HEIGHT_ALIGN);
+
+    //check if resolution is within the limits (landscape or portrait mode)
+    if ((ctx->in_width[output_id]<=0)   || (ctx->in_width[output_id]>MAX_WIDTH)   ||
+        (ctx->in_height[output_id]<=0)  || (ctx->in_height[output_id]>MAX_WIDTH)  ||
+        (ctx->out_width[output_id]<=0)  || (ctx->out_width[output_id]>MAX_WIDTH)  ||
+        (ctx->out_height[output_id]<=0) || (ctx->out_height[output_id]>MAX_WIDTH) ||
+        ((ctx->in_width[output_id]  * ctx->in_height[output_id])  > MAX_PIXELS)   ||
+        ((ctx->out_width[output_id] * ctx->out_height[output_id]) > MAX_PIXELS)) {
+         ERROR_PRINT("Output %d (%dx%d to %dx%d): Maximum supported "
+             "resolution is %4dx%4d (%4dx%4d) and Minimum is 256x144.\n",
+             output_id,ctx->in_width[output_id],ctx->in_height[output_id],ctx->out_width[output_id],
+             ctx->out_height[output_id],MAX_WIDTH,MAX_HEIGHT,MAX_HEIGHT,MAX_WIDTH);
+         return XMA_ERROR;
+    }
+
+    if ((ctx->out_width[output_id] % MULTISCALER_PPC) > 0) {
+        ERROR_PRINT("out_%d_width=%d is not supported as it is not a multiple of %d.\n",output_id+1, ctx->out_width[output_id],MULTISCALER_PPC );
+        return XMA_ERROR;
+    }
+
+    if ((ctx->out_height[output_id] % MULTISCALER_PPC) > 0) {
+        ERROR_PRINT("out_%d_height=%d is not supported as it is not a multiple of %d.\n",output_id+1, ctx->out_height[output_id],MULTISCALER_PPC );
+        return XMA_ERROR;
+    }
+
+    set_channel_rates(ctx, output_id);
+    if (ctx->cfg->alias_outputs)
+      find_output_alias(session, output_id);
+  }
+  resolve_output_aliases(session);
+  if (ctx->luma_stats && ctx->out_alias[ctx->stats_out]) {
+    /* the measurement runs on the output's own scaled buffer */
+    ERROR_PRINT("luma_stats output %d is an alias of %d, measure that one or disable alias_outputs.",
+                ctx->stats_out, ctx->alias_of[ctx->stats_out]);
+    return XMA_ERROR;
+  }
+
+  for (output_id = 0; output_id < max_outputs; output_id++) {
+      xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "----------- Channel [%d] Params START -----------", output_id);
+      xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "Input : width = %u, height = %u, multiscale_fmt = %d (xma_fmt = %d), stride = %d",
+          ctx->in_width[output_id], ctx->in_height[output_id], ctx->in_format[output_id],
+          output_id == 0 ? session->props.input.format : session->props.output[output_id-1].format,
+          ctx->in_stride[output_id]);
+      xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "Output : width = %u, height = %u, multiscale_fmt = %d (xma_fmt = %d), stride = %d",
+          ctx->out_width[output_id], ctx->out_height[output_id], ctx->out_format[output_id], session->props.output[output_id].format, ctx->out_stride[output_id]);
+      xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "Channel pixel_rate = %d, linerate = %d", ctx->cfg->pixel_rate[output_id], ctx->cfg->line_rate[output_id]);
+      xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "----------- Channel [%d] Params END -----------", output_id);
+  }
+
+  if (ctx->num_thumbs && (thumb_alloc_sheets(session) != XMA_SUCCESS))
+    return XMA_ERROR;
+  if (ctx->luma_stats) {
+    ctx->stats_valid = false;
+    ctx->stats_prev  = (uint8_t *)malloc((size_t)ctx->out_width[ctx->stats_out] * ctx->out_height[ctx->stats_out]);
+    if (!ctx->stats_prev) {
+      ERROR_PRINT("luma statistics buffer allocation failed");
+      thumb_free_sheets(ctx);
+      return XMA_ERROR;
+    }
+  }
+
+  xma_ret = capacity_admit(session);
+  if (xma_ret != XMA_SUCCESS) {
+    thumb_free_sheets(ctx);
+    free(ctx->stats_prev);
+    ctx->stats_prev = NULL;
+    return xma_ret;
+  }
+
+  if (!warm_pool_adopt(session)) {
+    /* prepare filter coefficients */
+    xma_ret = xlnx_multi_scaler_prepare_filter_tables (session);
+    if (xma_ret != XMA_SUCCESS) {
+      ERROR_PRINT ("failed to prepare filter tables...");
+      free_filter_coeffs(ctx);
+      capacity_release(session);
+      return xma_ret;
+    }
+
+    xma_ret = bank_place(session);
+    if (xma_ret != XMA_SUCCESS) {
+      free_filter_coeffs(ctx);
+      capacity_release(session);
+      return xma_ret;
+    }
+
+    /* Allocate buffers for input and output channels */
+    xma_ret = multi_scaler_allocate_buffers (session);
+    if (xma_ret != XMA_SUCCESS) {
+      ERROR_PRINT ("failed to allocate buffers...");
+      free_filter_coeffs(ctx);
+      bank_release(session);
+      capacity_release(session);
+      return xma_ret;
+    }
+
+    upload_filter_coeffs(session);
+  }
+
+  /* write to context info to registers */
+  xma_ret = write_registers(session);
+  if (xma_ret != XMA_SUCCESS) {
+    ERROR_PRINT ("failed to write registers...");
+    bank_release(session);
+    capacity_release(session);
+    return xma_ret;
+  }
+  ctx->current_pipe = 0;
+#ifdef MEASURE_TIME
+  ctx->send_count = 0;
+  ctx->recv_count = 0;
+  ctx->send_func_time = 0;
+  ctx->recv_func_time = 0;
+  ctx->send_xrt_time = 0;
+  ctx->recv_xrt_time = 0;
+#endif
+  ctx->pool_extended = false;
+
+  if (ctx->shared_cu) {
+    xma_ret = shared_cu_join(session);
+    if (xma_ret != XMA_SUCCESS) {
+      bank_release(session);
+      capacity_release(session);
+      return xma_ret;
+    }
+  }
+
+  ctx->frame_sent = 0;
+  ctx->frame_recv = 0;
+  clock_gettime (CLOCK_REALTIME, &ctx->latency);
+  ctx->time_taken = (ctx->latency.tv_sec * 1e3) + (ctx->latency.tv_nsec / 1e6);
+  syslog(LOG_DEBUG, "%s : %p :  xma_end at %lld \n", __func__, ctx, ctx->time_taken);
+
+  return XMA_SUCCESS;
+}
+
+static int32_t
+xlnx_multi_scaler_init(XmaScalerSession *session)
+{
+  assert(session != NULL);
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  int32_t xma_ret;
+
+  /* the XMA allocated context keeps only what send and recv touch */
+  ctx->cfg = (MultiScalerConfig *)calloc(1, sizeof(MultiScalerConfig));
+  if (!ctx->cfg) {
+    ERROR_PRINT("session configuration allocation failed");
+    return XMA_ERROR;
+  }
+  xma_ret = multi_scaler_init_session(session);
+  if (xma_ret != XMA_SUCCESS) {
+    free_filter_coeffs(ctx);
+    free(ctx->cfg);
+    ctx->cfg = NULL;
+  }
+  return xma_ret;
+}
+
+static int get_raw_host_frame(MultiScalerContext *ctx, XmaFrame *frame)
+{
+  ctx->in_bhandle[ctx->s_idx] = xvbm_buffer_pool_entry_alloc (ctx->in_phandle);
+  if(!ctx->in_bhandle[ctx->s_idx]) {
+      xma_logmsg(XMA_ERROR_LOG, XMA_MULTISCALER, "Error: (%s) Buffer Pool full - no free buffer available\n", __func__);
+      return XMA_ERROR;
+  }
+  uint8_t* src_buffer;
+  uint8_t* device_buffer      = (uint8_t *)xvbm_buffer_get_host_ptr(ctx->in_bhandle[ctx->s_idx]);
+  uint16_t src_bytes_in_line  = frame->frame_props.linesize[0];
+  uint16_t dev_bytes_in_line  = ALIGN(src_bytes_in_line, SCL_IN_WIDTH_ALIGN);
+  uint16_t src_height         = frame->frame_props.height;
+  uint16_t dev_height         = ALIGN(src_height, SCL_IN_HEIGHT_ALIGN);
+
+  uint16_t dev_rows_in_plane = dev_height;
+  uint16_t src_rows_in_plane = src_height;
+  size_t dev_index = 0;
+
+  size_t dev_y_size           = dev_bytes_in_line * dev_height;
+  int ret                     = 0;
+  if (ctx->host_p010) {
+      /* P010/P016 host frame : pack to 10LE32 while copying into staging buffer */
+      int src_uv_stride = frame->frame_props.linesize[1] ? frame->frame_props.linesize[1] : src_bytes_in_line;
+
+      dev_y_size = (size_t)ctx->in_stride[0] * ctx->in_hgt_align[0];
+      xlnx_pack_p010_frame((const uint8_t *)frame->data[0].buffer, src_bytes_in_line,
+                           (const uint8_t *)frame->data[1].buffer, src_uv_stride,
+                           device_buffer, ctx->in_stride[0], ctx->in_hgt_align[0],
+                           frame->frame_props.width, src_height);
+      ret = xvbm_buffer_write(ctx->in_bhandle[ctx->s_idx], device_buffer,
+                              (3 * dev_y_size) >> 1, 0);
+  } else if (src_bytes_in_line != dev_bytes_in_line) {
+      uint16_t dev_rows_in_plane = dev_height;
+      uint16_t src_rows_in_plane = src_height;
+      size_t dev_index = 0;
+      for (int plane_id = 0; plane_id < xma_frame_planes_get(&frame->frame_props);
+              plane_id++) {
+          size_t src_index = 0;
+          src_buffer = (uint8_t *)frame->data[plane_id].buffer;
+          if(plane_id > 0) {
+              dev_rows_in_plane = dev_height / 2;
+              src_rows_in_plane = src_height / 2;
+          }
+          for(uint16_t h = 0; h < src_rows_in_plane; h++) {
+              for(uint16_t w = 0; w < src_bytes_in_line; w++) {
+                  if(w < src_bytes_in_line && h < src_rows_in_plane) {
+                      device_buffer[dev_index] = src_buffer[src_index];
+                      src_index++;
+                  }
+                  dev_index++;
+              }
+              dev_index += dev_bytes_in_line - src_bytes_in_line;
+          }
+          dev_index += dev_bytes_in_line * (dev_rows_in_plane - src_rows_in_plane);
+      }
+      ret = xvbm_buffer_write(ctx->in_bhandle[ctx->s_idx], device_buffer,
+                              (3 * dev_y_size) >> 1, 0);
+  } else {
+    if (frame->data[0].buffer + dev_y_size == frame->data[1].buffer) {
+        ret = xvbm_buffer_write(ctx->in_bhandle[ctx->s_idx], frame->data[0].buffer, (dev_y_size *3 ) >> 1, 0);
+    } else {
+        size_t src_y_size = src_bytes_in_line * src_height;
+        ret = xvbm_buffer_write(ctx->in_bhandle[ctx->s_idx], frame->data[0].buffer, src_y_size, 0);
+        if (!ret) {
+            xvbm_buffer_write(ctx->in_bhandle[ctx->s_idx], frame->data[1].buffer, src_y_size >> 1, dev_y_size);
+        }
+    }
+  }
+  return ret;
+}
+
+/* Writes input buffer at channel-0 */
+static int32_t
+prep_and_write_input_buffer (XmaScalerSession *session, int32_t buf_idx, XmaFrame *frame)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  int max_outputs = MIN(ctx->num_outs, MAX_OUTPUTS);
+  XV_MULTISCALER_DESCRIPTOR *desc = &ctx->desc[ctx->pipe_idx][ctx->batch_fill * max_outputs];
+  uint64_t paddr;
+  uint64_t offset;
+  int output_id;
+
+  (void)buf_idx; //unused param
+  if ((session->props.input.format == XMA_VCU_NV12_FMT_TYPE) || ( session->props.input.format == XMA_VCU_NV12_10LE32_FMT_TYPE)) {
+    if (frame->data[0].buffer_type == XMA_DEVICE_BUFFER_TYPE)
+       ctx->in_bhandle[ctx->s_idx] = (XvbmBufferHandle)(frame->data[0].buffer);
+    else {
+        if(get_raw_host_frame(ctx, frame)) {
+          ERROR_PRINT("host buffer write failed\n");
+          return XMA_ERROR;
+        }
+        if (ctx->enable_pipeline != 0)
+            ctx->enable_pipeline = 1;
+    }
+
+    if (ctx->in_bhandle[ctx->s_idx]) {
+      //Extend Input Pool, if needed
+      if (!ctx->pool_extended) {
+        if (ctx->latency_logging) {
+          clock_gettime (CLOCK_REALTIME, &ctx->latency);
+          ctx->time_taken = (ctx->latency.tv_sec * 1e3) + (ctx->latency.tv_nsec / 1e6);
+          syslog(LOG_DEBUG, "%s : xma_extend start at : %lld\n", __func__, ctx->time_taken);
+        }
+
+        uint32_t num = xvbm_buffer_pool_num_buffers_get(ctx->in_bhandle[ctx->s_idx]);
+        xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "Num of buffers allocated in previous component = %d\n", num);
+        /* Depending on available XRT buffer, pool can be extended more (currently 4) */
+
+        /* batching holds up to a full batch plus the frame being returned,
+         * passthrough outputs keep input buffers until downstream releases them */
+        uint32_t extend = ctx->batch_frames > 1 ? ctx->batch_frames + 1 : MAX_PIPELINE_BUFFERS;
+        if (ctx->num_passthrough)
+          extend += MAX_OUTPOOL_BUFFERS;
+        uint32_t cnt = xvbm_buffer_pool_extend(ctx->in_bhandle[ctx->s_idx], extend);
+        if (cnt == num + extend) {
+          ctx->pool_extended = true;
+          xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "Extended previous component's output pool to %d buffers\n", cnt);
+        } else {
+          ERROR_PRINT("Extention failed");
+          return XMA_ERROR;
+        }
+
+        if (ctx->latency_logging) {
+          clock_gettime (CLOCK_REALTIME, &ctx->latency);
+          ctx->time_taken = (ctx->latency.tv_sec * 1e3) + (ctx->latency.tv_nsec / 1e6);
+          syslog(LOG_DEBUG, "%s : xma_extend end at : %lld\n", __func__, ctx->time_taken);
+        }
+      }
+      XVBM_BUFF_PR("\tMS Recv buffer from DEC =%p ID = %d\n",
+                    ctx->in_bhandle[ctx->s_idx],
+                    xvbm_buffer_get_id(ctx->in_bhandle[ctx->s_idx]));
+
+      paddr = xvbm_buffer_get_paddr(ctx->in_bhandle[ctx->s_idx]);
+
+      /* prep_write plane-1 with offset stride * elevation */
+      offset = ctx->in_stride[0] * ctx->in_hgt_align[0];
+
+      /* every scaled output fed by the session input */
+      for (output_id = 0; output_id < max_outputs; output_id++) {
+        if (!channel_scaled(ctx, output_id) || (ctx->src_out[output_id] >= 0))
+          continue;
+        desc[output_id].srcImgBuf[0] = paddr + ctx->crop_offset[output_id][0];
+        desc[output_id].srcImgBuf[1] = paddr + offset + ctx->crop_offset[output_id][1];
+      }
+    } else {
+        ERROR_PRINT ("invalid input buffer handle in scaler\n");
+        return XMA_ERROR;
+    }
+  } else {
+      /* TODO : Not supported yet */
+      ERROR_PRINT ("Input format %d not supported. Must be XMA_VCU_NV12_FMT_TYPE\n", session->props.input.format);
+      return XMA_ERROR;
+  }
+
+  return XMA_SUCCESS;
+}
+
+/* Bottom field descriptors follow the top field ones, one line further down
+ * in woven buffers, half a frame further in separate field outputs
+ */
+static void field_set_addresses(MultiScalerContext *ctx, XV_MULTISCALER_DESCRIPTOR *desc)
+{
+  int max_outputs = MIN(ctx->num_outs, MAX_OUTPUTS);
+  int output_id, plane_id;
+
+  for (output_id = 0; output_id < max_outputs; output_id++) {
+    XV_MULTISCALER_DESCRIPTOR *top    = &desc[output_id];
+    XV_MULTISCALER_DESCRIPTOR *bottom = &desc[max_outputs + output_id];
+    uint32_t out_stride = ctx->out_stride[output_id];
+
+    if (!channel_scaled(ctx, output_id))
+      continue;
+    for (plane_id = 0; plane_id < MAX_VPLANES; plane_id++)
+      bottom->srcImgBuf[plane_id] = top->srcImgBuf[plane_id] + ctx->in_stride[output_id];
+    if (ctx->separate_fields[output_id]) {
+      bottom->dstImgBuf[0] = top->dstImgBuf[0] + (uint64_t)(ctx->out_height[output_id] / 2) * out_stride;
+      bottom->dstImgBuf[1] = top->dstImgBuf[1] + (uint64_t)(ctx->out_height[output_id] / 4) * out_stride;
+    } else {
+      bottom->dstImgBuf[0] = top->dstImgBuf[0] + out_stride;
+      bottom->dstImgBuf[1] = top->dstImgBuf[1] + out_stride;
+    }
+  }
+}
+
+/* do prep_write for all input & output channels except channel-0 input */
+static int32_t
+prepare_inout_buffers (XmaScalerSession *session, int32_t buf_idx)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  int32_t output_id;
+  int32_t plane_id = 0;
+  uint64_t value = 0;
+  uint64_t paddr, offset;
+  int max_outputs = MIN(ctx->num_outs, MAX_OUTPUTS);
+  XV_MULTISCALER_DESCRIPTOR *desc = &ctx->desc[ctx->pipe_idx][ctx->batch_fill * max_outputs];
+  XvbmBufferHandle b_handle;
+
+  (void)buf_idx; //unused param
+  if (ctx->num_thumbs)
+    thumb_select(ctx);
+  for (output_id = 0; output_id < max_outputs; output_id++) {
+    int next_id;
+
+    if (!channel_scaled(ctx, output_id) || thumb_idle(ctx, output_id, ctx->s_idx))
+      continue;
+    if ((session->props.output[output_id].format == XMA_VCU_NV12_FMT_TYPE) || (session->props.output[output_id].format == XMA_VCU_NV12_10LE32_FMT_TYPE)){
+      uint64_t offset = 0;
+      do {
+        b_handle = xvbm_buffer_pool_entry_alloc(ctx->out_phandle[output_id][0]);
+        if (b_handle != NULL) {
+          XVBM_BUFF_PR("\tMS: got free buffer from pool %p id = %d\n",
+                       b_handle, xvbm_buffer_get_id(b_handle));
+          ctx->max_try[output_id] = 0;
+          break;
+        } else {
+          ctx->max_try[output_id]++;
+          //extend pool by 1 at time for at max MAX_OUTPOOL_BUFFERS_RETRIES times
+          if (ctx->num_buffers_extended[output_id] < MAX_OUTPOOL_BUFFERS_RETRIES)
+          {
+            //Using another buffer handle from same pool to extend the buffer pool
+            for(int i = 0; i < MAX_OUTPOOL_BUFFERS; i++)
+            {
+              b_handle = ctx->out_bhandle[output_id][i][0];
+              if(b_handle)
+                break;
+            }
+            if(!b_handle)
+            {
+              ERROR_PRINT("Unable to find a buffer from bufferpool to extract pool handle");
+              return XMA_ERROR;
+            }
+            //Passing 0 to xvbm_buffer_pool_extend for getting the buffer count
+            uint32_t num = xvbm_buffer_pool_extend(b_handle,0);
+            DEBUG_PRINT("Scaler plg request to extend Scaler output pool(%d) by 1 buffers", num);
+            uint32_t cnt = xvbm_buffer_pool_extend(b_handle,1);
+            b_handle = NULL; //resetting b_handle
+            if (cnt != num+1) {
+              ERROR_PRINT("OOM: Scaler plg Failed to extend Scaler output pool by 1 buffers");
+              return XMA_ERROR;
+            }
+            else{
+              ctx->num_buffers_extended[output_id]++;
+              DEBUG_PRINT("New Scaler output pool has %d buffers", cnt);
+            }
+          }
+          if (ctx->max_try[output_id] >= MAX_RETRIES_PER_CHAN) {
+            ERROR_PRINT ("xvbm_buffer_pool_entry_alloc failed forever\n");
+            goto TRY_AGAIN;
+          }
+          DEBUG_PRINT ("Unable to get free buffer for encoder for channel id = %d, retrying [try=%d]..\n",
+                          output_id, ctx->max_try[output_id]);
+          usleep(2000);
+        }
+      } while (b_handle == NULL);
+
+      /* Save buffer handler to get same in receive call */
+      ctx->out_bhandle[output_id][ctx->s_idx][0] = b_handle;
+      XVBM_BUFF_PR("MS adding buffer for output_id = %d, ctx->s_idx = %d\n", output_id,ctx->s_idx);
+      paddr = xvbm_buffer_get_paddr(b_handle);
+      desc[output_id].dstImgBuf[0] = paddr;
+
+      offset = ctx->out_stride[output_id] * ctx->out_hgt_align[output_id];
+      paddr += offset;
+      desc[output_id].dstImgBuf[1] = paddr;
+
+      //Since Input is cascaded, prepare input register write at the outputs fed by this one
+      for (next_id = output_id + 1; next_id < max_outputs; next_id++) {
+        if (!channel_scaled(ctx, next_id) || (ctx->src_out[next_id] != output_id))
+          continue;
+        desc[next_id].srcImgBuf[0] = desc[output_id].dstImgBuf[0] + ctx->crop_offset[next_id][0];
+        desc[next_id].srcImgBuf[1] = desc[output_id].dstImgBuf[1] + ctx->crop_offset[next_id][1];
+      }
+    } else {
+        for (plane_id = 0; plane_id < get_num_video_planes(session->props.output[output_id].format); plane_id++) {
+          do {
+            b_handle = xvbm_buffer_pool_entry_alloc(ctx->out_phandle[output_id][plane_id]);
+            if (b_handle != NULL) {
+              XVBM_BUFF_PR("\tMS: got free buffer from pool %p id = %d\n",
+                  b_handle, xvbm_buffer_get_id(b_handle));
+              ctx->max_try[output_id] = 0;
+              break;
+            } else {
+              ctx->max_try[output_id]++;
+              //extend pool by 1 at time for at max MAX_OUTPOOL_BUFFERS_RETRIES times
+              if (ctx->num_buffers_extended[output_id] < MAX_OUTPOOL_BUFFERS_RETRIES)
+              {
+                //Using another buffer handle from same pool to extend the buffer pool
+                for(int i = 0; i < MAX_OUTPOOL_BUFFERS; i++)
+                {
+                  b_handle = ctx->out_bhandle[output_id][i][0];
+                  if(b_handle)
+                    break;
+                }
+                if(!b_handle)
+                {
+                  ERROR_PRINT("Unable to find a buffer from bufferpool to extract pool handle");
+                  return XMA_ERROR;
+                }
+                //Passing 0 to xvbm_buffer_pool_extend for getting the buffer count
+                uint32_t num = xvbm_buffer_pool_extend(b_handle,0);
+                DEBUG_PRINT("Scaler plg request to extend Scaler output pool(%d) by 1 buffers", num);
+                uint32_t cnt = xvbm_buffer_pool_extend(b_handle,1);
+                b_handle = NULL; //resetting b_handle
+                if (cnt != num+1) {
+                  ERROR_PRINT("OOM: Scaler plg Failed to extend Scaler output pool by 1 buffers");
+                  return XMA_ERROR;
+                }
+                else{
+                  ctx->num_buffers_extended[output_id]++;
+                  DEBUG_PRINT("New Scaler output pool has %d buffers", cnt);
+                }
+              }
+              if (ctx->max_try[output_id] >= MAX_RETRIES_PER_CHAN) {
+                ERROR_PRINT ("xvbm_buffer_pool_entry_alloc failed forever\n");
+                goto TRY_AGAIN;
+              }
+              DEBUG_PRINT ("Unable to get free buffer for encoder for channel id = %d, retrying [try=%d]..\n",
+                              output_id, ctx->max_try[output_id]);
+              usleep(2000);
+            }
+          } while (b_handle == NULL);
+
+          /*
+           * Save buffer handler to get same in receive call
+           * s_idx should be equal to r_idx in recv
+           */
+          ctx->out_bhandle[output_id][ctx->s_idx][plane_id] = b_handle;
+          paddr = xvbm_buffer_get_paddr(b_handle);
+          desc[output_id].dstImgBuf[plane_id] = paddr;
+
+          /* prepare input register write at the outputs fed by this one */
+          for (next_id = output_id + 1; next_id < max_outputs; next_id++) {
+            if (channel_scaled(ctx, next_id) && (ctx->src_out[next_id] == output_id))
+              desc[next_id].srcImgBuf[plane_id] = paddr;
+          }
+        }//for (plane_id)
+    } //if (session->props.output[output_id].format == XMA_VCU_NV12_FMT_TYPE)
+  }// for (output_id
+  if (ctx->num_fields > 1)
+    field_set_addresses(ctx, desc);
+  if (ctx->num_thumbs)
+    thumb_link(ctx);
+  /* slice bands write their own descriptors, the pipes may still run bands
+   * of the previous frame */
+  if (!ctx->slice_rows)
+    write_desc_data_to_device(session);
+  print_desc_config(session);
+  return XMA_SUCCESS;
+TRY_AGAIN:
+  /* Clean up allocated buffers */
+  for (int output = 0; output <= output_id; output++) {
+    for (int plane = 0; plane < get_num_video_planes(session->props.output[output].format); plane++) {
+      XvbmBufferHandle b_handle = ctx->out_bhandle[output][ctx->s_idx][plane];
+      if (b_handle != NULL) {
+        xvbm_buffer_pool_entry_free(b_handle);
+        ctx->out_bhandle[output][ctx->s_idx][plane] = NULL;
+      }
+    }
+  }
+  return XMA_TRY_AGAIN;
+}
+
+/*****************************************************************************
+ * Frame batching
+ * With "batch_frames" = K, K input frames are queued before the kernel is
+ * started once on the chained descriptors of all of them. The first K-1 sends
+ * return XMA_SEND_MORE_DATA; afterwards every send returns one frame list,
+ * the first recv of a batch waits for the kernel and the rest return at once.
+*****************************************************************************/
+static int32_t batch_submit(XmaScalerSession *session)
+{
+  XmaSession xma_session = session->base;
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  int max_outputs = MIN(ctx->num_outs, MAX_OUTPUTS);
+  uint32_t num_desc = ctx->batch_fill * max_outputs;
+  int32_t xma_ret = XMA_SUCCESS;
+
+  memcpy((ctx->hw_reg[ctx->pipe_idx] + XV_MULTI_SCALER_CTRL_ADDR_NUM_OUTS_DATA), &num_desc, sizeof(num_desc));
+  if (ctx->batch_fill < ctx->batch_frames) {
+    /* partial batch, end the chain on device at the last queued frame.
+     * Host copy keeps the link so the slot is complete when refilled */
+    XlnxDevRegion *last = &ctx->desc_buffer[ctx->pipe_idx][num_desc - 1];
+    ((XV_MULTISCALER_DESCRIPTOR *)last->data)->nxtaddr = 0;
+    write_dev_region(session, last);
+  }
+
+  xma_plg_schedule_work_item(xma_session, ctx->hw_reg[ctx->pipe_idx], XV_MULTI_SCALER_CTRL_REGMAP_SIZE, &xma_ret);
+  if (xma_ret != XMA_SUCCESS) {
+    ERROR_PRINT ("failed schedule request to XRT...val = %d", xma_ret);
+    return xma_ret;
+  }
+  DEBUG_PRINT ("submitted batch of %u frames on pipe %d", ctx->batch_fill, ctx->pipe_idx);
+  ctx->pipe_idx = (ctx->pipe_idx + 1) % MAX_PIPELINE_BUFFERS;
+  ctx->batch_pending = ctx->batch_fill;
+  ctx->batch_fill = 0;
+  return XMA_SUCCESS;
+}
+
+/* Makes one completed frame available to recv */
+static int32_t batch_wait(XmaScalerSession *session)
+{
+  XmaSession xma_session = session->base;
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  int32_t xma_ret;
+
+  if (!ctx->batch_avail) {
+    if (!ctx->batch_pending) {
+      if (!ctx->batch_fill) {
+        ERROR_PRINT ("receive called with no frames queued");
+        return XMA_ERROR;
+      }
+      /* receive called ahead of a full batch, run what is queued */
+      xma_ret = batch_submit(session);
+      if (xma_ret != XMA_SUCCESS)
+        return xma_ret;
+    }
+    xma_ret = xma_plg_is_work_item_done(xma_session, 5000);
+    if (xma_ret != XMA_SUCCESS) {
+      ERROR_PRINT ("Scaler Stopped responding");
+      return xma_ret;
+    }
+    ctx->batch_avail   = ctx->batch_pending;
+    ctx->batch_pending = 0;
+  }
+  ctx->batch_avail--;
+  return XMA_SUCCESS;
+}
+
+/*****************************************************************************
+ * Hang watchdog
+ * Work items started by send are queued with their submit time. With
+ * "hang_watchdog" an item is reported overdue once it has run longer than
+ * the kernel time expected for the session (the larger of the cycle model
+ * and the measured average) plus WD_STALL_PERIODS input frame periods. Time
+ * queued behind other sessions on the CU is not seen here, so this is only
+ * a warning; the item is never started again. After WD_MAX_MS the frames in
+ * flight are dropped and the session restarts at the next send. Their
+ * buffers are held back until the dropped items have completed, as the
+ * device may still write them. Batched and shared CU sessions keep the
+ * fixed timeout.
+*****************************************************************************/
+static int64_t timespec_diff_us(const struct timespec *end, const struct timespec *start)
+{
+  return (int64_t)(end->tv_sec - start->tv_sec) * 1000000 +
+         (end->tv_nsec - start->tv_nsec) / 1000;
+}
+
+static int32_t wd_schedule(XmaScalerSession *session, int pipe)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  int32_t xma_ret = XMA_SUCCESS;
+  uint32_t slot = ctx->wd_head % WD_QUEUE_DEPTH;
+
+  clock_gettime(CLOCK_MONOTONIC, &ctx->wd_submit_ts[slot]);
+  ctx->wd_pipe[slot] = pipe;
+  xma_plg_schedule_work_item(session->base, ctx->hw_reg[pipe], XV_MULTI_SCALER_CTRL_REGMAP_SIZE, &xma_ret);
+  if (xma_ret != XMA_SUCCESS) {
+    ERROR_PRINT ("failed schedule request to XRT...val = %d", xma_ret);
     return xma_ret;
   }
+  /* with split_threads recv reads wd_head while send schedules the next frame */
+  __atomic_store_n(&ctx->wd_head, ctx->wd_head + 1, __ATOMIC_RELEASE);
+  return XMA_SUCCESS;
+}
+
+static int64_t wd_deadline_us(XmaScalerSession *session)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  uint64_t fps_milli, cycles;
+  int64_t expected_us, deadline_us;
+
+  if (!ctx->hang_watchdog)
+    return WD_MAX_MS * 1000;
+
+  fps_milli   = capacity_fps_milli(session->props.input.framerate);
+  cycles      = (ctx->cfg->cu_load_cost.cycles_per_sec * 1000) / fps_milli;
+  expected_us = (int64_t)((cycles * 1000000) / SCL_CU_CLOCK_HZ);
+  if (ctx->wd_kernel_us > expected_us)
+    expected_us = ctx->wd_kernel_us;
+  deadline_us = expected_us + (int64_t)(WD_STALL_PERIODS * 1000000000ULL / fps_milli);
+  if (deadline_us < WD_MIN_MS * 1000)
+    deadline_us = WD_MIN_MS * 1000;
+  if (deadline_us > WD_MAX_MS * 1000)
+    deadline_us = WD_MAX_MS * 1000;
+  return deadline_us;
+}
+
+/* Start of the oldest item's run: its submit, or the previous completion if queued behind it */
+static const struct timespec *wd_started(MultiScalerContext *ctx)
+{
+  const struct timespec *submit = &ctx->wd_submit_ts[ctx->wd_tail % WD_QUEUE_DEPTH];
+
+  return timespec_diff_us(&ctx->wd_last_done, submit) > 0 ? &ctx->wd_last_done : submit;
+}
+
+/* Time to wait for the oldest item before looking again, 0 or less once it hung */
+static int64_t wd_wait_us(XmaScalerSession *session, const struct timespec *started)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  struct timespec now;
+  int64_t elapsed_us, deadline_us;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  elapsed_us = timespec_diff_us(&now, started);
+  if (ctx->hang_watchdog && !ctx->wd_overdue) {
+    deadline_us = wd_deadline_us(session);
+    if (elapsed_us < deadline_us)
+      return deadline_us - elapsed_us;
+    ctx->wd_overdue = true;
+    ctx->wd_stalls++;
+    xma_logmsg(XMA_WARNING_LOG, XMA_MULTISCALER,
+               "Scaler work item on pipe %d overdue: %lld us, expected within %lld us",
+               ctx->wd_pipe[ctx->wd_tail % WD_QUEUE_DEPTH], (long long)elapsed_us, (long long)deadline_us);
+  }
+  return WD_MAX_MS * 1000LL - elapsed_us;
+}
+
+static void wd_complete(MultiScalerContext *ctx)
+{
+  struct timespec now;
+  int64_t kernel_us;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  kernel_us = timespec_diff_us(&now, wd_started(ctx));
+  /* 1/8 weight, same as the low latency estimate */
+  ctx->wd_kernel_us = ctx->wd_kernel_us ? (ctx->wd_kernel_us * 7 + kernel_us) / 8 : kernel_us;
+  ctx->wd_last_done = now;
+  ctx->wd_overdue = false;
+  if (ctx->wd_tail != __atomic_load_n(&ctx->wd_head, __ATOMIC_ACQUIRE))
+    ctx->wd_tail++;
+}
+
+static void wd_hold_buffer(MultiScalerContext *ctx, XvbmBufferHandle b_handle)
+{
+  if (!ctx->wd_stale)
+    xvbm_buffer_pool_entry_free(b_handle);
+  else if (ctx->wd_num_held < WD_HELD_BUFFERS)
+    ctx->wd_held[ctx->wd_num_held++] = b_handle;
+  /* else it is never handed out again rather than reused under the device */
+}
+
+static void wd_release_held(MultiScalerContext *ctx)
+{
+  int32_t i;
+
+  if (ctx->wd_stale)
+    return;
+  for (i = 0; i < ctx->wd_num_held; i++)
+    xvbm_buffer_pool_entry_free(ctx->wd_held[i]);
+  ctx->wd_num_held = 0;
+}
+
+/* Consumes the completions of items dropped by a reset, they are counted per session */
+static int32_t wd_drain_stale(XmaScalerSession *session)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+
+  while (ctx->wd_stale) {
+    if (xma_plg_is_work_item_done(session->base, WD_MAX_MS) != XMA_SUCCESS) {
+      ERROR_PRINT ("Scaler Stopped responding, %u dropped work items not completed", ctx->wd_stale);
+      return XMA_ERROR;
+    }
+    ctx->wd_stale--;
+  }
+  wd_release_held(ctx);
+  return XMA_SUCCESS;
+}
+
+/* Drops the frames in flight; the next send starts a fresh pipeline */
+static void wd_reset(XmaScalerSession *session)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  int max_outputs = MIN(ctx->num_outs, MAX_OUTPUTS);
+  uint64_t dropped = ctx->recv_frame_cnt - ctx->sent_frame_cnt;
+  int output_id, plane_id, slot;
+  uint64_t i;
+
+  ctx->wd_stale += ctx->wd_head - ctx->wd_tail;
+  for (i = 0; i < dropped; i++) {
+    slot = (ctx->r_idx + i) % MAX_OUTPOOL_BUFFERS;
+    for (output_id = 0; output_id < max_outputs; output_id++) {
+      for (plane_id = 0; plane_id < MAX_VPLANES; plane_id++) {
+        if (ctx->out_bhandle[output_id][slot][plane_id]) {
+          wd_hold_buffer(ctx, ctx->out_bhandle[output_id][slot][plane_id]);
+          ctx->out_bhandle[output_id][slot][plane_id] = NULL;
+        }
+      }
+    }
+    if (ctx->in_bhandle[slot]) {
+      wd_hold_buffer(ctx, ctx->in_bhandle[slot]);
+      ctx->in_bhandle[slot] = NULL;
+    }
+#ifdef HDR_DATA_SUPPORT
+    if (ctx->hdr_handle[slot]) {
+      xma_side_data_dec_ref(ctx->hdr_handle[slot]);
+      ctx->hdr_handle[slot] = NULL;
+    }
+#endif
+  }
 
-  /* Allocate buffers for input and output channels */
-  xma_ret = multi_scaler_allocate_buffers (session);
-  if (xma_ret != XMA_SUCCESS) {
-    ERROR_PRINT ("failed to allocate buffers...");
-    return xma_ret;
+  ctx->sent_frame_cnt  = ctx->recv_frame_cnt.load();
+  ctx->s_idx           = 0;
+  ctx->r_idx           = 0;
+  ctx->current_pipe    = 0;
+  ctx->pipe_idx        = 0;
+  ctx->first_frame     = 0;
+  ctx->wd_tail         = ctx->wd_head;
+  ctx->wd_overdue      = false;
+  ctx->dedup_have_last = false;
+  ctx->slice_open      = false;
+  xma_logmsg(XMA_ERROR_LOG, XMA_MULTISCALER, "Scaler pipeline reset, %lu frames dropped, %u work items outstanding",
+             (unsigned long)dropped, ctx->wd_stale);
+}
+
+static int32_t wd_recover(XmaScalerSession *session)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+
+  ERROR_PRINT ("Scaler Stopped responding");
+  /* the receiving thread must not touch the sender's indices */
+  if (ctx->hang_watchdog && !ctx->split_threads)
+    wd_reset(session);
+  return XMA_ERROR;
+}
+
+static int32_t wd_wait(XmaScalerSession *session)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  int64_t remaining_us;
+
+  if (wd_drain_stale(session) != XMA_SUCCESS)
+    return XMA_ERROR;
+
+  if (ctx->wd_tail == __atomic_load_n(&ctx->wd_head, __ATOMIC_ACQUIRE)) {
+    /* nothing tracked, e.g. started outside wd_schedule */
+    if (xma_plg_is_work_item_done(session->base, WD_MAX_MS) != XMA_SUCCESS) {
+      ERROR_PRINT ("Scaler Stopped responding");
+      return XMA_ERROR;
+    }
+    return XMA_SUCCESS;
   }
 
-  /* write to context info to registers */
-  xma_ret = write_registers(session);
-  if (xma_ret != XMA_SUCCESS) {
-    ERROR_PRINT ("failed to write registers...");
-    return xma_ret;
+  for (;;) {
+    remaining_us = wd_wait_us(session, wd_started(ctx));
+    if (remaining_us <= 0)
+      return wd_recover(session);
+    if (xma_plg_is_work_item_done(session->base, (int32_t)((remaining_us + 999) / 1000)) == XMA_SUCCESS) {
+      wd_complete(ctx);
+      return XMA_SUCCESS;
+    }
   }
-  ctx->current_pipe = 0;
-#ifdef MEASURE_TIME
-  ctx->send_count = 0;
-  ctx->recv_count = 0;
-  ctx->send_func_time = 0;
-  ctx->recv_func_time = 0;
-  ctx->send_xrt_time = 0;
-  ctx->recv_xrt_time = 0;
-#endif
-  ctx->pool_extended = false;
+}
 
-  ctx->frame_sent = 0;
-  ctx->frame_recv = 0;
-  clock_gettime (CLOCK_REALTIME, &ctx->latency);
-  ctx->time_taken = (ctx->latency.tv_sec * 1e3) + (ctx->latency.tv_nsec / 1e6);
-  syslog(LOG_DEBUG, "%s : %p :  xma_end at %lld \n", __func__, ctx, ctx->time_taken);
+/*****************************************************************************
+ * Low latency profile
+ * Frames are never held: every send starts the kernel. recv polls for
+ * completion with a short timeout from the start. Send to recv latency is
+ * measured per frame, and kernel time from submit to the poll that saw the
+ * frame done.
+*****************************************************************************/
+static int32_t low_latency_wait(XmaScalerSession *session)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  struct timespec now;
+  int64_t kernel_us;
+  bool polled = false;
 
+  if (wd_drain_stale(session) != XMA_SUCCESS)
+    return XMA_ERROR;
+  while (xma_plg_is_work_item_done(session->base, LL_POLL_MS) != XMA_SUCCESS) {
+    if (wd_wait_us(session, &ctx->ll_submit_ts) <= 0)
+      return wd_recover(session);
+    polled = true;
+  }
+  wd_complete(ctx);
+
+  /* done on the first poll: it may have finished long before recv came, so
+   * the time taken only bounds the kernel time from above */
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  kernel_us = timespec_diff_us(&now, &ctx->ll_submit_ts);
+  if (!polled && ctx->ll_kernel_us && (kernel_us >= ctx->ll_kernel_us))
+    return XMA_SUCCESS;
+  /* 1/8 weight tracks resolution or load changes within a few frames */
+  ctx->ll_kernel_us = ctx->ll_kernel_us ? (ctx->ll_kernel_us * 7 + kernel_us) / 8 : kernel_us;
   return XMA_SUCCESS;
 }
 
-static int get_raw_host_frame(MultiScalerContext *ctx, XmaFrame *frame)
+static void low_latency_report(MultiScalerContext *ctx, int32_t idx)
 {
-  ctx->in_bhandle[ctx->s_idx] = xvbm_buffer_pool_entry_alloc (ctx->in_phandle);
-  if(!ctx->in_bhandle[ctx->s_idx]) {
-      xma_logmsg(XMA_ERROR_LOG, XMA_MULTISCALER, "Error: (%s) Buffer Pool full - no free buffer available\n", __func__);
-      return XMA_ERROR;
+  struct timespec now;
+  int64_t latency_us;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  latency_us = timespec_diff_us(&now, &ctx->ll_send_ts[idx]);
+  syslog(LOG_DEBUG, "%s : %p : frame %lu latency %lld us\n", __func__, ctx,
+         (unsigned long)ctx->sent_frame_cnt, (long long)latency_us);
+
+  if (!ctx->ll_count || (latency_us < ctx->ll_min_us))
+    ctx->ll_min_us = latency_us;
+  if (latency_us > ctx->ll_max_us)
+    ctx->ll_max_us = latency_us;
+  ctx->ll_sum_us += latency_us;
+  if (++ctx->ll_count == LL_REPORT_FRAMES) {
+    xma_logmsg(XMA_INFO_LOG, XMA_MULTISCALER,
+               "latency over %d frames: min %lld us, avg %lld us, max %lld us, kernel %lld us",
+               LL_REPORT_FRAMES, (long long)ctx->ll_min_us, (long long)(ctx->ll_sum_us / ctx->ll_count),
+               (long long)ctx->ll_max_us, (long long)ctx->ll_kernel_us);
+    ctx->ll_count = 0;
+    ctx->ll_sum_us = 0;
+    ctx->ll_max_us = 0;
   }
-  uint8_t* src_buffer;
-  uint8_t* device_buffer      = (uint8_t *)xvbm_buffer_get_host_ptr(ctx->in_bhandle[ctx->s_idx]);
-  uint16_t src_bytes_in_line  = frame->frame_props.linesize[0];
-  uint16_t dev_bytes_in_line  = ALIGN(src_bytes_in_line, SCL_IN_WIDTH_ALIGN);
-  uint16_t src_height         = frame->frame_props.height;
-  uint16_t dev_height         = ALIGN(src_height, SCL_IN_HEIGHT_ALIGN);
+}
 
-  uint16_t dev_rows_in_plane = dev_height;
-  uint16_t src_rows_in_plane = src_height;
-  size_t dev_index = 0;
+/*****************************************************************************
+ * Split producer/consumer threads
+ * With "split_threads" one thread may send while another receives. The
+ * per slot metadata arrays (pts, buffer handles, ...) form an SPSC ring:
+ * send only writes slot s_idx and publishes it by advancing ring_head after
+ * the kernel start, recv only reads slot r_idx and hands it back by advancing
+ * ring_tail. At most SPLIT_RING_DEPTH frames are in flight because each one
+ * owns a descriptor pipe until the kernel has consumed it. A thread that
+ * finds the ring full or empty sleeps on split_cond, which every ring_head,
+ * ring_tail and split_eos update signals, for up to SPLIT_WAIT_TIMEOUT_MS.
+*****************************************************************************/
+static int32_t split_sync_init(MultiScalerContext *ctx)
+{
+  pthread_condattr_t attr;
+  int ret;
 
-  size_t dev_y_size           = dev_bytes_in_line * dev_height;
-  int ret                     = 0;
-  if (src_bytes_in_line != dev_bytes_in_line) {
-      uint16_t dev_rows_in_plane = dev_height;
-      uint16_t src_rows_in_plane = src_height;
-      size_t dev_index = 0;
-      for (int plane_id = 0; plane_id < xma_frame_planes_get(&frame->frame_props);
-              plane_id++) {
-          size_t src_index = 0;
-          src_buffer = (uint8_t *)frame->data[plane_id].buffer;
-          if(plane_id > 0) {
-              dev_rows_in_plane = dev_height / 2;
-              src_rows_in_plane = src_height / 2;
-          }
-          for(uint16_t h = 0; h < src_rows_in_plane; h++) {
-              for(uint16_t w = 0; w < src_bytes_in_line; w++) {
-                  if(w < src_bytes_in_line && h < src_rows_in_plane) {
-                      device_buffer[dev_index] = src_buffer[src_index];
-                      src_index++;
-                  }
-                  dev_index++;
-              }
-              dev_index += dev_bytes_in_line - src_bytes_in_line;
-          }
-          dev_index += dev_bytes_in_line * (dev_rows_in_plane - src_rows_in_plane);
-      }
-      ret = xvbm_buffer_write(ctx->in_bhandle[ctx->s_idx], device_buffer,
-                              (3 * dev_y_size) >> 1, 0);
-  } else {
-    if (frame->data[0].buffer + dev_y_size == frame->data[1].buffer) {
-        ret = xvbm_buffer_write(ctx->in_bhandle[ctx->s_idx], frame->data[0].buffer, (dev_y_size *3 ) >> 1, 0);
-    } else {
-        size_t src_y_size = src_bytes_in_line * src_height;
-        ret = xvbm_buffer_write(ctx->in_bhandle[ctx->s_idx], frame->data[0].buffer, src_y_size, 0);
-        if (!ret) {
-            xvbm_buffer_write(ctx->in_bhandle[ctx->s_idx], frame->data[1].buffer, src_y_size >> 1, dev_y_size);
-        }
+  pthread_condattr_init(&attr);
+  /* timeouts are not moved by wall clock changes */
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  ret = pthread_cond_init(&ctx->split_cond, &attr);
+  pthread_condattr_destroy(&attr);
+  if (ret || pthread_mutex_init(&ctx->split_lock, NULL)) {
+    if (!ret)
+      pthread_cond_destroy(&ctx->split_cond);
+    ERROR_PRINT("split_threads synchronization setup failed");
+    return XMA_ERROR;
+  }
+  return XMA_SUCCESS;
+}
+
+static void split_sync_destroy(MultiScalerContext *ctx)
+{
+  pthread_cond_destroy(&ctx->split_cond);
+  pthread_mutex_destroy(&ctx->split_lock);
+}
+
+/* Stores 'value' to a ring counter or split_eos and wakes the other thread */
+static void split_publish(MultiScalerContext *ctx, uint32_t *counter, uint32_t value)
+{
+  pthread_mutex_lock(&ctx->split_lock);
+  __atomic_store_n(counter, value, __ATOMIC_RELEASE);
+  pthread_cond_broadcast(&ctx->split_cond);
+  pthread_mutex_unlock(&ctx->split_lock);
+}
+
+/* Sleeps on split_cond until woken or 'deadline', with split_lock held */
+static bool split_sleep(MultiScalerContext *ctx, const struct timespec *deadline)
+{
+  return pthread_cond_timedwait(&ctx->split_cond, &ctx->split_lock, deadline) != ETIMEDOUT;
+}
+
+static void split_deadline(struct timespec *deadline)
+{
+  clock_gettime(CLOCK_MONOTONIC, deadline);
+  deadline->tv_sec += SPLIT_WAIT_TIMEOUT_MS / 1000;
+  deadline->tv_nsec += (SPLIT_WAIT_TIMEOUT_MS % 1000) * 1000000L;
+  if (deadline->tv_nsec >= 1000000000L) {
+    deadline->tv_sec++;
+    deadline->tv_nsec -= 1000000000L;
+  }
+}
+
+static int32_t split_wait_for_slot(MultiScalerContext *ctx)
+{
+  struct timespec deadline;
+  int32_t ret = XMA_SUCCESS;
+
+  split_deadline(&deadline);
+  pthread_mutex_lock(&ctx->split_lock);
+  while ((ctx->ring_head - __atomic_load_n(&ctx->ring_tail, __ATOMIC_ACQUIRE)) >= SPLIT_RING_DEPTH) {
+    if (!split_sleep(ctx, &deadline)) {
+      ERROR_PRINT ("receiver did not drain the frame ring");
+      ret = XMA_ERROR;
+      break;
     }
   }
+  pthread_mutex_unlock(&ctx->split_lock);
   return ret;
 }
 
-/* Writes input buffer at channel-0 */
-static int32_t
-prep_and_write_input_buffer (XmaScalerSession *session, int32_t buf_idx, XmaFrame *frame)
+static int32_t split_wait_for_frame(MultiScalerContext *ctx)
+{
+  struct timespec deadline;
+  int32_t ret = XMA_SUCCESS;
+
+  split_deadline(&deadline);
+  pthread_mutex_lock(&ctx->split_lock);
+  while (__atomic_load_n(&ctx->ring_head, __ATOMIC_ACQUIRE) == ctx->ring_tail) {
+    if (__atomic_load_n(&ctx->split_eos, __ATOMIC_ACQUIRE)) {
+      ret = XMA_EOS;
+      break;
+    }
+    if (!split_sleep(ctx, &deadline)) {
+      ret = XMA_TRY_AGAIN;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&ctx->split_lock);
+  return ret;
+}
+
+/*****************************************************************************
+ * Duplicate frame detection
+ * With "dedup_frames" each input gets a fingerprint in send, over every row
+ * of both planes unless "dedup_sample_rows" limits it. When it equals
+ * the fingerprint of the last frame received and nothing is in flight, no
+ * kernel start is issued and recv hands out the outputs of that frame again.
+ * The plugin keeps one reference on the last outputs of every channel; device
+ * outputs get one more reference per frame they are returned in.
+*****************************************************************************/
+static uint64_t dedup_hash_plane(const uint8_t *src, int32_t stride, int32_t row_bytes,
+                                 int32_t rows, uint32_t sample_rows, uint64_t hash)
+{
+  int32_t step = (sample_rows && (rows > (int32_t)sample_rows)) ? rows / sample_rows : 1;
+  int32_t row, x;
+  uint64_t word;
+
+  for (row = 0; row < rows; row += step) {
+    const uint8_t *line = src + (size_t)row * stride;
+
+    for (x = 0; x + 8 <= row_bytes; x += 8) {
+      memcpy(&word, line + x, sizeof(word));
+      hash = (hash ^ word) * 0x100000001b3ULL;
+    }
+    for (; x < row_bytes; x++)
+      hash = (hash ^ line[x]) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+/* Fingerprints the frame into slot s_idx; true when it repeats the last one */
+static bool dedup_match(XmaScalerSession *session, XmaFrame *frame)
 {
   MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
-  uint64_t paddr;
-  uint64_t offset;
+  uint64_t fp = 0;
+
+  if (ctx->dedup_tag) {
+    fp = ctx->dedup_tag;
+    ctx->dedup_tag = 0;
+  } else if (frame->data[0].buffer_type != XMA_DEVICE_BUFFER_TYPE) {
+    int32_t width     = frame->frame_props.width;
+    int32_t height    = frame->frame_props.height;
+    int32_t y_stride  = frame->frame_props.linesize[0];
+    int32_t uv_stride = frame->frame_props.linesize[1] ? frame->frame_props.linesize[1] : y_stride;
+    int32_t row_bytes = ctx->host_p010 ? width * 2 : width;
+
+    if (session->props.input.format == XMA_VCU_NV12_10LE32_FMT_TYPE && !ctx->host_p010)
+      row_bytes = y_stride;
+    fp = dedup_hash_plane((const uint8_t *)frame->data[0].buffer, y_stride, row_bytes,
+                          height, ctx->dedup_sample_rows, 0xcbf29ce484222325ULL);
+    fp = dedup_hash_plane((const uint8_t *)frame->data[1].buffer, uv_stride, row_bytes,
+                          height / 2, ctx->dedup_sample_rows, fp);
+    if (!fp)
+      fp = 1;
+  }
+  ctx->dedup_fp[ctx->s_idx] = fp;
 
-  (void)buf_idx; //unused param
-  if ((session->props.input.format == XMA_VCU_NV12_FMT_TYPE) || ( session->props.input.format == XMA_VCU_NV12_10LE32_FMT_TYPE)) {
-    if (frame->data[0].buffer_type == XMA_DEVICE_BUFFER_TYPE)
-       ctx->in_bhandle[ctx->s_idx] = (XvbmBufferHandle)(frame->data[0].buffer);
-    else {
-        if(get_raw_host_frame(ctx, frame)) {
-          ERROR_PRINT("host buffer write failed\n");
-          return XMA_ERROR;
-        }
-        if (ctx->enable_pipeline != 0)
-            ctx->enable_pipeline = 1;
+  /* outputs of the last frame must be back, else they are not known yet */
+  return fp && ctx->dedup_have_last && (fp == ctx->dedup_last_fp) &&
+         (ctx->recv_frame_cnt == ctx->sent_frame_cnt);
+}
+
+/* Makes b_handle the kept output of the channel; device outputs gain a
+ * reference for the frame they are returned in.
+ */
+static void dedup_keep_output(MultiScalerContext *ctx, int output_id,
+                              XvbmBufferHandle b_handle, bool device)
+{
+  if (ctx->dedup_last[output_id] != b_handle) {
+    if (ctx->dedup_last[output_id])
+      xvbm_buffer_pool_entry_free(ctx->dedup_last[output_id]);
+    ctx->dedup_last[output_id] = b_handle;
+  }
+  if (device)
+    xvbm_buffer_refcnt_inc(b_handle);
+}
+
+static void dedup_release(XmaScalerSession *session)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  int output_id;
+
+  for (output_id = 0; output_id < MAX_OUTPUTS; output_id++) {
+    if (ctx->dedup_last[output_id]) {
+      xvbm_buffer_pool_entry_free(ctx->dedup_last[output_id]);
+      ctx->dedup_last[output_id] = NULL;
     }
+  }
+  ctx->dedup_have_last = false;
+  if (ctx->recv_frame_cnt)
+    xma_logmsg(XMA_INFO_LOG, XMA_MULTISCALER, "MultiScaler reused outputs for %lu of %lu frames",
+               ctx->dedup_skipped, (unsigned long)ctx->recv_frame_cnt);
+}
 
-    if (ctx->in_bhandle[ctx->s_idx]) {
-      //Extend Input Pool, if needed
-      if (!ctx->pool_extended) {
-        if (ctx->latency_logging) {
-          clock_gettime (CLOCK_REALTIME, &ctx->latency);
-          ctx->time_taken = (ctx->latency.tv_sec * 1e3) + (ctx->latency.tv_nsec / 1e6);
-          syslog(LOG_DEBUG, "%s : xma_extend start at : %lld\n", __func__, ctx->time_taken);
-        }
+extern "C" int32_t xlnx_multi_scaler_set_frame_tag(XmaScalerSession *session, uint64_t tag)
+{
+  MultiScalerContext *ctx;
 
-        uint32_t num = xvbm_buffer_pool_num_buffers_get(ctx->in_bhandle[ctx->s_idx]);
-        xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "Num of buffers allocated in previous component = %d\n", num);
-        /* Depending on available XRT buffer, pool can be extended more (currently 4) */
+  if (!session || !session->base.plugin_data)
+    return XMA_ERROR;
+  ctx = (MultiScalerContext*)session->base.plugin_data;
+  if (!ctx->dedup_frames)
+    return XMA_ERROR;
+  ctx->dedup_tag = tag;
+  return XMA_SUCCESS;
+}
 
-        uint32_t cnt = xvbm_buffer_pool_extend(ctx->in_bhandle[ctx->s_idx],
-                                               MAX_PIPELINE_BUFFERS);
-        if (cnt == num + MAX_PIPELINE_BUFFERS) {
-          ctx->pool_extended = true;
-          xma_logmsg(XMA_DEBUG_LOG, XMA_MULTISCALER, "Extended previous component's output pool to %d buffers\n", cnt);
-        } else {
-          ERROR_PRINT("Extention failed");
-          return XMA_ERROR;
-        }
+/*****************************************************************************
+ * Slice streaming
+ * With "slice_rows" a frame is scaled in horizontal bands while its producer
+ * is still writing it. A band holds, per output, the rows whose vertical taps
+ * lie in the input rows ready; cascaded outputs read the rows their source
+ * has finished. Band edges fall on output rows that map to an even, whole
+ * input row, so chroma siting and filter phase match the whole frame. Band
+ * descriptors are the whole frame ones with offset buffers and reduced
+ * heights; bands alternate between the descriptor pipes and are tracked by
+ * the watchdog queue, and a new frame starts while the last bands of the
+ * previous one still run.
+ * The kernel has no start phase and repeats a band's first input row above
+ * it. So a band below the top starts SLICE_OVERLAP_ROWS input rows early,
+ * is scaled into a scratch buffer together with the overlap output rows,
+ * and a second, 1:1 descriptor copies it to the frame without them.
+*****************************************************************************/
+static int32_t xlnx_multi_scaler_send_frame(XmaScalerSession *session, XmaFrame *frame);
+
+static uint32_t slice_gcd(uint32_t a, uint32_t b)
+{
+  while (b) {
+    uint32_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+/* Smallest even step of output rows mapping to an even number of input rows */
+static uint32_t slice_unit(MultiScalerContext *ctx, int output_id)
+{
+  uint32_t in_h  = ctx->in_height[output_id];
+  uint32_t out_h = ctx->out_height[output_id];
+  uint32_t step  = out_h / slice_gcd(in_h, out_h);
+
+  if ((step % 2) || (((step * in_h) / out_h) % 2))
+    step *= 2;
+  return step;
+}
+
+/* Output rows a band starting at output row 'first' scales above it and
+ * drops: whole units covering SLICE_OVERLAP_ROWS input rows, or all rows
+ * above it when there are fewer.
+ */
+static uint32_t slice_overlap(MultiScalerContext *ctx, int output_id, uint32_t first)
+{
+  uint32_t unit    = slice_unit(ctx, output_id);
+  uint32_t in_unit = (uint32_t)(((uint64_t)unit * ctx->in_height[output_id]) / ctx->out_height[output_id]);
+  uint32_t rows    = unit * ((SLICE_OVERLAP_ROWS + in_unit - 1) / in_unit);
+
+  return MIN(rows, first);
+}
+
+/* Waits for the oldest band and records the rows it completed */
+static int32_t slice_wait_band(XmaScalerSession *session)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  int max_outputs = MIN(ctx->num_outs, MAX_OUTPUTS);
+  uint32_t slot = ctx->wd_tail % WD_QUEUE_DEPTH;
+  int32_t xma_ret;
+  int output_id;
+
+  xma_ret = wd_wait(session);
+  if (xma_ret != XMA_SUCCESS)
+    return xma_ret;
+  /* bands of the previous frame may finish after the next one opened */
+  if (ctx->slice_band_frame[slot] != ctx->slice_frame_idx)
+    return XMA_SUCCESS;
+  for (output_id = 0; output_id < max_outputs; output_id++) {
+    if (ctx->slice_band_rows[slot][output_id] > ctx->slice_complete[output_id])
+      ctx->slice_complete[output_id] = ctx->slice_band_rows[slot][output_id];
+  }
+  return XMA_SUCCESS;
+}
+
+/* Waits for the bands of frame 'frame_idx'; later frames' bands queue behind them */
+static int32_t slice_wait_frame(XmaScalerSession *session, uint32_t frame_idx)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  int32_t xma_ret;
+
+  while ((ctx->wd_tail != ctx->wd_head) &&
+         (ctx->slice_band_frame[ctx->wd_tail % WD_QUEUE_DEPTH] == frame_idx)) {
+    xma_ret = slice_wait_band(session);
+    if (xma_ret != XMA_SUCCESS)
+      return xma_ret;
+  }
+  return XMA_SUCCESS;
+}
+
+/* Appends descriptor desc_id of the pipe to the chain ending at *prev_id */
+static void slice_link(MultiScalerContext *ctx, int pipe, int *prev_id, int desc_id)
+{
+  if (*prev_id >= 0)
+    ctx->desc[pipe][*prev_id].nxtaddr = ctx->desc_buffer[pipe][desc_id].paddr;
+  else
+    memcpy((ctx->hw_reg[pipe] + XV_MULTI_SCALER_CTRL_ADDR_START_ADDR_DATA),
+           &(ctx->desc_buffer[pipe][desc_id].paddr), sizeof(uint64_t));
+  *prev_id = desc_id;
+}
+
+/* Starts the output rows [slice_done, target) of every output as one band */
+static int32_t slice_start_band(XmaScalerSession *session, const uint16_t *target)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  int max_outputs = MIN(ctx->num_outs, MAX_OUTPUTS);
+  bool in_band[MAX_OUTPUTS], copied[MAX_OUTPUTS];
+  int output_id, prev_id = -1, pipe;
+  uint32_t num = 0, slot;
+  int32_t xma_ret;
+
+  /* a band reuses the pipe of the band before the previous one */
+  while ((ctx->wd_head - ctx->wd_tail) >= MAX_PIPELINE_BUFFERS) {
+    xma_ret = slice_wait_band(session);
+    if (xma_ret != XMA_SUCCESS)
+      return xma_ret;
+  }
+
+  pipe = ctx->slice_pipe;
+  for (output_id = 0; output_id < max_outputs; output_id++) {
+    XV_MULTISCALER_DESCRIPTOR *desc = &ctx->desc[pipe][output_id];
+    XV_MULTISCALER_DESCRIPTOR *copy = &ctx->desc[pipe][max_outputs + output_id];
+    XlnxDevRegion *scratch = &ctx->slice_scratch[output_id];
+    uint32_t first = ctx->slice_done[output_id];
+    uint32_t in_h  = ctx->in_height[output_id];
+    uint32_t out_h = ctx->out_height[output_id];
+    uint32_t out_stride = ctx->out_stride[output_id];
+    uint32_t in_first, in_rows, overlap, in_overlap;
+
+    copied[output_id]  = false;
+    in_band[output_id] = channel_scaled(ctx, output_id) && (target[output_id] > first);
+    if (!in_band[output_id])
+      continue;
+
+    in_first   = (uint32_t)(((uint64_t)first * in_h) / out_h);
+    overlap    = slice_overlap(ctx, output_id, first);
+    in_overlap = (uint32_t)(((uint64_t)overlap * in_h) / out_h);
+    if (target[output_id] == out_h) {
+      in_rows = in_h - in_first;
+    } else {
+      /* taps of the band's last row reach SLICE_OVERLAP_ROWS rows below it */
+      in_rows = (uint32_t)(((uint64_t)target[output_id] * in_h) / out_h) + SLICE_OVERLAP_ROWS - in_first;
+      in_rows = MIN(ALIGN(in_rows, 2), in_h - in_first);
+    }
+
+    *desc = ctx->slice_frame[output_id];
+    desc->heightIn      = in_overlap + in_rows;
+    desc->heightOut     = overlap + target[output_id] - first;
+    desc->srcImgBuf[0] += (uint64_t)(in_first - in_overlap) * ctx->in_stride[output_id];
+    desc->srcImgBuf[1] += (uint64_t)((in_first - in_overlap) / 2) * ctx->in_stride[output_id];
+    if (overlap) {
+      /* the overlap rows repeat the top input row, they stay in the scratch */
+      desc->dstImgBuf[0] = scratch->paddr;
+      desc->dstImgBuf[1] = scratch->paddr + (uint64_t)ctx->out_hgt_align[output_id] * out_stride;
+
+      *copy = ctx->slice_frame[output_id];
+      copy->widthIn       = copy->widthOut;
+      copy->heightIn      = target[output_id] - first;
+      copy->heightOut     = target[output_id] - first;
+      copy->lineRate      = STEP_PRECISION;
+      copy->pixelRate     = STEP_PRECISION;
+      copy->inPixelFmt    = copy->outPixelFmt;
+      copy->strideIn      = out_stride;
+      copy->srcImgBuf[0]  = desc->dstImgBuf[0] + (uint64_t)overlap * out_stride;
+      copy->srcImgBuf[1]  = desc->dstImgBuf[1] + (uint64_t)(overlap / 2) * out_stride;
+      copy->hfltCoeffAddr = ctx->slice_copy_coeff.paddr;
+      copy->vfltCoeffAddr = ctx->slice_copy_coeff.paddr;
+      copy->dstImgBuf[0] += (uint64_t)first * out_stride;
+      copy->dstImgBuf[1] += (uint64_t)(first / 2) * out_stride;
+      copied[output_id] = true;
+    }
+
+    /* outputs cascaded from this one follow its copy in the chain */
+    slice_link(ctx, pipe, &prev_id, output_id);
+    num++;
+    if (copied[output_id]) {
+      slice_link(ctx, pipe, &prev_id, max_outputs + output_id);
+      num++;
+    }
+  }
+  if (!num)
+    return XMA_SUCCESS;
+  ctx->desc[pipe][prev_id].nxtaddr = 0;
+  memcpy((ctx->hw_reg[pipe] + XV_MULTI_SCALER_CTRL_ADDR_NUM_OUTS_DATA), &num, sizeof(num));
+
+  slot = ctx->wd_head % WD_QUEUE_DEPTH;
+  ctx->slice_band_frame[slot] = ctx->s_idx;
+  for (output_id = 0; output_id < max_outputs; output_id++) {
+    int desc_id;
+
+    ctx->slice_band_rows[slot][output_id] = 0;
+    if (!in_band[output_id])
+      continue;
+    for (desc_id = output_id; desc_id < 2 * max_outputs; desc_id += max_outputs) {
+      if ((desc_id != output_id) && !copied[output_id])
+        break;
+      memcpy(ctx->desc_buffer[pipe][desc_id].data, &ctx->desc[pipe][desc_id],
+             ctx->desc_buffer[pipe][desc_id].size);
+      write_dev_region(session, &ctx->desc_buffer[pipe][desc_id]);
+    }
+    ctx->slice_band_rows[slot][output_id] = target[output_id];
+    ctx->slice_done[output_id] = target[output_id];
+  }
 
-        if (ctx->latency_logging) {
-          clock_gettime (CLOCK_REALTIME, &ctx->latency);
-          ctx->time_taken = (ctx->latency.tv_sec * 1e3) + (ctx->latency.tv_nsec / 1e6);
-          syslog(LOG_DEBUG, "%s : xma_extend end at : %lld\n", __func__, ctx->time_taken);
-        }
-      }
-      XVBM_BUFF_PR("\tMS Recv buffer from DEC =%p ID = %d\n",
-                    ctx->in_bhandle[ctx->s_idx],
-                    xvbm_buffer_get_id(ctx->in_bhandle[ctx->s_idx]));
+  xma_ret = wd_schedule(session, pipe);
+  if (xma_ret != XMA_SUCCESS)
+    return xma_ret;
+  ctx->slice_pipe = (ctx->slice_pipe + 1) % MAX_PIPELINE_BUFFERS;
+  return XMA_SUCCESS;
+}
 
-      paddr = xvbm_buffer_get_paddr(ctx->in_bhandle[ctx->s_idx]);
-      ctx->desc[ctx->pipe_idx][0].srcImgBuf[0] = paddr;
+/* Starts a band for the rows made available since the last one */
+static int32_t slice_advance(XmaScalerSession *session, uint32_t rows_ready)
+{
+  MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
+  int max_outputs = MIN(ctx->num_outs, MAX_OUTPUTS);
+  uint32_t frame_h = session->props.input.height;
+  uint16_t target[MAX_OUTPUTS];
+  bool complete = true;
+  int output_id;
+  int32_t xma_ret;
 
-      /* prep_write plane-1 with offset stride * elevation */
-      offset = ctx->in_stride[0] * ctx->in_hgt_align[0];
-      paddr += offset;
-      ctx->desc[ctx->pipe_idx][0].srcImgBuf[1] = paddr;
+  if (rows_ready > frame_h)
+    rows_ready = frame_h;
+  if ((rows_ready < frame_h) && (rows_ready < ctx->slice_in_rows + ctx->slice_rows))
+    return XMA_SEND_MORE_DATA;
+  ctx->slice_in_rows = rows_ready;
+
+  /* an output's source always comes before it in the ladder */
+  for (output_id = 0; output_id < max_outputs; output_id++) {
+    int src_id = ctx->src_out[output_id];
+    uint32_t in_h  = ctx->in_height[output_id];
+    uint32_t out_h = ctx->out_height[output_id];
+    uint32_t top   = (uint32_t)(ctx->crop_offset[output_id][0] / ctx->in_stride[output_id]);
+    uint32_t avail, rows;
+    bool whole;
+
+    target[output_id] = ctx->slice_done[output_id];
+    if (!channel_scaled(ctx, output_id))
+      continue;
+
+    if (src_id < 0) {
+      avail = rows_ready;
+      whole = (rows_ready == frame_h);
     } else {
-        ERROR_PRINT ("invalid input buffer handle in scaler\n");
-        return XMA_ERROR;
+      avail = target[src_id];
+      whole = (target[src_id] == ctx->out_height[src_id]);
     }
-  } else {
-      /* TODO : Not supported yet */
-      ERROR_PRINT ("Input format %d not supported. Must be XMA_VCU_NV12_FMT_TYPE\n", session->props.input.format);
-      return XMA_ERROR;
+    if (whole || (avail >= top + in_h)) {
+      target[output_id] = out_h;
+    } else if (avail > top + SLICE_OVERLAP_ROWS) {
+      rows  = (uint32_t)(((uint64_t)(avail - top - SLICE_OVERLAP_ROWS) * out_h) / in_h);
+      rows -= rows % slice_unit(ctx, output_id);
+      if (rows > target[output_id])
+        target[output_id] = rows;
+    }
+    if (target[output_id] < out_h)
+      complete = false;
   }
 
+  xma_ret = slice_start_band(session, target);
+  if (xma_ret != XMA_SUCCESS)
+    return xma_ret;
+  if (!complete)
+    return XMA_SEND_MORE_DATA;
+
+  /* every row is in a started band, the frame now belongs to recv */
+  ctx->slice_open   = false;
+  ctx->s_idx        = (ctx->s_idx + 1) % MAX_OUTPOOL_BUFFERS;
+  ctx->current_pipe = (ctx->current_pipe + 1) % MAX_OUTPOOL_BUFFERS;
   return XMA_SUCCESS;
 }
 
-/* do prep_write for all input & output channels except channel-0 input */
-static int32_t
-prepare_inout_buffers (XmaScalerSession *session, int32_t buf_idx)
+/* Sets up the buffers of a new frame and starts its first band */
+static int32_t slice_open_frame(XmaScalerSession *session, XmaFrame *frame)
 {
   MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
-  int32_t output_id;
-  int32_t plane_id = 0;
-  uint64_t value = 0;
-  uint64_t paddr, offset;
   int max_outputs = MIN(ctx->num_outs, MAX_OUTPUTS);
-  XvbmBufferHandle b_handle;
+  int32_t rows = ctx->slice_first_rows;
+  int32_t ret;
+
+  ctx->slice_first_rows = -1;
+  /* bands of the previous frame may still run, their descriptors are in
+   * the pipes and the whole frame ones below are only kept on the host */
+  ret = prep_and_write_input_buffer(session, ctx->current_pipe, frame);
+  if (ret != XMA_SUCCESS)
+    return ret;
+  ret = prepare_inout_buffers(session, ctx->current_pipe);
+  if (ret != XMA_SUCCESS)
+    return ret;
+
+  memcpy(ctx->slice_frame, ctx->desc[ctx->pipe_idx], max_outputs * sizeof(XV_MULTISCALER_DESCRIPTOR));
+  memset(ctx->slice_done, 0, sizeof(ctx->slice_done));
+  memset(ctx->slice_complete, 0, sizeof(ctx->slice_complete));
+  ctx->slice_frame_idx = ctx->s_idx;
+  ctx->slice_in_rows = 0;
+  ctx->slice_open    = true;
+
+  /* host frames were uploaded whole */
+  if ((rows < 0) || (frame->data[0].buffer_type != XMA_DEVICE_BUFFER_TYPE))
+    rows = session->props.input.height;
+  return slice_advance(session, rows);
+}
 
-  (void)buf_idx; //unused param
-  for (output_id = 0; output_id < max_outputs; output_id++) {
-    if ((session->props.output[output_id].format == XMA_VCU_NV12_FMT_TYPE) || (session->props.output[output_id].format == XMA_VCU_NV12_10LE32_FMT_TYPE)){
-      uint64_t offset = 0;
-      do {
-        b_handle = xvbm_buffer_pool_entry_alloc(ctx->out_phandle[output_id][0]);
-        if (b_handle != NULL) {
-          XVBM_BUFF_PR("\tMS: got free buffer from pool %p id = %d\n",
-                       b_handle, xvbm_buffer_get_id(b_handle));
-          ctx->max_try[output_id] = 0;
-          break;
-        } else {
-          ctx->max_try[output_id]++;
-          //extend pool by 1 at time for at max MAX_OUTPOOL_BUFFERS_RETRIES times
-          if (ctx->num_buffers_extended[output_id] < MAX_OUTPOOL_BUFFERS_RETRIES)
-          {
-            //Using another buffer handle from same pool to extend the buffer pool
-            for(int i = 0; i < MAX_OUTPOOL_BUFFERS; i++)
-            {
-              b_handle = ctx->out_bhandle[output_id][i][0];
-              if(b_handle)
-                break;
-            }
-            if(!b_handle)
-            {
-              ERROR_PRINT("Unable to find a buffer from bufferpool to extract pool handle");
-              return XMA_ERROR;
-            }
-            //Passing 0 to xvbm_buffer_pool_extend for getting the buffer count
-            uint32_t num = xvbm_buffer_pool_extend(b_handle,0);
-            DEBUG_PRINT("Scaler plg request to extend Scaler output pool(%d) by 1 buffers", num);
-            uint32_t cnt = xvbm_buffer_pool_extend(b_handle,1);
-            b_handle = NULL; //resetting b_handle
-            if (cnt != num+1) {
-              ERROR_PRINT("OOM: Scaler plg Failed to extend Scaler output pool by 1 buffers");
-              return XMA_ERROR;
-            }
-            else{
-              ctx->num_buffers_extended[output_id]++;
-              DEBUG_PRINT("New Scaler output pool has %d buffers", cnt);
-            }
-          }
-          if (ctx->max_try[output_id] >= MAX_RETRIES_PER_CHAN) {
-            ERROR_PRINT ("xvbm_buffer_pool_entry_alloc failed forever\n");
-            goto TRY_AGAIN;
-          }
-          DEBUG_PRINT ("Unable to get free buffer for encoder for channel id = %d, retrying [try=%d]..\n",
-                          output_id, ctx->max_try[output_id]);
-          usleep(2000);
-        }
-      } while (b_handle == NULL);
+extern "C" int32_t xlnx_multi_scaler_send_slice(XmaScalerSession *session, XmaFrame *frame, uint32_t rows_ready)
+{
+  MultiScalerContext *ctx;
 
-      /* Save buffer handler to get same in receive call */
-      ctx->out_bhandle[output_id][ctx->s_idx][0] = b_handle;
-      XVBM_BUFF_PR("MS adding buffer for output_id = %d, ctx->s_idx = %d\n", output_id,ctx->s_idx);
-      paddr = xvbm_buffer_get_paddr(b_handle);
-      ctx->desc[ctx->pipe_idx][output_id].dstImgBuf[0] = paddr;
+  if (!session || !session->base.plugin_data || !frame)
+    return XMA_ERROR;
+  ctx = (MultiScalerContext*)session->base.plugin_data;
+  if (!ctx->slice_rows)
+    return XMA_ERROR;
+  if (ctx->slice_open)
+    return slice_advance(session, rows_ready);
 
-      if (output_id < (max_outputs-1)) //Since Input is cascaded  loop starts with 1
-        /* prepare input register write at 'output_id+1' (in[1..7] = out[0..6]*/
-        ctx->desc[ctx->pipe_idx][output_id+1].srcImgBuf[0] = paddr;
+  ctx->slice_first_rows = rows_ready > (uint32_t)session->props.input.height ?
+                          session->props.input.height : (int32_t)rows_ready;
+  return xlnx_multi_scaler_send_frame(session, frame);
+}
 
-      offset = ctx->out_stride[output_id] * ctx->out_hgt_align[output_id];
-      paddr += offset;
-      ctx->desc[ctx->pipe_idx][output_id].dstImgBuf[1] = paddr;
-      if (output_id < (max_outputs-1))
-        ctx->desc[ctx->pipe_idx][output_id+1].srcImgBuf[1] = paddr;
-    } else {
-        for (plane_id = 0; plane_id < get_num_video_planes(session->props.output[output_id].format); plane_id++) {
-          do {
-            b_handle = xvbm_buffer_pool_entry_alloc(ctx->out_phandle[output_id][plane_id]);
-            if (b_handle != NULL) {
-              XVBM_BUFF_PR("\tMS: got free buffer from pool %p id = %d\n",
-                  b_handle, xvbm_buffer_get_id(b_handle));
-              ctx->max_try[output_id] = 0;
-              break;
-            } else {
-              ctx->max_try[output_id]++;
-              //extend pool by 1 at time for at max MAX_OUTPOOL_BUFFERS_RETRIES times
-              if (ctx->num_buffers_extended[output_id] < MAX_OUTPOOL_BUFFERS_RETRIES)
-              {
-                //Using another buffer handle from same pool to extend the buffer pool
-                for(int i = 0; i < MAX_OUTPOOL_BUFFERS; i++)
-                {
-                  b_handle = ctx->out_bhandle[output_id][i][0];
-                  if(b_handle)
-                    break;
-                }
-                if(!b_handle)
-                {
-                  ERROR_PRINT("Unable to find a buffer from bufferpool to extract pool handle");
-                  return XMA_ERROR;
-                }
-                //Passing 0 to xvbm_buffer_pool_extend for getting the buffer count
-                uint32_t num = xvbm_buffer_pool_extend(b_handle,0);
-                DEBUG_PRINT("Scaler plg request to extend Scaler output pool(%d) by 1 buffers", num);
-                uint32_t cnt = xvbm_buffer_pool_extend(b_handle,1);
-                b_handle = NULL; //resetting b_handle
-                if (cnt != num+1) {
-                  ERROR_PRINT("OOM: Scaler plg Failed to extend Scaler output pool by 1 buffers");
-                  return XMA_ERROR;
-                }
-                else{
-                  ctx->num_buffers_extended[output_id]++;
-                  DEBUG_PRINT("New Scaler output pool has %d buffers", cnt);
-                }
-              }
-              if (ctx->max_try[output_id] >= MAX_RETRIES_PER_CHAN) {
-                ERROR_PRINT ("xvbm_buffer_pool_entry_alloc failed forever\n");
-                goto TRY_AGAIN;
-              }
-              DEBUG_PRINT ("Unable to get free buffer for encoder for channel id = %d, retrying [try=%d]..\n",
-                              output_id, ctx->max_try[output_id]);
-              usleep(2000);
-            }
-          } while (b_handle == NULL);
+extern "C" int32_t xlnx_multi_scaler_recv_slice(XmaScalerSession *session, uint32_t *rows_done)
+{
+  MultiScalerContext *ctx;
+  int max_outputs, output_id;
+  int32_t xma_ret;
 
-          /*
-           * Save buffer handler to get same in receive call
-           * s_idx should be equal to r_idx in recv
-           */
-          ctx->out_bhandle[output_id][ctx->s_idx][plane_id] = b_handle;
-          paddr = xvbm_buffer_get_paddr(b_handle);
-          ctx->desc[ctx->pipe_idx][output_id].dstImgBuf[plane_id] = paddr;
+  if (!session || !session->base.plugin_data || !rows_done)
+    return XMA_ERROR;
+  ctx = (MultiScalerContext*)session->base.plugin_data;
+  if (!ctx->slice_rows)
+    return XMA_ERROR;
 
-          if (output_id < (max_outputs-1))
-            /* prepare input register write at 'output_id+1' */
-            ctx->desc[ctx->pipe_idx][output_id+1].srcImgBuf[plane_id] = paddr;
-        }//for (plane_id)
-    } //if (session->props.output[output_id].format == XMA_VCU_NV12_FMT_TYPE)
-  }// for (output_id
-  write_desc_data_to_device(session);
-  print_desc_config(session);
-  return XMA_SUCCESS;
-TRY_AGAIN:
-  /* Clean up allocated buffers */
-  for (int output = 0; output <= output_id; output++) {
-    for (int plane = 0; plane < get_num_video_planes(session->props.output[output].format); plane++) {
-      XvbmBufferHandle b_handle = ctx->out_bhandle[output][ctx->s_idx][plane];
-      if (b_handle != NULL) {
-        xvbm_buffer_pool_entry_free(b_handle);
-        ctx->out_bhandle[output][ctx->s_idx][plane] = NULL;
-      }
-    }
+  if (ctx->wd_tail != ctx->wd_head) {
+    xma_ret = slice_wait_band(session);
+    if (xma_ret != XMA_SUCCESS)
+      return xma_ret;
   }
-  return XMA_TRY_AGAIN;
+  max_outputs = MIN(ctx->num_outs, MAX_OUTPUTS);
+  for (output_id = 0; output_id < max_outputs; output_id++)
+    rows_done[output_id] = ctx->slice_complete[output_id];
+  return XMA_SUCCESS;
 }
 
 static int32_t
 xlnx_multi_scaler_flush_frame (XmaScalerSession *session)
 {
   MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
-  XmaSession xma_session = session->base;
   int32_t ret=0;
 
+  if (ctx->split_threads) {
+    /* frames in flight are returned by the receiving thread */
+    if (ctx->ring_head != __atomic_load_n(&ctx->ring_tail, __ATOMIC_ACQUIRE))
+      return XMA_FLUSH_AGAIN;
+    split_publish(ctx, &ctx->split_eos, 1);
+    return XMA_EOS;
+  }
+
+  if (ctx->slice_rows) {
+    /* the producer is done with a frame still open */
+    if (ctx->slice_open) {
+      ret = slice_advance(session, session->props.input.height);
+      if (ret != XMA_SUCCESS)
+        return ret;
+    }
+    if (ctx->recv_frame_cnt > ctx->sent_frame_cnt)
+      return XMA_FLUSH_AGAIN;
+    return XMA_EOS;
+  }
+
+  if (ctx->batch_frames > 1) {
+    /* a submitted batch must be waited on before the partial one is started */
+    if (ctx->batch_fill && !ctx->batch_pending) {
+      ret = batch_submit(session);
+      if (ret != XMA_SUCCESS)
+        return ret;
+    }
+    if (ctx->recv_frame_cnt > ctx->sent_frame_cnt)
+      return XMA_FLUSH_AGAIN;
+    DEBUG_PRINT ("return EOS. recv_frame_cnt = %d and sent_frame_cnt = %d\n", (int)ctx->recv_frame_cnt, (int)ctx->sent_frame_cnt);
+    return XMA_EOS;
+  }
+
   if ((ctx->recv_frame_cnt - ctx->sent_frame_cnt) > 1) {
-    xma_plg_schedule_work_item(xma_session, ctx->hw_reg[ctx->pipe_idx], XV_MULTI_SCALER_CTRL_REGMAP_SIZE, &ret);
+    ret = wd_schedule(session, ctx->pipe_idx);
     ctx->pipe_idx = (ctx->pipe_idx + 1) % MAX_PIPELINE_BUFFERS;
     return XMA_FLUSH_AGAIN;
   } else if ((ctx->recv_frame_cnt - ctx->sent_frame_cnt) == 1) {
     return XMA_FLUSH_AGAIN;
   } else {
-    DEBUG_PRINT ("return EOS. recv_frame_cnt = %d and sent_frame_cnt = %d\n", ctx->recv_frame_cnt, ctx->sent_frame_cnt);
+    DEBUG_PRINT ("return EOS. recv_frame_cnt = %d and sent_frame_cnt = %d\n", (int)ctx->recv_frame_cnt, (int)ctx->sent_frame_cnt);
     return XMA_EOS;
   }
 }
@@ -1325,7 +5218,6 @@ xlnx_multi_scaler_send_frame(XmaScalerSession *session, XmaFrame *frame)
   assert(session != NULL);
   assert(frame != NULL);
   MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
-  XmaSession xma_session = session->base;
   int buf_idx = ctx->current_pipe;
   int32_t xma_ret = XMA_SUCCESS;
 #ifdef MEASURE_TIME
@@ -1341,6 +5233,12 @@ xlnx_multi_scaler_send_frame(XmaScalerSession *session, XmaFrame *frame)
     return xlnx_multi_scaler_flush_frame (session);
   }
 
+  if (ctx->split_threads) {
+    ret = split_wait_for_slot(ctx);
+    if (ret != XMA_SUCCESS)
+      return ret;
+  }
+
 #ifdef HDR_DATA_SUPPORT
   ctx->hdr_handle[ctx->s_idx] = xma_frame_get_side_data(frame, XMA_FRAME_HDR);
   if(ctx->hdr_handle[ctx->s_idx]) {
@@ -1357,15 +5255,20 @@ xlnx_multi_scaler_send_frame(XmaScalerSession *session, XmaFrame *frame)
     fprintf (stderr, "written inframe[1] size = %d\n", written);
   }
 #endif
+  if (ctx->dedup_frames)
+    ctx->dedup_hit[ctx->s_idx] = dedup_match(session, frame);
+
   // TODO: why to use s_idx, instead use buf_idx
   ctx->pts[ctx->s_idx] = frame->pts;
   ctx->is_idr[ctx->s_idx] = frame->is_idr;
   ctx->time_base[ctx->s_idx] = frame->time_base;
   ctx->frame_rate[ctx->s_idx] = frame->frame_rate;
   ctx->recv_frame_cnt++;
+  if (ctx->low_latency)
+    clock_gettime(CLOCK_MONOTONIC, &ctx->ll_send_ts[ctx->s_idx]);
 
   DEBUG_PRINT ("Received frame number %lu : pts = %lu, buffer index in pool = %d",
-      ctx->recv_frame_cnt, ctx->pts[ctx->s_idx], ctx->s_idx);
+      (unsigned long)ctx->recv_frame_cnt, ctx->pts[ctx->s_idx], ctx->s_idx);
 
   if (ctx->latency_logging) {
     clock_gettime (CLOCK_REALTIME, &ctx->latency);
@@ -1374,6 +5277,20 @@ xlnx_multi_scaler_send_frame(XmaScalerSession *session, XmaFrame *frame)
     syslog(LOG_DEBUG, "%s : %p : xma_scaler_frame_sent %lld : %lld\n", __func__, ctx, ctx->frame_sent, ctx->time_taken);
   }
 
+  if (ctx->dedup_frames && ctx->dedup_hit[ctx->s_idx]) {
+    /* outputs of the last frame are returned again, device input is released in recv */
+    ctx->in_bhandle[ctx->s_idx] = (frame->data[0].buffer_type == XMA_DEVICE_BUFFER_TYPE) ?
+                                  (XvbmBufferHandle)(frame->data[0].buffer) : NULL;
+    ctx->dedup_skipped++;
+    ctx->s_idx = (ctx->s_idx + 1) % MAX_OUTPOOL_BUFFERS;
+    ctx->current_pipe = (ctx->current_pipe + 1) % MAX_OUTPOOL_BUFFERS;
+    DEBUG_PRINT ("repeated frame, kernel skipped");
+    return XMA_SUCCESS;
+  }
+
+  if (ctx->slice_rows)
+    return slice_open_frame(session, frame);
+
   if (ctx->first_frame == 0) {
     /* write input frame at index 0 */
     ret =  prep_and_write_input_buffer(session, buf_idx, frame);
@@ -1385,13 +5302,10 @@ xlnx_multi_scaler_send_frame(XmaScalerSession *session, XmaFrame *frame)
   } else {
     if (ctx->enable_pipeline == 1) {
        /* schedule a request to XRT. This will execute for previous buffer */
-       XmaCUCmdObj cu_cmd = xma_plg_schedule_work_item(xma_session, ctx->hw_reg[ctx->pipe_idx],XV_MULTI_SCALER_CTRL_REGMAP_SIZE, &xma_ret);
+       xma_ret = wd_schedule(session, ctx->pipe_idx);
        ctx->pipe_idx = (ctx->pipe_idx + 1) % MAX_PIPELINE_BUFFERS;
-       (void)cu_cmd; //currently unused
-       if (xma_ret != XMA_SUCCESS) {
-         ERROR_PRINT ("failed schedule request to XRT...val = %d", xma_ret);
+       if (xma_ret != XMA_SUCCESS)
          return xma_ret;
-       }
      }
 
     /* prepare & write input buffer at channel-0 */
@@ -1404,14 +5318,35 @@ xlnx_multi_scaler_send_frame(XmaScalerSession *session, XmaFrame *frame)
       return ret;
   }
 
-  if (ctx->enable_pipeline != 1) {
-    XmaCUCmdObj cu_cmd  = xma_plg_schedule_work_item(xma_session, ctx->hw_reg[ctx->pipe_idx], XV_MULTI_SCALER_CTRL_REGMAP_SIZE, &xma_ret);
+  if (ctx->batch_frames > 1) {
+    ctx->s_idx = (ctx->s_idx + 1) % MAX_OUTPOOL_BUFFERS;
+    ctx->current_pipe = (ctx->current_pipe + 1) % MAX_OUTPOOL_BUFFERS;
+    if (++ctx->batch_fill == ctx->batch_frames) {
+      xma_ret = batch_submit(session);
+      if (xma_ret != XMA_SUCCESS)
+        return xma_ret;
+      ctx->batch_primed = true;
+    }
+    /* until the first batch is started there is nothing to receive */
+    return ctx->batch_primed ? XMA_SUCCESS : XMA_SEND_MORE_DATA;
+  }
+
+  if (ctx->shared_cu) {
+    /* started together with the other sessions of the batch from recv */
+    xma_ret = shared_cu_enqueue(session);
     ctx->pipe_idx = (ctx->pipe_idx + 1) % MAX_PIPELINE_BUFFERS;
-    (void)cu_cmd; //currently unused
-    if (xma_ret != XMA_SUCCESS) {
-      ERROR_PRINT ("failed schedule request to XRT...val = %d", xma_ret);
+    if (xma_ret != XMA_SUCCESS)
       return xma_ret;
-    }
+  } else if (ctx->enable_pipeline != 1) {
+    if (ctx->low_latency)
+      clock_gettime(CLOCK_MONOTONIC, &ctx->ll_submit_ts);
+    xma_ret = wd_schedule(session, ctx->pipe_idx);
+    ctx->pipe_idx = (ctx->pipe_idx + 1) % MAX_PIPELINE_BUFFERS;
+    if (xma_ret != XMA_SUCCESS)
+      return xma_ret;
+    /* slot s_idx is complete, hand it to the receiving thread */
+    if (ctx->split_threads)
+      split_publish(ctx, &ctx->ring_head, ctx->ring_head + 1);
   }
 
   ctx->s_idx = (ctx->s_idx + 1) % MAX_OUTPOOL_BUFFERS;
@@ -1446,17 +5381,29 @@ xlnx_multi_scaler_send_frame(XmaScalerSession *session, XmaFrame *frame)
   return XMA_SUCCESS;
 }
 
+/* Host frames written in a converted layout must be allocated for it */
+static bool host_frame_fits(XmaFrame *frame, int output_id, int32_t pitch, int32_t min_pitch, int32_t rows)
+{
+  if ((pitch >= min_pitch) && (frame->frame_props.height >= rows))
+    return true;
+  ERROR_PRINT ("Output %d host frame has a pitch of %d bytes and %d rows, its readback layout needs %d and %d "
+               "(see xlnx_multi_scaler_host_out.h)", output_id, pitch, frame->frame_props.height, min_pitch, rows);
+  return false;
+}
+
 static int32_t
 xlnx_multi_scaler_recv_frame_list(XmaScalerSession *session, XmaFrame **frame_list)
 {
   assert(session != NULL);
   assert(frame_list[0] != NULL);
   MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
-  XmaSession xma_session = session->base;
   int max_outputs = MIN(ctx->num_outs, MAX_OUTPUTS);
   int32_t buf_idx;
   int output_id;
   int32_t xma_ret = XMA_SUCCESS;
+  bool dup;
+  XvbmBufferHandle scaled[MAX_OUTPUTS];
+  XvbmBufferHandle release[MAX_OUTPUTS];
 #ifdef MEASURE_TIME
   struct timespec start, stop;
   struct timespec rstart, rstop;
@@ -1465,17 +5412,21 @@ xlnx_multi_scaler_recv_frame_list(XmaScalerSession *session, XmaFrame **frame_li
 #endif
   DEBUG_PRINT ("enter");
 
+  if (ctx->split_threads) {
+    xma_ret = split_wait_for_frame(ctx);
+    if (xma_ret != XMA_SUCCESS)
+      return xma_ret;
+  }
+
   if (ctx->enable_pipeline == 1) {
      if (ctx->first_frame < MAX_PIPELINE_BUFFERS) {
        xma_logmsg(XMA_ERROR, XMA_MULTISCALER, "Called receive frame before sending %d buffers and current buffered frames %d", 2, ctx->first_frame);
 
        //Switch off the pipeline mode and fall back to single frame processing by scheduling the frame
-       XmaCUCmdObj cu_cmd = xma_plg_schedule_work_item(xma_session, ctx->hw_reg[ctx->pipe_idx],XV_MULTI_SCALER_CTRL_REGMAP_SIZE, &xma_ret);
+       xma_ret = wd_schedule(session, ctx->pipe_idx);
        ctx->pipe_idx = (ctx->pipe_idx + 1) % MAX_PIPELINE_BUFFERS;
-       if (xma_ret != XMA_SUCCESS) {
-         ERROR_PRINT ("failed schedule request to XRT...val = %d", xma_ret);
+       if (xma_ret != XMA_SUCCESS)
          return XMA_ERROR;
-       }
        ctx->enable_pipeline = 0;
 
      }
@@ -1484,11 +5435,34 @@ xlnx_multi_scaler_recv_frame_list(XmaScalerSession *session, XmaFrame **frame_li
   clock_gettime (CLOCK_REALTIME, &rstart);
 #endif
 
-  //Check if frame processing is complete (Check DONE bit)
-  xma_ret = xma_plg_is_work_item_done(xma_session, 5000);
-  if (xma_ret != XMA_SUCCESS) {
-    ERROR_PRINT ("Scaler Stopped responding");
-    return xma_ret;
+  dup = ctx->dedup_frames && ctx->dedup_hit[ctx->r_idx];
+  if (dup) {
+    /* nothing was scheduled for a repeated frame */
+  } else if (ctx->batch_frames > 1) {
+    /* waits only on the first frame of each batch */
+    xma_ret = batch_wait(session);
+    if (xma_ret != XMA_SUCCESS)
+      return xma_ret;
+  } else if (ctx->shared_cu) {
+    xma_ret = shared_cu_wait(session);
+    if (xma_ret != XMA_SUCCESS)
+      return xma_ret;
+  } else if (ctx->slice_rows) {
+    /* the frame at r_idx may still be streaming in */
+    if (ctx->slice_open && (ctx->r_idx == ctx->s_idx))
+      return XMA_TRY_AGAIN;
+    xma_ret = slice_wait_frame(session, ctx->r_idx);
+    if (xma_ret != XMA_SUCCESS)
+      return xma_ret;
+  } else if (ctx->low_latency) {
+    xma_ret = low_latency_wait(session);
+    if (xma_ret != XMA_SUCCESS)
+      return xma_ret;
+  } else {
+    //Check if frame processing is complete (Check DONE bit)
+    xma_ret = wd_wait(session);
+    if (xma_ret != XMA_SUCCESS)
+      return xma_ret;
   }
 
 #ifdef MEASURE_TIME
@@ -1505,28 +5479,81 @@ xlnx_multi_scaler_recv_frame_list(XmaScalerSession *session, XmaFrame **frame_li
 
   buf_idx = ctx->r_idx;
 
+  /* aliased outputs may still need the scaled buffer of an earlier output */
+  for (output_id = 0; output_id < max_outputs; output_id++) {
+    scaled[output_id]  = ctx->out_bhandle[output_id][ctx->r_idx][0];
+    release[output_id] = NULL;
+  }
+
   for (output_id = 0; output_id < max_outputs; output_id++) {
     frame_list[output_id]->pts = ctx->pts[ctx->r_idx];
     frame_list[output_id]->is_idr = ctx->is_idr[ctx->r_idx];
     frame_list[output_id]->time_base = ctx->time_base[ctx->r_idx];
     frame_list[output_id]->frame_rate = ctx->frame_rate[ctx->r_idx];
+    if (ctx->suspendable_outputs) {
+      frame_list[output_id]->do_not_encode = ctx->out_suspended[output_id];
+      if (ctx->out_suspended[output_id]) {
+        /* nothing was scaled for this output */
+        if (frame_list[output_id]->data[0].buffer_type == XMA_DEVICE_BUFFER_TYPE)
+          frame_list[output_id]->data[0].buffer = NULL;
+        continue;
+      }
+    }
+    if (ctx->thumb_out[output_id]) {
+      /* sampled frames go to the sprite sheet, never to the encoder */
+      frame_list[output_id]->do_not_encode = true;
+      if (frame_list[output_id]->data[0].buffer_type == XMA_DEVICE_BUFFER_TYPE)
+        frame_list[output_id]->data[0].buffer = NULL;
+      if (!thumb_idle(ctx, output_id, ctx->r_idx)) {
+        release[output_id] = ctx->out_bhandle[output_id][ctx->r_idx][0];
+        ctx->out_bhandle[output_id][ctx->r_idx][0] = NULL;
+        if (thumb_store(ctx, output_id, release[output_id], ctx->pts[ctx->r_idx]) != XMA_SUCCESS) {
+          if (release[output_id])
+            xvbm_buffer_pool_entry_free(release[output_id]);
+          return XMA_ERROR;
+        }
+      }
+      continue;
+    }
+    /* the caller's row pitch, converted host layouts are checked against it */
+    int32_t host_pitch = frame_list[output_id]->frame_props.linesize[0];
     frame_list[output_id]->frame_props.linesize[0] = ctx->out_stride[output_id];
     // linesize[1] set based on buffer type.
       int32_t plane_id = 0;
 
       if ((session->props.output[output_id].format == XMA_VCU_NV12_FMT_TYPE) ||
          (session->props.output[output_id].format == XMA_VCU_NV12_10LE32_FMT_TYPE)){
-          XvbmBufferHandle b_handle = ctx->out_bhandle[output_id][ctx->r_idx][plane_id];
+          XvbmBufferHandle b_handle = dup ? ctx->dedup_last[output_id] :
+                                            ctx->out_bhandle[output_id][ctx->r_idx][plane_id];
+          /* layout of the buffer read, the input's for passthrough outputs */
+          uint32_t src_stride = ctx->out_stride[output_id];
+          uint32_t src_hgt    = ctx->out_hgt_align[output_id];
+
+          if (ctx->out_alias[output_id]) {
+              b_handle   = ctx->alias_of[output_id] < 0 ? ctx->in_bhandle[ctx->r_idx] :
+                                                          scaled[ctx->alias_of[output_id]];
+              src_stride = ctx->alias_stride[output_id];
+              src_hgt    = ctx->alias_hgt_align[output_id];
+          }
           if (!b_handle) {
               ERROR_PRINT ("ERROR , no bhandle found\n");
               return XMA_ERROR;
           }
 
           if (frame_list[output_id]->data[0].buffer_type == XMA_DEVICE_BUFFER_TYPE) {
+              if ((output_id == ctx->stats_out) && !dup &&
+                  (stats_update(ctx, output_id, b_handle, src_stride, true) != XMA_SUCCESS))
+                return XMA_ERROR;
               /* Set linesize[1] to aligned height in zero copy use case so other modules
               know where luma ends/chroma starts (since they are both in one buffer). */
-              frame_list[output_id]->frame_props.linesize[1] = ctx->out_hgt_align[output_id];
+              frame_list[output_id]->frame_props.linesize[0] = src_stride;
+              frame_list[output_id]->frame_props.linesize[1] = src_hgt;
               frame_list[output_id]->data[plane_id].buffer = (void*)b_handle;
+              if (ctx->dedup_frames)
+                dedup_keep_output(ctx, output_id, b_handle, true);
+              else if (ctx->out_alias[output_id])
+                /* downstream releases its own reference */
+                xvbm_buffer_refcnt_inc(b_handle);
           } else {
               frame_list[output_id]->frame_props.linesize[1] = frame_list[output_id]->frame_props.linesize[0];
               uint32_t size;
@@ -1546,15 +5573,77 @@ xlnx_multi_scaler_recv_frame_list(XmaScalerSession *session, XmaFrame **frame_li
                   return XMA_ERROR;
               }
 
-              ret = xvbm_buffer_read(b_handle, hbuf, (size + size / 2), 0);
+              /* a kept output still holds the frame in its host copy */
+              ret = dup ? 0 : xvbm_buffer_read(b_handle, hbuf, (src_stride * src_hgt * 3) / 2, 0);
               if (ret) {
                 ERROR_PRINT ("host buffer read failed\n");
                 return XMA_ERROR;
               }
+              if ((output_id == ctx->stats_out) && !dup &&
+                  (stats_update(ctx, output_id, b_handle, src_stride, false) != XMA_SUCCESS))
+                return XMA_ERROR;
 
-              memcpy(frame_list[output_id]->data[0].buffer, hbuf,        size);
-              memcpy(frame_list[output_id]->data[1].buffer, (hbuf + size), size / 2);
-              xvbm_buffer_pool_entry_free (ctx->out_bhandle[output_id][ctx->r_idx][plane_id]);
+              if ((session->props.output[output_id].format == XMA_VCU_NV12_10LE32_FMT_TYPE) &&
+                  (ctx->host_unpack == XLNX_HOST_OUT_P010)) {
+                  int32_t dst_stride = host_pitch;
+                  if (!host_frame_fits(frame_list[output_id], output_id, host_pitch,
+                                       ctx->out_width[output_id] * 2, ctx->out_height[output_id]))
+                    return XMA_ERROR;
+                  frame_list[output_id]->frame_props.linesize[0] = dst_stride;
+                  frame_list[output_id]->frame_props.linesize[1] = dst_stride;
+                  xlnx_unpack_10le32_frame_p010(hbuf, src_stride, src_hgt,
+                                                (uint8_t *)frame_list[output_id]->data[0].buffer,
+                                                (uint8_t *)frame_list[output_id]->data[1].buffer,
+                                                dst_stride, ctx->out_width[output_id], ctx->out_height[output_id]);
+              } else if ((session->props.output[output_id].format == XMA_VCU_NV12_10LE32_FMT_TYPE) &&
+                         (ctx->host_unpack == XLNX_HOST_OUT_NV12_DITHER)) {
+                  int32_t dst_stride = host_pitch;
+                  if (!host_frame_fits(frame_list[output_id], output_id, host_pitch,
+                                       ctx->out_width[output_id], ctx->out_height[output_id]))
+                    return XMA_ERROR;
+                  if (!ctx->unpack_row &&
+                      !(ctx->unpack_row = (uint16_t *)malloc(MAX_WIDTH * sizeof(uint16_t)))) {
+                    ERROR_PRINT ("unpack row buffer allocation failed");
+                    return XMA_ERROR;
+                  }
+                  /* the frame now holds 8-bit NV12, see xlnx_multi_scaler_host_out.h */
+                  frame_list[output_id]->frame_props.linesize[0] = dst_stride;
+                  frame_list[output_id]->frame_props.linesize[1] = dst_stride;
+                  frame_list[output_id]->frame_props.format = XMA_VCU_NV12_FMT_TYPE;
+                  frame_list[output_id]->frame_props.bits_per_pixel = 8;
+                  xlnx_unpack_10le32_frame_nv12(hbuf, src_stride, src_hgt,
+                                                (uint8_t *)frame_list[output_id]->data[0].buffer,
+                                                (uint8_t *)frame_list[output_id]->data[1].buffer,
+                                                dst_stride, ctx->out_width[output_id], ctx->out_height[output_id],
+                                                ctx->unpack_row);
+              } else if (ctx->tensor_out[output_id]) {
+                  /* planes back to back in data[0], see xlnx_multi_scaler_host_out.h */
+                  const XlnxTensorConv *conv = &ctx->tensor_conv[output_id];
+                  if (!host_frame_fits(frame_list[output_id], output_id, host_pitch,
+                                       ctx->out_width[output_id] * conv->elem_size,
+                                       3 * ctx->out_height[output_id]))
+                    return XMA_ERROR;
+                  frame_list[output_id]->frame_props.linesize[0] = host_pitch;
+                  frame_list[output_id]->frame_props.linesize[1] = host_pitch;
+                  xlnx_nv12_to_tensor(hbuf, src_stride, src_hgt,
+                                      (uint8_t *)frame_list[output_id]->data[0].buffer, host_pitch,
+                                      ctx->out_width[output_id], ctx->out_height[output_id], conv);
+              } else if ((src_stride != (uint32_t)frame_list[output_id]->frame_props.linesize[0]) ||
+                         (src_hgt != ctx->out_hgt_align[output_id])) {
+                  xlnx_copy_frame_semiplanar(hbuf, src_stride, src_hgt,
+                                             (uint8_t *)frame_list[output_id]->data[0].buffer,
+                                             (uint8_t *)frame_list[output_id]->data[1].buffer,
+                                             frame_list[output_id]->frame_props.linesize[0],
+                                             frame_list[output_id]->frame_props.linesize[0],
+                                             ctx->out_hgt_align[output_id]);
+              } else {
+                  memcpy(frame_list[output_id]->data[0].buffer, hbuf,        size);
+                  memcpy(frame_list[output_id]->data[1].buffer, (hbuf + size), size / 2);
+              }
+              if (ctx->dedup_frames)
+                dedup_keep_output(ctx, output_id, b_handle, false);
+              else if (!ctx->out_alias[output_id])
+                release[output_id] = b_handle;
           }
 
           XVBM_BUFF_PR("\tMS sending output buffer =%p ID = %d\n", b_handle, xvbm_buffer_get_id(b_handle));
@@ -1574,6 +5663,11 @@ xlnx_multi_scaler_recv_frame_list(XmaScalerSession *session, XmaFrame **frame_li
 #endif
   }
 
+  for (output_id = 0; output_id < max_outputs; output_id++) {
+    if (release[output_id])
+      xvbm_buffer_pool_entry_free(release[output_id]);
+  }
+
 #ifdef HDR_DATA_SUPPORT
     /* Decrementing the side data ref count since the ref count is
        incremented during alloc and side data addition */
@@ -1582,7 +5676,14 @@ xlnx_multi_scaler_recv_frame_list(XmaScalerSession *session, XmaFrame **frame_li
     }
 #endif
 
-  ctx->sent_frame_cnt = ctx->sent_frame_cnt + 1;
+  if (ctx->dedup_frames) {
+    ctx->dedup_last_fp = ctx->dedup_fp[ctx->r_idx];
+    ctx->dedup_have_last = true;
+  }
+
+  ctx->sent_frame_cnt++;
+  if (ctx->low_latency && !dup)
+    low_latency_report(ctx, ctx->r_idx);
   ctx->r_idx = (ctx->r_idx + 1) % MAX_OUTPOOL_BUFFERS;
 
   if (ctx->in_bhandle[buf_idx]) {
@@ -1592,7 +5693,11 @@ xlnx_multi_scaler_recv_frame_list(XmaScalerSession *session, XmaFrame **frame_li
       xvbm_buffer_pool_entry_free(ctx->in_bhandle[buf_idx]);
   }
 
-  DEBUG_PRINT ("read buffer at index %d and sent frame count is %lu", buf_idx, ctx->sent_frame_cnt);
+  /* slot buf_idx may be reused by the sending thread from here on */
+  if (ctx->split_threads)
+    split_publish(ctx, &ctx->ring_tail, ctx->ring_tail + 1);
+
+  DEBUG_PRINT ("read buffer at index %d and sent frame count is %lu", buf_idx, (unsigned long)ctx->sent_frame_cnt);
 #ifdef MEASURE_TIME
   clock_gettime (CLOCK_REALTIME, &stop);
   ctx->recv_func_time += ((stop.tv_sec - start.tv_sec) * 1e6 + (stop.tv_nsec - start.tv_nsec) / 1e3);
@@ -1613,37 +5718,64 @@ xlnx_multi_scaler_close(XmaScalerSession *session)
   XmaSession xma_session = session->base;
   MultiScalerContext *ctx = (MultiScalerContext*)session->base.plugin_data;
   int max_outputs = MIN(ctx->num_outs, MAX_OUTPUTS);
-  int plane_id, output_id, pipe_id;
+  int output_id, pipe_id;
+  bool device_busy = false;
   DEBUG_PRINT ("enter");
 #ifdef DUMP_INPUT_FRAMES
   fclose (infp);
 #endif
 
+  if (ctx->shared_cu)
+    device_busy = shared_cu_leave(session);
+  capacity_release(session);
+  bank_release(session);
+  free_filter_coeffs(ctx);
+  if (ctx->dedup_frames)
+    dedup_release(session);
+  if (ctx->num_thumbs)
+    thumb_free_sheets(ctx);
+  free(ctx->stats_prev);
+  ctx->stats_prev = NULL;
+  /* still held when dropped work items never completed */
+  wd_release_held(ctx);
+  free(ctx->unpack_row);
+  ctx->unpack_row = NULL;
+  if (ctx->split_threads)
+    split_sync_destroy(ctx);
+
+  if (device_busy) {
+    /* a shared CU batch holding this session's chain never completed */
+    xma_logmsg(XMA_ERROR_LOG, XMA_MULTISCALER,
+               "Scaler still running a shared CU batch, device buffers of this session are not freed");
+    ctx->in_phandle = NULL;
+    ctx->dev_arena.data = NULL;
+    memset(ctx->out_phandle, 0, sizeof(ctx->out_phandle));
+  } else if (warm_pool_release(session)) {
+    free(ctx->cfg);
+    ctx->cfg = NULL;
+    DEBUG_PRINT ("leave");
+    closelog();
+    return XMA_SUCCESS;
+  }
+
   //release input buffer pool
   if (ctx->in_phandle)
     xvbm_buffer_pool_destroy(ctx->in_phandle);
 
-  //release filter coeff and output buffers
-  for (output_id = 0; output_id < max_outputs; output_id++) {
-    xma_plg_buffer_free(xma_session, ctx->HfltCoeff_Buffer[output_id]);
-    xma_plg_buffer_free(xma_session, ctx->VfltCoeff_Buffer[output_id]);
-    for (pipe_id = 0; pipe_id < MAX_PIPELINE_BUFFERS; pipe_id++) {
-      xma_plg_buffer_free(xma_session, ctx->desc_buffer[pipe_id][output_id]);
-    }
-    //@TODO add and use pool sharing API in xvbm
-    if (!ctx->session_mix_rate) {
-        for (plane_id = 0; plane_id < get_num_video_planes(session->props.output[output_id].format); plane_id++) {
-            if (ctx->out_phandle[output_id][plane_id]) {
-                xvbm_buffer_pool_destroy(ctx->out_phandle[output_id][plane_id]);
-            }
-        }/* plane_id */
-    }
-  }/* output_id */
+  //release filter coeff and descriptor arena
+  if (ctx->dev_arena.data)
+    xma_plg_buffer_free(xma_session, ctx->dev_arena);
+
+  //release output buffers
+  for (output_id = 0; output_id < max_outputs; output_id++)
+    destroy_output_pools(session, output_id);
 
   for (pipe_id = 0; pipe_id < MAX_PIPELINE_BUFFERS; pipe_id++) {
     if(ctx->desc[pipe_id])
       free(ctx->desc[pipe_id]);
   }
+  free(ctx->cfg);
+  ctx->cfg = NULL;
 
   DEBUG_PRINT ("leave");
   closelog();
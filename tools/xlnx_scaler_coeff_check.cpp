@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2021, Xilinx Inc - All rights reserved
+ * Xilinx Multiscaler XMA Plugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+/* Checks the cardinal cubic coefficient generator against golden tables,
+ * e.g. after changes to xlnx_abr_scaler_coeffs.h:
+ *   xlnx_scaler_coeff_check tools/xlnx_scaler_coeff_golden.txt
+ * Each golden line holds a src and dst size and the Adler-32 of the table
+ * the plugin generates for it. Returns non-zero on any difference.
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* the generator is built into the plugin, which takes this from xma.h */
+#ifndef XMA_ERROR
+#define XMA_ERROR (-1)
+#endif
+#include "xlnx_abr_scaler_coeffs.h"
+#include "xlnx_abr_scaler_coeff_file.h"
+
+int main(int argc, char *argv[])
+{
+  int16_t table[HSC_PHASES][HSC_TAPS];
+  int64_t B = 0 * (1 << 24);
+  int64_t C = 0.6 * (1 << 24);
+  int src, dst, filterSize, checked = 0, failed = 0;
+  unsigned int golden;
+  uint32_t sum;
+  char line[256];
+  FILE *fp;
+
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s <xlnx_scaler_coeff_golden.txt>\n", argv[0]);
+    return 1;
+  }
+  fp = fopen(argv[1], "r");
+  if (!fp) {
+    fprintf(stderr, "failed to open %s\n", argv[1]);
+    return 1;
+  }
+  while (fgets(line, sizeof(line), fp)) {
+    if ((line[0] == '#') || (line[0] == '\n'))
+      continue;
+    if (sscanf(line, "%d %d %x", &src, &dst, &golden) != 3) {
+      fprintf(stderr, "malformed line: %s", line);
+      failed++;
+      continue;
+    }
+    if (feasibilityCheck(src, dst, &filterSize)) {
+      fprintf(stderr, "%d to %d: no longer feasible\n", src, dst);
+      failed++;
+      continue;
+    }
+    memset(table, 0, sizeof(table));
+    Generate_cardinal_cubic_spline(src, dst, filterSize, B, C, (int16_t *)table);
+    sum = xlnx_coeff_adler32((const uint8_t *)table, sizeof(table));
+    if (sum != golden) {
+      fprintf(stderr, "%d to %d: table checksum %08x, golden %08x\n", src, dst, sum, golden);
+      failed++;
+    }
+    checked++;
+  }
+  fclose(fp);
+
+  printf("%d tables checked, %d differ\n", checked, failed);
+  return (failed || !checked) ? 1 : 0;
+}
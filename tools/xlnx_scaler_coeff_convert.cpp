@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2021, Xilinx Inc - All rights reserved
+ * Xilinx Multiscaler XMA Plugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"). You may
+ * not use this file except in compliance with the License. A copy of the
+ * License is located at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+/* Converts a text coefficient file (as read with coeffLoad=2) to the binary
+ * format mapped by the plugin. The text file holds one table pair per output
+ * with coeffLoad=2, in output order, so those outputs are listed, e.g. "0,2".
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "xlnx_abr_scaler_coeff_file.h"
+
+#define MAX_OUTPUTS 8
+
+int main(int argc, char *argv[])
+{
+  int output_ids[MAX_OUTPUTS];
+  int num_sets = 0;
+  char *p, *end;
+
+  if (argc != 4) {
+    fprintf(stderr, "usage: %s <FilterCoeff.txt> <coeffLoad=2 outputs, e.g. 0,2,3> <FilterCoeff.bin>\n",
+            argv[0]);
+    return 1;
+  }
+  for (p = argv[2]; *p; p = (*end == ',') ? end + 1 : end) {
+    long id = strtol(p, &end, 10);
+    if ((end == p) || ((*end != ',') && *end) || (id < 0) || (id >= MAX_OUTPUTS) ||
+        (num_sets && (id <= output_ids[num_sets - 1])) || (num_sets == MAX_OUTPUTS)) {
+      fprintf(stderr, "outputs must be ascending ids between 0 and %d separated by ','\n", MAX_OUTPUTS - 1);
+      return 1;
+    }
+    output_ids[num_sets++] = (int)id;
+  }
+  if (!num_sets) {
+    fprintf(stderr, "no outputs given\n");
+    return 1;
+  }
+  if (xlnx_coeff_file_convert_text(argv[1], output_ids, num_sets, argv[3]))
+    return 1;
+  printf("Wrote %d horizontal and %d vertical sets to %s\n", num_sets, num_sets, argv[3]);
+  return 0;
+}